@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // CPU affinity
 #include <SFML/Graphics.h>
 #include <SFML/System.h>
 #include <stdio.h>
@@ -10,6 +11,22 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <stdatomic.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <sched.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
 
 #define CELL_SIZE 50
 #define ROWS 20
@@ -21,13 +38,126 @@
 #define MAX_KEYS 2
 #define MAX_EXIT_PERMITS 2
 #define MAX_GHOSTS 4
+#define MAX_GHOST_HOUSES 1
+#define GHOST_HOUSE_KEYS (MAX_KEYS + 1)
+#define GHOST_HOUSE_PERMITS (MAX_EXIT_PERMITS + 1)
+#define BOOST_SLOTS 2              // ghosts boosted at the same time
+#define BOOST_BUCKET_CAPACITY 2.0  // tokens that can be banked
+#define BOOST_TOKENS_PER_SEC 0.25  // one new boost every 4 s on average
+#define BOOST_DURATION_MS 5000
+#define GHOST_INTERVAL_MS 200      // ghost 0's step; each later ghost is slower
+#define GHOST_INTERVAL_STEP_MS 50
+#define GHOST_VULNERABLE_MS 6000   // after a power pellet, ghosts can be eaten this long
+#define POWER_PELLET_MS 10000
+#define GHOST_HOUSE_ROW 6          // top left of the inside of the ghost house
+#define GHOST_HOUSE_COL 7
+#define LEVEL_GHOST_SPEEDUP 10     // percent off every ghost interval per level
+#define LEVEL_MIN_GHOST_INTERVAL_MS 80
+#define LEVEL_SEED 4242u           // level n > 1 is generated from LEVEL_SEED + n
+#define LEVEL_MAX 999              // the level number stops here; the mazes keep coming
+#define BOARD_TILE_SIZE 4          // cells per side of one board lock region
+#define MOVE_BENCH_SECONDS 0.5
+#define MOVE_BENCH_MAX_WORKERS 64
+#define MOVE_BENCH_CELLS_PER_GHOST 12
+#define MAZE_MIN_SIDE 15
+#define MAZE_HOUSE_ROWS 3        // inside of the ghost house, as in initialBoard
+#define MAZE_HOUSE_COLS 6
+#define MAZE_PELLET_TILE 10      // one power pellet per tile: four on a 20x20 maze
+#define MAZE_OPENNESS 30         // percent of the walls between two corridors knocked out
+#define MAZE_BENCH_MAX_SIDE 640
+#define SESSION_MAX_WORKERS 64
+#define SESSION_TICK_MS 200        // pacman step, as in the windowed game
+#define SESSION_IDLE_WAIT_MS 50    // longest a worker sleeps, so new sessions start promptly
+#define SESSION_RESPAWN_DELAY_MS 500
+#define SESSION_SOCKET_PATH "pacman.sock"
+#define SESSION_CLIENT_BUFFER 256
+#define SESSION_BENCH_SECONDS 5
+#define SESSION_REPORT_BYTES (128 * (SESSION_MAX_WORKERS + 2)) // header, one line per worker, totals
 #define MAX_INPUT_EVENTS 10
 #define MENU_ITEM_COUNT 4
 #define EVENT_DIRECTION_CHANGE 0
 #define EVENT_MENU_SELECT 1
 #define EVENT_SCREEN_CHANGE 2
-#define SCORE_FILE "scores.txt"
+#define EVENT_REWIND_STEP 3 // data: ticks back, negative steps forward
+#define SCORE_FILE "scores.bin"
+#define LEGACY_SCORE_FILE "scores.txt"
 #define MAX_SCORES 10
+#define SCORE_STORE_MAGIC 0x53434D50 // "PMCS"
+#define SCORE_STORE_VERSION 1
+#define SCORE_STORE_MIN_CAPACITY 64
+#define SCORE_NEARBY_POINTS 100 // game over shows how many scores are this close
+#define SPECTATOR_SHM_NAME "/pacman-spectate"
+#define SPECTATOR_MAGIC 0x50534E50 // "PNSP"
+#define SPECTATOR_VERSION 2
+#define SPECTATOR_RING_SLOTS 64   // ~13 s of ticks, power of two
+#define SPECTATOR_POLL_MS 20
+#define SNAPSHOT_FRAME_KEY 1
+#define SNAPSHOT_FRAME_DELTA 2
+#define SNAPSHOT_FRAME_MAX 512        // a keyframe is ~430 bytes
+#define SNAPSHOT_MAX_DELTA_CELLS 100  // more changed cells than this: send a keyframe
+#define REWIND_SECONDS 60
+#define REWIND_BUFFER_KB 64           // 60 s of play encodes to ~10-15 KB
+#define REWIND_KEYFRAME_TICKS 25      // a seek decodes at most this many frames
+#define SAVE_FILE "savegame.bin"
+#define SAVE_MAGIC 0x56534D50 // "PMSV"
+#define SAVE_VERSION 2
+#define BOT_POLL_MS 100       // two looks per engine tick
+#define BOT_SAFETY_MARGIN 1   // steps pacman must stay ahead of a ghost
+#define BOT_SAFETY_HORIZON 4  // steps ahead that are checked; it replans long before
+#define BOT_BENCH_SECONDS 30
+#define ROLLOUT_GAMES 200         // per parameter set
+#define ROLLOUT_MAX_SECONDS 600   // simulated; a game still going then survived
+#define ROLLOUT_CHUNK 8           // games a worker claims at a time
+#define FONT_FILE "ARIAL.TTF"
+#define ASSET_BUNDLE_FILE "assets.pak"
+#define ASSET_BUNDLE_MAGIC 0x4B50434D // "MCPK"
+#define ASSET_BUNDLE_VERSION 2
+#define ASSET_COUNT 7
+#ifndef ENABLE_TRACING
+#define ENABLE_TRACING 1
+#endif
+#define TRACE_RING_SIZE 16384 // events per thread, power of two
+#define MAX_TRACE_THREADS 64
+#define TRACE_FILE "trace.json"
+#ifndef ENABLE_LOCK_PROFILING
+#define ENABLE_LOCK_PROFILING 1
+#endif
+#define MAX_PROFILED_LOCKS 16
+#define MAX_LOCK_SITES 48
+#define LOCK_HIST_BUCKETS 24
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG // levels below this are compiled out
+#endif
+#define LOG_RING_SIZE 256 // messages per thread, power of two
+#define LOG_MESSAGE_SIZE 160
+#define MAX_LOG_THREADS 64
+#define LOG_DRAIN_INTERVAL_MS 20
+#define MAX_HEARTBEATS 64
+#define WATCHDOG_INTERVAL_MS 100
+#define WATCHDOG_MISSED_TICKS 5 // a thread this many ticks late counts as stalled
+#define LATENCY_HIST_BUCKETS 24
+
+// Arguments are not evaluated unless the level is enabled
+#define LOG_AT(level, ...) do { \
+        if ((level) >= LOG_COMPILE_LEVEL && \
+            (level) >= atomic_load_explicit(&logLevel, memory_order_relaxed)) { \
+            logWrite((level), __VA_ARGS__); \
+        } \
+    } while (0)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#if ENABLE_LOCK_PROFILING
+#define MUTEX_LOCK(m) profiledMutexLock(&(m), "lock " #m, __FILE__, __LINE__)
+#define MUTEX_TIMEDLOCK(m, timeout) profiledMutexTimedLock(&(m), (timeout), "lock " #m, __FILE__, __LINE__)
+#define MUTEX_UNLOCK(m) profiledMutexUnlock(&(m))
+#else
+#define MUTEX_LOCK(m) tracedMutexLock(&(m), "lock " #m)
+#define MUTEX_TIMEDLOCK(m, timeout) tracedMutexTimedLock(&(m), (timeout), "lock " #m)
+#define MUTEX_UNLOCK(m) pthread_mutex_unlock(&(m))
+#endif
 
 char initialBoard[20][20] = {
     "====================",
@@ -37,7 +167,7 @@ char initialBoard[20][20] = {
     "=.=.==..####...=...=",
     "=...==.=======.==..=",
     "====== =     =.=====",
-    "=..... =     =.....=",
+    "...... =     =......",
     "=.==== === ===.=====",
     "=......=.....=.....=",
     "=.==== ==....====. =",
@@ -52,6 +182,26 @@ char initialBoard[20][20] = {
     "===================="
 };
 
+typedef enum {
+    ASSET_PACMAN = 0,
+    ASSET_GHOST1,
+    ASSET_GHOST2,
+    ASSET_GHOST3,
+    ASSET_GHOST4,
+    ASSET_GHOST_VULNERABLE,
+    ASSET_LIFE
+} AssetId;
+
+const char* assetFiles[ASSET_COUNT] = {
+    "pacman1.jpeg",
+    "ghost.jpeg",
+    "ghost2.jpeg",
+    "ghost3.jpeg",
+    "ghost4.jpeg",
+    "ghostDed.jpg",
+    "live.png"
+};
+
 const char* menuItems[] = {
     "Play",
     "Scoreboard",
@@ -61,11 +211,6 @@ const char* menuItems[] = {
 
 sfClock* gameClock;
 sfClock* pelletBlinkClock;
-sfTexture* ghost1Texture;
-sfTexture* ghost5Texture;
-sfTexture* ghost2Texture;
-sfTexture* ghost3Texture;
-sfTexture* ghost4Texture;
 
 typedef enum {
     DIR_NONE = 0,
@@ -94,6 +239,32 @@ typedef struct {
     int usernameCursorPos;
 } UIState;
 
+typedef struct TimerThreadArgs {
+    char name[24]; // thread and heartbeat name
+    sem_t* semaphore;
+    atomic_int intervalMs; // may be changed while the timer runs
+    atomic_bool isRunning;
+    int cpu;          // core to pin to, -1 for any
+    int fifoPriority; // SCHED_FIFO priority, 0 for normal scheduling
+    // Wake-up lateness against the intended deadline; written by the timer
+    // thread only and read after it is joined
+    uint64_t wakeups;
+    uint64_t lateNsTotal;
+    uint64_t lateNsMax;
+    uint64_t lateHistogram[LATENCY_HIST_BUCKETS];
+} TimerThreadArgs;
+
+// Opt-in placement for the tick path, read from the environment:
+// PACMAN_PIN_ENGINE / PACMAN_PIN_TIMERS / PACMAN_PIN_RENDER=<cpu>,
+// PACMAN_TICK_FIFO=<1-99> and PACMAN_MLOCK=1
+typedef struct {
+    int engineCpu; // -1 leaves the thread where the kernel puts it
+    int timerCpu;
+    int renderCpu;
+    int tickPriority; // SCHED_FIFO for the engine tick, 0 = off
+    bool lockMemory;
+} RealtimeConfig;
+
 typedef struct {
     int row;
     int col;
@@ -112,8 +283,77 @@ typedef struct {
     bool hasExitPermit;   
     bool inGhostHouse;    
     char cellContent;
+    int houseId;
+    bool queuedForHouse;
+    uint64_t houseRequestNs;
+    uint64_t houseGrants;
+    uint64_t houseWaitNsTotal;
+    uint64_t houseWaitNsMax;
+    int baseIntervalMs;
+    uint64_t boostStartNs;
+    uint64_t boostEndNs;
+    unsigned int sessionEpoch; // generation this ghost's thread is acting on
+    unsigned int rngSeed; // the ghost's own rand_r() state, so a save can hold it
+    TimerThreadArgs moveTimer;
+    pthread_t timerThread;
+    sem_t moveSemaphore; // lives as long as the ghost, so a late post is harmless
+    bool threadStarted;
 } Ghost;
 
+// Shutdown broadcast. Every sleeping simulation or timer thread waits on this
+// condvar (CLOCK_MONOTONIC), so one broadcast wakes all of them at once.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    atomic_bool cancelled;
+} CancelSignal;
+
+// Bookkeeping for one pool of interchangeable resources (keys, permits,
+// boosts). Every take/give is checked against held + free == total and
+// against the per-ghost holdings, so a leak or double release is reported at
+// the transition that caused it, with the ghost responsible. The caller holds
+// whichever lock guards the pool.
+typedef struct {
+    const char* name;
+    int total;
+    int free;
+    int heldTotal;
+    int heldBy[MAX_GHOSTS];
+    uint64_t violations;
+} ResourceLedger;
+
+// Central speed-boost scheduler, run from the engine tick. Boosts are paid
+// for from a token bucket and limited to BOOST_SLOTS at once; ghosts never
+// ask or wait, they just find their timer interval changed.
+typedef struct {
+    double tokens;
+    uint64_t lastRefillNs;
+    int nextGhost; // round-robin start so no eligible ghost is always last
+    uint64_t startNs;
+    uint64_t grants;
+    uint64_t denied; // ticks where an eligible ghost found no token or slot
+    uint64_t boostedNsTotal;
+} BoostScheduler;
+
+// A ghost house hands out a key and an exit permit together, strictly in the
+// order ghosts asked (a ticket queue), so no ghost can be overtaken forever.
+// Requests never block: a waiting ghost is granted as soon as resources come
+// back, and simply sees the grant on its next tick.
+typedef struct {
+    pthread_mutex_t mutex;
+    ResourceLedger keys;
+    ResourceLedger permits;
+    int queue[MAX_GHOSTS]; // ghost ids in ticket order
+    int queueHead;
+    int queueLength;
+} GhostHouse;
+
+// For every cell, the index (row * COLS + col) of the cell one step away in
+// each direction, at [direction - 1], or -1 off the board. Tunnels are
+// declared by the maze itself: an open cell on the edge whose mirror on the
+// opposite edge is also open leads straight to it.
+typedef int16_t CellNeighbors[ROWS * COLS][4];
+
 typedef struct {
     char board[20][20];
     char originalBoard[20][20];
@@ -133,8 +373,196 @@ typedef struct {
     float ghostVulnerableDuration;
     int pacmanStartRow;
     int pacmanStartCol;
+    _Atomic uint64_t pacmanView; // see publishPacmanView()
+    atomic_uint generation; // bumped by every session reset
+    int level; // 1 is initialBoard, later levels are generated
+    // Still to be eaten, kept up to date by movePacman(); a power pellet
+    // pacman stands on without eating it still counts
+    int pelletsLeft;
+    int powerPelletsLeft;
+    CellNeighbors neighbors; // the current level's, see startLevelLocked()
 } GameState;
 
+// Pristine copy of everything a new session starts from, built once so a
+// reset is a few memcpys
+typedef struct {
+    char board[ROWS][COLS];
+    char originalBoard[ROWS][COLS];
+    bool powerPelletLocations[ROWS][COLS];
+    int pacmanStartRow;
+    int pacmanStartCol;
+    int pelletCount;
+    int powerPelletCount;
+    CellNeighbors neighbors;
+} SessionTemplate;
+
+// Decoded copy of GameState.pacmanView: everything a ghost needs each tick,
+// read in one atomic load instead of taking gameState.mutex.
+typedef struct {
+    bool valid;
+    int row;
+    int col;
+    Direction direction;
+    bool ghostVulnerable;
+    bool gameRunning;
+    bool gamePaused;
+} PacmanView;
+
+// How ghost moves are serialised against each other. BOARD_LOCK_GLOBAL is the
+// original scheme (every move takes gameState.mutex). BOARD_LOCK_TILES locks
+// only the regions the move touches. BOARD_LOCK_CAS only exists in the move
+// benchmark, where a cell holds nothing but its occupant.
+typedef enum {
+    BOARD_LOCK_GLOBAL,
+    BOARD_LOCK_TILES,
+    BOARD_LOCK_CAS,
+    BOARD_LOCK_MODE_COUNT
+} BoardLockMode;
+
+// One mutex per square tile of a grid. A move locks the tiles of its source
+// and target cells in ascending tile index, so two moves can never wait on
+// each other in a cycle, and moves in different regions never share a lock.
+typedef struct {
+    int rows;
+    int cols;
+    int tileSize;
+    int tileCols;
+    int tileCount;
+    pthread_mutex_t* locks;
+} TileLockGrid;
+
+// What lockBoardCells() took, so unlockBoardCells() can give it back
+typedef struct {
+    bool global; // gameState.mutex rather than tiles
+    int held[2];
+    int count;
+} BoardCellLock;
+
+// A generated maze in initialBoard's alphabet: '=' wall, '.' pellet, '0'
+// power pellet, ' ' empty and '@' pacman's start. The ghost house is the
+// empty MAZE_HOUSE_ROWS x MAZE_HOUSE_COLS block at houseRow/houseCol inside
+// a wall whose only gap is the door above it.
+typedef struct {
+    int rows;
+    int cols;
+    char* cells; // rows * cols, row-major
+    int houseRow;
+    int houseCol;
+    int doorRow;
+    int doorCol;
+    int pacmanRow;
+    int pacmanCol;
+    int openCount;
+    int pelletCount;
+    int powerPelletCount;
+} GeneratedMaze;
+
+typedef struct {
+    int rows;
+    int cols;
+    _Atomic int* cells; // MOVE_BENCH_WALL, MOVE_BENCH_EMPTY or a ghost id
+    BoardLockMode mode;
+    pthread_mutex_t globalLock;
+    TileLockGrid tiles;
+    atomic_bool running;
+} MoveBenchBoard;
+
+// Each worker drives a disjoint slice of the benchmark ghosts
+typedef struct {
+    MoveBenchBoard* board;
+    int* ghostRow;
+    int* ghostCol;
+    int firstGhost;
+    int ghostCount;
+    unsigned int seed;
+    uint64_t moves;
+    uint64_t blocked;
+    pthread_t thread;
+} MoveBenchWorker;
+
+// The tunable numbers of a session's game. sessionDefaultRules are the
+// windowed game's; ./game --rollouts plays variations of them.
+typedef struct {
+    int ghostIntervalMs;      // ghost 0's step
+    int ghostIntervalStepMs;  // added for each later ghost
+    int vulnerableMs;
+    int powerPelletMs;
+    int boostDurationMs;      // 0 turns speed boosts off
+    double boostTokensPerSec;
+    int boostSlots;
+} SessionRules;
+
+// One independent game hosted by the session server (./game --serve). It
+// holds everything the windowed game keeps in globals: board, pacman, its
+// own ghosts and ghost house, and the deadlines that replace their timer
+// threads. mutex guards all of it and is taken by the worker stepping the
+// session and by the client driving it; the house mutex is not used.
+typedef struct GameSession {
+    int id;
+    pthread_mutex_t mutex;
+    char board[ROWS][COLS];
+    bool powerPelletLocations[ROWS][COLS];
+    int score;
+    int lives;
+    int pacmanRow;
+    int pacmanCol;
+    Direction currentDirection;
+    bool gameRunning; // false once the last life is lost
+    bool powerPelletActive;
+    float powerPelletDuration;
+    bool ghostVulnerable;
+    float ghostVulnerableDuration;
+    Ghost ghosts[MAX_GHOSTS];
+    GhostHouse houses[MAX_GHOST_HOUSES];
+    SessionRules rules;
+    double boostTokens; // the boost scheduler's bucket, on the session clock
+    uint64_t boostRefillNs;
+    int boostNextGhost;
+    uint64_t tickDueNs;
+    uint64_t ghostDueNs[MAX_GHOSTS];
+    uint64_t ticks;
+    uint64_t gamesPlayed;
+    bool autopilot; // benchmark sessions steer pacman themselves
+    unsigned int seed;
+    int worker;
+    struct GameSession* next; // in the owning worker's list
+} GameSession;
+
+// A pool thread that steps every session assigned to it. Sessions never move
+// between workers; mutex guards the list and the counters and is held for a
+// whole pass, so a session is only freed between passes.
+typedef struct {
+    int id;
+    int cpu;
+    pthread_t thread;
+    bool started;
+    pthread_mutex_t mutex;
+    GameSession* sessions;
+    int sessionCount;
+    uint64_t passes;
+    uint64_t pacmanTicks;
+    uint64_t ghostMoves;
+    uint64_t busyNs;
+    uint64_t lateNsTotal;
+    uint64_t lateNsMax;
+    uint64_t startNs;
+} SessionWorker;
+
+typedef struct {
+    SessionWorker workers[SESSION_MAX_WORKERS];
+    int workerCount;
+    int coreCount; // distinct CPUs the workers are pinned to
+    atomic_int nextSessionId;
+} SessionManager;
+
+// A connection to the session server's Unix socket; owns at most one session
+typedef struct {
+    int fd;
+    GameSession* session;
+    char buffer[SESSION_CLIENT_BUFFER];
+    int length;
+} SessionClient;
+
 typedef struct {
     int eventType;
     int data;
@@ -153,1751 +581,7776 @@ typedef struct {
     int score;
 } ScoreEntry;
 
-typedef struct TimerThreadArgs {
-    sem_t* semaphore;
-    int intervalMs;
-    bool isRunning;
-} TimerThreadArgs;
+// On-disk layout of the score store: a header followed by ScoreEntry records
+// kept sorted by descending score, so rank and range lookups are binary searches
+// over the mapped file and only the touched pages are ever read.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t capacity;
+} ScoreStoreHeader;
+
+typedef struct {
+    int fd;
+    size_t mappedSize;
+    ScoreStoreHeader* header;
+    ScoreEntry* entries;
+} ScoreStore;
+
+// Everything a spectator sees of one tick, fixed size and pointer free so it
+// can be copied into shared memory as is
+typedef struct {
+    uint64_t tick;
+    uint32_t generation;
+    int32_t score;
+    int32_t lives;
+    uint8_t screen;
+    uint8_t running;
+    uint8_t paused;
+    uint8_t ghostVulnerable;
+    int8_t pacmanRow;
+    int8_t pacmanCol;
+    int8_t pacmanDirection;
+    int8_t ghostRow[MAX_GHOSTS];
+    int8_t ghostCol[MAX_GHOSTS];
+    uint8_t ghostFlags[MAX_GHOSTS]; // SNAPSHOT_GHOST_* bits
+    char ghostCell[MAX_GHOSTS]; // what each ghost is standing on
+    char board[ROWS][COLS];
+} GameSnapshot;
+
+#define SNAPSHOT_GHOST_VULNERABLE 0x01
+#define SNAPSHOT_GHOST_IN_HOUSE 0x02
+#define SNAPSHOT_GHOST_RESPAWNING 0x04
+
+// Bounded output and input for the snapshot codec. Writes past capacity only
+// set overflow; reads past length set error.
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    bool overflow;
+} ByteWriter;
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+    bool error;
+} ByteReader;
+
+typedef struct {
+    GameSnapshot previous;
+    bool havePrevious;
+    int keyframeInterval;
+    uint64_t sinceKeyframe;
+    uint64_t frames;
+    uint64_t keyframes;
+    uint64_t bytes;
+} SnapshotEncoder;
+
+typedef struct {
+    GameSnapshot current;
+    bool haveKeyframe;
+} SnapshotDecoder;
+
+// One ring entry, guarded by a per-slot sequence lock: seq is odd while the
+// engine writes it and 2 * (tick + 1) once tick is complete
+typedef struct {
+    _Atomic uint64_t seq;
+    GameSnapshot snapshot;
+} SpectatorSlot;
+
+// Shared-memory layout of the spectator stream. Only the engine writes;
+// readers map it read-only, never take a lock and never make the engine wait.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t snapshotSize;
+    _Atomic uint64_t published; // ticks written so far
+    _Atomic uint32_t writerAlive;
+    SpectatorSlot slots[SPECTATOR_RING_SLOTS];
+} SpectatorRing;
+
+// Where one captured tick sits in the rewind buffer's byte ring
+typedef struct {
+    uint64_t tick;
+    uint32_t offset;
+    uint32_t length;
+    bool keyframe;
+} RewindFrame;
+
+// The last REWIND_SECONDS of play as codec frames: a byte ring of encoded
+// snapshots and a ring of RewindFrames over it. Whole keyframe groups are
+// dropped from the old end, so the oldest frame kept is always a keyframe.
+// Only the engine thread touches it while the game runs.
+typedef struct {
+    bool enabled;
+    int windowTicks;
+    uint8_t* bytes;
+    size_t byteCapacity;
+    size_t byteHead; // where the next frame goes
+    size_t byteTail; // offset of the oldest frame
+    RewindFrame* frames;
+    int frameCapacity;
+    int first; // ring index of the oldest frame
+    int count;
+    int cursor; // ticks back from the newest frame while paused
+    uint64_t nextTick;
+    SnapshotEncoder encoder;
+    uint64_t captures;
+    uint64_t evictedFrames;
+    uint64_t dropped;
+    uint64_t seeks;
+    uint64_t captureNsTotal;
+    uint64_t captureNsMax;
+    uint64_t captureHistogram[LATENCY_HIST_BUCKETS];
+} RewindBuffer;
+
+// Save file layout: a header, then the whole game as fixed-size plain data.
+// size guards against a build with another board or ghost count.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t checksum;
+} SaveHeader;
+
+typedef struct {
+    int8_t row;
+    int8_t col;
+    int8_t respawnRow;
+    int8_t respawnCol;
+    int8_t direction;
+    char cellContent;
+    uint8_t flags; // SAVE_GHOST_* bits
+    uint8_t houseId;
+    int32_t baseIntervalMs;
+    uint32_t rngSeed;
+    uint64_t boostRemainingNs;
+} SavedGhost;
+
+typedef struct {
+    SaveHeader header;
+    char board[ROWS][COLS];
+    char originalBoard[ROWS][COLS];
+    uint8_t powerPelletLocations[ROWS][COLS];
+    int32_t score;
+    int32_t lives;
+    int32_t level;
+    int32_t pacmanRow;
+    int32_t pacmanCol;
+    int32_t pacmanStartRow;
+    int32_t pacmanStartCol;
+    int32_t direction;
+    float pacmanRotation;
+    float powerPelletDuration;
+    float ghostVulnerableDuration;
+    uint8_t powerPelletActive;
+    uint8_t ghostVulnerable;
+    uint8_t houseQueueLength[MAX_GHOST_HOUSES];
+    uint8_t houseQueue[MAX_GHOST_HOUSES][MAX_GHOSTS]; // ghost ids in ticket order
+    SavedGhost ghosts[MAX_GHOSTS];
+    double boostTokens;
+    int32_t boostNextGhost;
+} SaveState;
+
+#define SAVE_GHOST_VULNERABLE 0x01
+#define SAVE_GHOST_RESPAWNING 0x02
+#define SAVE_GHOST_IN_HOUSE 0x04
+#define SAVE_GHOST_KEY 0x08
+#define SAVE_GHOST_PERMIT 0x10
+#define SAVE_GHOST_BOOSTED 0x20
+
+// What the bot needs to see of a game, from the engine or a session
+typedef struct {
+    char (*board)[COLS];
+    int16_t (*neighbors)[4];
+    int pacmanRow;
+    int pacmanCol;
+    Direction direction;
+    int ghostRow[MAX_GHOSTS];
+    int ghostCol[MAX_GHOSTS];
+    bool ghostDangerous[MAX_GHOSTS]; // touching it costs a life
+    bool ghostPrey[MAX_GHOSTS];      // vulnerable, worth chasing
+} BotView;
+
+typedef struct {
+    unsigned int generation;
+    int lives;
+    bool restartPosted; // a new game was asked for and has not started yet
+    uint64_t polls;
+    uint64_t turns;
+    uint64_t flees;
+    uint64_t deaths;
+    uint64_t games;
+    uint64_t scoreTotal;
+    int bestScore;
+    uint64_t planNsTotal;
+    uint64_t planNsMax;
+    CellNeighbors neighbors; // rebuilt from the board whenever generation changes
+} BotState;
+
+// Anything other than the keyboard that steers pacman. poll runs every
+// pollMs on the source's own thread and acts through addInputEvent().
+typedef struct InputSource {
+    const char* name;
+    int pollMs;
+    void (*poll)(struct InputSource* source);
+    void (*report)(struct InputSource* source);
+    void* state;
+    atomic_bool running;
+    pthread_t thread;
+    bool threadStarted;
+} InputSource;
+
+// One parameter set of a rollout batch
+typedef struct {
+    const char* name;
+    SessionRules rules;
+} RolloutPreset;
+
+// How one rollout game went
+typedef struct {
+    int score;
+    uint32_t ticks;     // pacman ticks played
+    uint8_t livesLost;
+    bool survived;      // still playing at ROLLOUT_MAX_SECONDS
+} RolloutResult;
+
+typedef struct {
+    int id;
+    int cpu;
+    pthread_t thread;
+    bool started;
+    uint64_t games;
+    uint64_t ticks;
+    uint64_t cpuNs;
+} RolloutWorker;
+
+// A batch of games: presetCount sets of gamesPerSet. Game g plays preset
+// g / gamesPerSet from starts[] and writes results[g]; workers claim games
+// ROLLOUT_CHUNK at a time from nextGame.
+typedef struct {
+    const RolloutPreset* presets;
+    int presetCount;
+    int gamesPerSet;
+    GameSession* starts;
+    RolloutResult* results;
+    atomic_int nextGame;
+    RolloutWorker workers[SESSION_MAX_WORKERS];
+    int workerCount;
+} RolloutBatch;
+
+// Size and mtime of a file the bundle was packed from, so a bundle older than
+// its sprites or font is noticed
+typedef struct {
+    uint64_t size;
+    int64_t mtimeNs;
+} AssetSourceStat;
+
+// Asset bundle layout: header, one AssetRect per AssetId, the RGBA atlas
+// pixels and then the raw font file, all at fixed offsets so the whole thing
+// can be mapped and handed to SFML without any parsing or decoding.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t atlasWidth;
+    uint32_t atlasHeight;
+    uint32_t spriteCount;
+    uint32_t reserved;
+    uint64_t pixelsOffset;
+    uint64_t fontOffset;
+    uint64_t fontSize;
+    AssetSourceStat sources[ASSET_COUNT + 1]; // the sprites, then FONT_FILE
+} AssetBundleHeader;
+
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+} AssetRect;
+
+typedef struct {
+    sfFont* font;
+    sfTexture* textures[ASSET_COUNT]; // all point at the atlas when loaded from a bundle
+    sfIntRect rects[ASSET_COUNT];
+    bool fromBundle;
+    void* bundleMap;                  // kept mapped: the font reads from it lazily
+    size_t bundleSize;
+} GameAssets;
+
+typedef struct {
+    const char* path;
+    sfImage* image;
+} ImageDecodeJob;
+
+typedef struct {
+    const char* name;
+    uint64_t startNs;
+    uint64_t durationNs;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent events[TRACE_RING_SIZE];
+    _Atomic uint64_t head; // only the owning thread advances it
+    int tid;
+    char threadName[24];
+} TraceRing;
+
+typedef struct {
+    const char* name; // NULL when tracing was off at span start
+    uint64_t startNs;
+} TraceSpan;
+
+typedef struct {
+    const char* file;
+    _Atomic int line; // 0 marks a free slot, -1 one being claimed
+    _Atomic uint64_t acquires;
+    _Atomic uint64_t timeouts;
+    _Atomic uint64_t waitNsTotal;
+} LockSiteStats;
+
+typedef struct {
+    pthread_mutex_t* mutex;
+    const char* name;
+    _Atomic uint64_t acquires;
+    _Atomic uint64_t contended;
+    _Atomic uint64_t timeouts;
+    _Atomic uint64_t waitNsTotal;
+    _Atomic uint64_t holdNsTotal;
+    _Atomic uint64_t maxWaitNs;
+    _Atomic uint64_t maxHoldNs;
+    _Atomic uint64_t waitHistogram[LOCK_HIST_BUCKETS];
+    _Atomic uint64_t holdHistogram[LOCK_HIST_BUCKETS];
+    uint64_t lockedAtNs; // written by the current holder only
+    LockSiteStats sites[MAX_LOCK_SITES];
+} LockStats;
+
+typedef enum {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_OFF
+} LogLevel;
+
+typedef struct {
+    uint64_t timestampNs;
+    LogLevel level;
+    char text[LOG_MESSAGE_SIZE];
+} LogRecord;
+
+typedef struct {
+    LogRecord records[LOG_RING_SIZE];
+    _Atomic uint64_t head; // advanced by the owning thread
+    _Atomic uint64_t tail; // advanced by the drain thread
+    _Atomic uint64_t dropped;
+    char threadName[24];
+} LogRing;
+
+// Liveness of one long-running thread. The owner bumps beats once per tick
+// and marks the lock it is blocked on; only the watchdog writes the stall
+// bookkeeping. A slot is handed back when its thread exits and reused by the
+// next thread to register; until then the report still shows it.
+typedef struct {
+    char name[24];
+    atomic_bool active;
+    bool inUse; // claimed by a live thread; under heartbeatSlotsMutex
+    atomic_int expectedMs; // how often the owner should beat
+    _Atomic uint64_t beats;
+    _Atomic uint64_t lastBeatNs;
+    _Atomic(const char*) waitingOn; // lock name while blocked on it, else NULL
+    _Atomic uint64_t waitStartNs;
+    _Atomic uint64_t stalls;
+    bool stalled;
+    uint64_t stalledSinceNs;
+    uint64_t longestStallNs;
+} Heartbeat;
+
 
 pthread_mutex_t speedBoostAvailMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t gameEngineThreadExitMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t ghostExitMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t ghostHouseMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t ghostMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t eventQueueMutex = PTHREAD_MUTEX_INITIALIZER;
 
-pthread_cond_t gameEngineThreadExitCond = PTHREAD_COND_INITIALIZER;
-pthread_cond_t ghostExitCond = PTHREAD_COND_INITIALIZER;
+CancelSignal simulationCancel;
+TimerThreadArgs gameTickTimer; // tick config and lateness stats; the engine's timerfd fires it
+
+// The engine waits on these in one epoll loop: the tick timerfd, an eventfd
+// bumped by addInputEvent() and one bumped by cancelSimulation()
+int engineEpollFd = -1;
+int engineTimerFd = -1;
+int engineInputFd = -1;
+int engineControlFd = -1;
+
+SessionManager sessionManager;
+RolloutBatch rolloutBatch;
 
-sem_t keySemaphore;
-sem_t exitPermitSemaphore;
-sem_t speedBoostSemaphore;
+ResourceLedger boostLedger; // guarded by speedBoostAvailMutex
+BoostScheduler boostScheduler; // guarded by speedBoostAvailMutex
+atomic_ullong resourceViolations = 0;
 
-bool speedBoostAvailable = false;
-bool gameEngineThreadExited = false;
-int ghostThreadsExited = 0;
-bool ghostThreadsRunning = true;
 float pelletBlinkInterval = 0.3f;
 int pelletVisible = 1;
 int eventQueueHead = 0;
 int eventQueueTail = 0;
 int scoreCount = 0;
+uint64_t lastScoreRank = 0;
+uint64_t lastScoreTotal = 0;
+uint64_t lastScoreNearby = 0;
 
 InputEvent inputEventQueue[MAX_INPUT_EVENTS];
 ScoreEntry scoreBoard[MAX_SCORES];
+ScoreStore scoreStore = { -1, 0, NULL, NULL };
+SpectatorRing* spectatorRing = NULL; // set when PACMAN_SPECTATE is on
+char spectatorShmName[64];
+RewindBuffer rewindBuffer; // enabled by PACMAN_REWIND
+const char* saveFilePath = SAVE_FILE; // PACMAN_SAVE_FILE overrides
 Ghost ghosts[MAX_GHOSTS];
+GhostHouse ghostHouses[MAX_GHOST_HOUSES];
 GameState gameState;
+SessionTemplate sessionTemplate;
+// The level being loaded, and the buffers its maze is carved into; only
+// the engine thread loads levels
+SessionTemplate levelTemplate;
+static char levelMazeCells[ROWS * COLS];
+static int levelMazeStack[(ROWS / 2) * (COLS / 2) + 1];
+const SessionRules sessionDefaultRules = {
+    GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+    BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS
+};
 UIState uiState;
+RealtimeConfig realtimeConfig = { -1, -1, -1, 0, false };
+BoardLockMode boardLockMode = BOARD_LOCK_TILES;
+TileLockGrid boardTiles;
+
+atomic_bool tracingEnabled = false;
+char traceOutputPath[256] = TRACE_FILE;
+_Atomic(TraceRing*) traceRings[MAX_TRACE_THREADS];
+atomic_int traceRingCount = 0;
+static __thread TraceRing* traceThreadRing = NULL;
+
+LockStats lockStatsTable[MAX_PROFILED_LOCKS];
+atomic_int lockStatsCount = 0;
+pthread_mutex_t lockStatsRegistryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+atomic_int logLevel = LOG_LEVEL_INFO;
+atomic_bool logRunning = false;
+_Atomic(LogRing*) logRings[MAX_LOG_THREADS];
+atomic_int logRingCount = 0;
+uint64_t logStartNs = 0;
+pthread_t logThread;
+static __thread LogRing* logThreadRing = NULL;
 
+Heartbeat heartbeats[MAX_HEARTBEATS];
+atomic_int heartbeatCount = 0; // slots ever used
+pthread_mutex_t heartbeatSlotsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t heartbeatKey;
+static pthread_once_t heartbeatKeyOnce = PTHREAD_ONCE_INIT;
+static __thread Heartbeat* threadHeartbeat = NULL;
+atomic_ullong watchdogStalls = 0;
+atomic_bool watchdogRunning = false;
+volatile sig_atomic_t watchdogDumpRequested = 0;
+pthread_t watchdogThread;
+pthread_mutex_t watchdogMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t watchdogCond;
+
+bool openScoreStore(const char* path);
+void closeScoreStore();
+bool scoreStoreInsert(const char* username, int score);
+uint64_t scoreStoreRank(int score);
+uint64_t scoreStoreCount();
+int scoreStoreRange(uint64_t firstRank, int maxCount, ScoreEntry* out);
+uint64_t scoreStoreCountInRange(int minScore, int maxScore);
+int importLegacyScores(const char* path);
 void loadScores();
 void saveScores();
 void addScore(const char* username, int score);
-void saveOriginalBoard();
 void initGhostHouseResources();
-bool tryAcquireGhostHouseResources(Ghost* ghost, struct timespec* timeout);
+bool tryAcquireGhostHouseResources(Ghost* ghost);
 void releaseGhostHouseResources(Ghost* ghost);
-void initGhosts();
-bool isValidGhostMove(int row, int col);
-DirectionWeights calculateDirectionWeights(Ghost* ghost, int targetRow, int targetCol);
-Direction chooseGhostDirection(Ghost* ghost, DirectionWeights weights); 
+bool ghostHouseTryAcquire(GhostHouse* house, Ghost* roster, Ghost* ghost);
+void ghostHouseRelease(GhostHouse* house, Ghost* roster, Ghost* ghost);
+void resetGhostSlots(Ghost* roster, char board[ROWS][COLS]);
+bool isValidGhostMove(char board[ROWS][COLS], int row, int col);
+DirectionWeights calculateDirectionWeights(Ghost* ghost, int targetRow, int targetCol, Direction targetDirection);
+void publishPacmanView();
+PacmanView loadPacmanView();
+bool tileGridInit(TileLockGrid* grid, int rows, int cols, int tileSize);
+void tileGridDestroy(TileLockGrid* grid);
+int tileGridLockCells(TileLockGrid* grid, int row1, int col1, int row2, int col2, int held[2]);
+void tileGridUnlock(TileLockGrid* grid, const int held[2], int count);
+void tileGridLockAll(TileLockGrid* grid);
+void tileGridUnlockAll(TileLockGrid* grid);
+void initBoardLocks();
+BoardCellLock lockBoardCells(int row1, int col1, int row2, int col2);
+BoardCellLock lockBoardTiles(int row1, int col1, int row2, int col2);
+void unlockBoardCells(BoardCellLock lock);
+void lockWholeBoard();
+void unlockWholeBoard();
+int runMoveBenchmark(int maxGhosts);
+bool mazeCarve(GeneratedMaze* maze, char* buffer, int* stack, int rows, int cols,
+               int houseRow, int houseCol, int openness, unsigned int seed);
+bool mazeGenerate(GeneratedMaze* maze, int rows, int cols, int openness, unsigned int seed);
+void mazeFree(GeneratedMaze* maze);
+bool mazeValidate(const GeneratedMaze* maze);
+bool mazeInHouse(const GeneratedMaze* maze, int row, int col);
+void mazeGhostSpawn(const GeneratedMaze* maze, int ghost, int* row, int* col);
+int runMazeBenchmark(int maxSide, int openness);
+int ghostOpenMoves(char board[ROWS][COLS], CellNeighbors neighbors, const Ghost* ghost,
+                   bool validMoves[4]);
+int lockedGhostOpenMoves(const Ghost* ghost, bool validMoves[4]);
+Direction chooseGhostDirection(const bool validMoves[4], int validCount, Ghost* ghost,
+                               DirectionWeights weights);
 void moveGhost(Ghost* ghost, Direction direction); 
 void* ghostThreadFunc(void* arg);
 void cleanupGhostHouseResources();
+void printGhostHouseReport();
+void ledgerInit(ResourceLedger* ledger, const char* name, int total);
+bool ledgerTake(ResourceLedger* ledger, int ghostId);
+bool ledgerGive(ResourceLedger* ledger, int ghostId);
+void returnSpeedBoost(Ghost* ghost);
+void boostSchedulerInit();
+void boostSchedulerTick();
+void printBoostReport();
+void verifyGhostHouseState();
 void* ghostTimerThread(void* arg);
+void initSimulationCancel();
+void cancelSimulation();
+bool simulationCancelled();
+void wakeSimulationSleepers();
+bool cancellableSleepMs(int ms, atomic_bool* keepRunning);
+bool cancellableSleepUntil(const struct timespec* deadline, atomic_bool* keepRunning);
+void runTimerLoop(TimerThreadArgs* args);
+void loadRealtimeConfig();
+void applyThreadPlacement(const char* who, int cpu, int fifoPriority);
+void lockSimulationMemory();
+void printSchedLatencyReport();
 void startGhostThreads();
 void stopGhostThreads(); 
+void formatWithCommas(uint64_t value, char* out, size_t outSize);
 void renderGameOver(sfRenderWindow* window, sfFont* font); 
 void addInputEvent(int eventType, int data);
 void initUIState();
 void initGameState(); 
+void buildSessionTemplate();
+void fillSessionTemplate(SessionTemplate* layout, const char board[ROWS][COLS]);
+void buildNeighborTable(CellNeighbors neighbors, const char board[ROWS][COLS]);
+void resetSession();
+void loadNextLevel();
+bool ghostSessionChanged(Ghost* ghost);
 bool isInGhostHouse(int row, int col); 
+void pacmanCaughtLocked(int row, int col);
+void ghostCatchesPacman(Ghost* ghost, int row, int col);
 void movePacman(); 
 void renderMenu(sfRenderWindow* window, sfFont* font);
 void renderScoreboard(sfRenderWindow* window, sfFont* font); 
 void renderInstructions(sfRenderWindow* window, sfFont* font); 
 void renderGame(sfRenderWindow* window, sfRectangleShape* wall, sfCircleShape* dot, sfCircleShape* powerPellet, sfSprite* pacmanSprite, sfSprite* ghost1Sprite, sfSprite* ghost2Sprite, sfSprite* ghost3Sprite, sfSprite* ghost4Sprite, sfSprite* ghost5Sprite, sfText* scoreText, sfText* livesText, sfSprite* lifeSprite);
 void processInput(sfRenderWindow* window);
-void* gameTickTimerThread(void* arg); 
+bool initEngineEvents();
+void closeEngineEvents();
 void* gameEngineThreadFunc(void* arg); 
+bool spectatorRingOpen(const char* name);
+void spectatorRingClose();
+void captureGameSnapshot(GameSnapshot* snapshot);
+void spectatorPublish(const GameSnapshot* captured);
+int runSpectatorViewer(const char* name);
+void sessionReset(GameSession* session);
+void snapshotEncoderInit(SnapshotEncoder* encoder, int keyframeInterval);
+size_t snapshotEncode(SnapshotEncoder* encoder, const GameSnapshot* snapshot, uint8_t* out, size_t outSize);
+void snapshotDecoderInit(SnapshotDecoder* decoder);
+bool snapshotDecode(SnapshotDecoder* decoder, const uint8_t* frame, size_t length, GameSnapshot* out);
+int runCodecBenchmark(int minutes);
+bool rewindInit(int seconds, int kilobytes);
+void rewindDestroy();
+void rewindCapture(GameSnapshot* snapshot);
+bool rewindSeek(RewindBuffer* rewind, int ticksBack, GameSnapshot* out);
+void rewindRestore(const GameSnapshot* snapshot);
+void rewindStep(int ticksBack);
+void printRewindReport();
+void captureSaveState(SaveState* save);
+void restoreSaveState(const SaveState* save);
+bool saveGame(const char* path);
+bool loadGame(const char* path);
+Direction botChooseDirection(const BotView* view, bool* fled);
+InputSource* findInputSource(const char* name);
+bool inputSourceStart(InputSource* source);
+void inputSourceStop(InputSource* source);
+int runBotBenchmark(int seconds);
+int runRollouts(int gamesPerSet, int workerCount);
+bool sessionManagerStart(int workerCount);
+void sessionManagerStop();
+GameSession* sessionCreate(bool autopilot);
+void sessionDestroy(GameSession* session);
+void sessionClone(GameSession* dst, const GameSession* src);
+void printSessionReport();
+int runSessionServer(const char* socketPath);
+int runSessionBenchmark(int sessionCount, int seconds);
+void traceSetThreadName(const char* name);
+TraceSpan traceBegin(const char* name);
+void traceEnd(TraceSpan span);
+int tracedMutexLock(pthread_mutex_t* mutex, const char* spanName);
+int tracedMutexTimedLock(pthread_mutex_t* mutex, const struct timespec* timeout, const char* spanName);
+bool traceDump(const char* path);
+void traceStart(const char* path);
+int profiledMutexLock(pthread_mutex_t* mutex, const char* spanName, const char* file, int line);
+int profiledMutexTimedLock(pthread_mutex_t* mutex, const struct timespec* timeout,
+                           const char* spanName, const char* file, int line);
+int profiledMutexUnlock(pthread_mutex_t* mutex);
+void printLockReport();
+void logSetThreadName(const char* name);
+void setThreadName(const char* name);
+void logWrite(LogLevel level, const char* format, ...);
+void logInit();
+void logShutdown();
+void heartbeatRegister(const char* name, int expectedMs);
+void heartbeatUnregister();
+void heartbeat();
+void heartbeatWaitBegin(const char* lockName);
+void heartbeatWaitEnd();
+void watchdogStart();
+void watchdogStop();
+uint64_t watchdogStallCount();
+void printWatchdogReport();
+double monotonicMs();
+bool decodeImagesParallel(ImageDecodeJob* jobs, int count);
+int packAssetBundle(const char* path);
+bool loadAssetBundle(const char* path, GameAssets* assets);
+bool loadAssetFiles(GameAssets* assets);
+void destroyAssets(GameAssets* assets);
 
 
-void handlePacmanLeaving(int row, int col) {
-    // If there was a power pellet at this location, restore it
-    if (gameState.powerPelletLocations[row][col]) {
-        gameState.board[row][col] = '0';
-    } else {
-        gameState.board[row][col] = ' ';
+static inline uint64_t timespecNs(const struct timespec* ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ull + ts->tv_nsec;
+}
+
+// The one clock every timing, tracing and profiling path reads
+static inline uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespecNs(&ts);
+}
+
+
+// ---------------------------------------------------------------------------
+// Tracing: spans go into a per-thread ring that only its owner writes, so
+// recording is a couple of stores and no locks. With tracing compiled in but
+// not enabled at runtime a span costs one relaxed atomic load.
+// ---------------------------------------------------------------------------
+#if ENABLE_TRACING
+
+static TraceRing* traceRegisterThread() {
+    int slot = atomic_fetch_add(&traceRingCount, 1);
+    if (slot >= MAX_TRACE_THREADS) {
+        atomic_fetch_sub(&traceRingCount, 1);
+        return NULL;
     }
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->tid = slot + 1;
+    snprintf(ring->threadName, sizeof(ring->threadName), "thread %d", ring->tid);
+    atomic_store_explicit(&traceRings[slot], ring, memory_order_release);
+    return ring;
 }
-//scoreBoard functions
-void loadScores() {
-    FILE* file = fopen(SCORE_FILE, "r");
-    if (file == NULL) {
-        scoreCount = 0;
+
+static inline TraceRing* traceCurrentRing() {
+    if (traceThreadRing == NULL) {
+        traceThreadRing = traceRegisterThread();
+    }
+    return traceThreadRing;
+}
+
+void traceSetThreadName(const char* name) {
+    if (!atomic_load_explicit(&tracingEnabled, memory_order_relaxed)) {
         return;
     }
-    scoreCount = 0;
-    while (fscanf(file, "%31s %d",
-                 scoreBoard[scoreCount].username,
-                 &scoreBoard[scoreCount].score) == 2) {
-        scoreCount++;
-        if (scoreCount >= MAX_SCORES) {
-            break;
-        }
+    TraceRing* ring = traceCurrentRing();
+    if (ring != NULL) {
+        strncpy(ring->threadName, name, sizeof(ring->threadName) - 1);
     }
-    fclose(file);
 }
 
-void saveScores() {
-    FILE* file = fopen(SCORE_FILE, "w");
-    if (file == NULL) {
-        printf("Error opening score file for writing.\n");
-        return;
+TraceSpan traceBegin(const char* name) {
+    TraceSpan span = { NULL, 0 };
+    if (atomic_load_explicit(&tracingEnabled, memory_order_relaxed)) {
+        span.name = name;
+        span.startNs = monotonicNs();
     }
+    return span;
+}
 
-    for (int i = 0; i < scoreCount; i++) {
-        fprintf(file, "%s %d\n", scoreBoard[i].username, scoreBoard[i].score);
+void traceEnd(TraceSpan span) {
+    if (span.name == NULL) {
+        return;
     }
-    fclose(file);
+    TraceRing* ring = traceCurrentRing();
+    if (ring == NULL) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent* event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->name = span.name;
+    event->startNs = span.startNs;
+    event->durationNs = monotonicNs() - span.startNs;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 }
 
-void addScore(const char* username, int score) {
-    if (scoreCount < MAX_SCORES || score > scoreBoard[scoreCount-1].score) {
-        int insertPos = scoreCount;
-        for (int i = 0; i < scoreCount; i++) {
-            if (score > scoreBoard[i].score) {
-                insertPos = i;
-                break;
-            }
-        }
+int tracedMutexLock(pthread_mutex_t* mutex, const char* spanName) {
+    TraceSpan span = traceBegin(spanName);
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_lock(mutex);
+    heartbeatWaitEnd();
+    traceEnd(span);
+    return result;
+}
 
-        if (scoreCount == MAX_SCORES) {
-            insertPos = MAX_SCORES - 1;
-        }
+int tracedMutexTimedLock(pthread_mutex_t* mutex, const struct timespec* timeout, const char* spanName) {
+    TraceSpan span = traceBegin(spanName);
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_timedlock(mutex, timeout);
+    heartbeatWaitEnd();
+    traceEnd(span);
+    return result;
+}
 
-        if (scoreCount < MAX_SCORES) {
-            scoreCount++;
-        }
+// Writes every ring as Chrome trace-event JSON (chrome://tracing, Perfetto).
+// Safe while threads keep recording: events overwritten during the copy are
+// detected from the head counter and skipped.
+bool traceDump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Error opening trace file %s\n", path);
+        return false;
+    }
+    int pid = (int)getpid();
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    size_t written = 0;
+    int ringCount = atomic_load(&traceRingCount);
+    if (ringCount > MAX_TRACE_THREADS) ringCount = MAX_TRACE_THREADS;
 
-        for (int i = scoreCount-1; i > insertPos; i--) {
-            scoreBoard[i] = scoreBoard[i-1];
+    for (int r = 0; r < ringCount; r++) {
+        TraceRing* ring = atomic_load_explicit(&traceRings[r], memory_order_acquire);
+        if (ring == NULL) {
+            continue;
         }
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", pid, ring->tid, ring->threadName);
+        first = false;
 
-        strncpy(scoreBoard[insertPos].username, username, 31);
-        scoreBoard[insertPos].username[31] = '\0';
-        scoreBoard[insertPos].score = score;
-
-        saveScores();
-    }
-}
-
-void saveOriginalBoard() {
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            if (gameState.board[i][j] != '#' && gameState.board[i][j] != '@') {
-                gameState.originalBoard[i][j] = gameState.board[i][j];
-            } else {
-                gameState.originalBoard[i][j] = ' ';
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t begin = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (uint64_t i = begin; i < head; i++) {
+            TraceEvent event = ring->events[i & (TRACE_RING_SIZE - 1)];
+            // The owner writes event i + TRACE_RING_SIZE into this slot while
+            // head still equals that index, so a head that far along means
+            // the copy may be torn. The fence keeps the reload after the copy.
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t headNow = atomic_load_explicit(&ring->head, memory_order_relaxed);
+            if (headNow >= i + TRACE_RING_SIZE) {
+                continue;
             }
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event.name, pid, ring->tid, event.startNs / 1000.0, event.durationNs / 1000.0);
+            written++;
         }
     }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+    printf("Wrote %zu trace events to %s\n", written, path);
+    return true;
 }
 
-void resetGhost(Ghost* ghost) {
-    pthread_mutex_lock(&gameState.mutex);
-    ghost->row = ghost->respawnRow;
-    ghost->col = ghost->respawnCol;
-    
-    ghost->isVulnerable = false;
-    ghost->needsRespawn = false;
-    ghost->inGhostHouse = true;
-    ghost->hasKey = false;
-    ghost->hasExitPermit = false;
-    ghost->hasSpeedBoost = false;
-    ghost->speedBoostDuration = 0.0f;
-    
-    ghost->cellContent = gameState.board[ghost->row][ghost->col];
-    gameState.board[ghost->row][ghost->col] = '#';
-    
-    //printf("Ghost %d has been reset\n", ghost->id);
-    pthread_mutex_unlock(&gameState.mutex);
+void traceStart(const char* path) {
+    strncpy(traceOutputPath, path, sizeof(traceOutputPath) - 1);
+    atomic_store(&tracingEnabled, true);
 }
 
-void initGhostHouseResources() {
-    sem_init(&keySemaphore, 0, MAX_KEYS + 1); // 3 keys
-    sem_init(&exitPermitSemaphore, 0, MAX_EXIT_PERMITS + 1);
-    sem_init(&speedBoostSemaphore, 0, 2); // 2 ghosts have speed boost
-    
-    // Initialize signal for availability
-    pthread_mutex_lock(&speedBoostAvailMutex);
-    speedBoostAvailable = true;
-    pthread_mutex_unlock(&speedBoostAvailMutex);
+#else
+
+void traceSetThreadName(const char* name) { (void)name; }
+TraceSpan traceBegin(const char* name) { (void)name; TraceSpan span = { NULL, 0 }; return span; }
+void traceEnd(TraceSpan span) { (void)span; }
+int tracedMutexLock(pthread_mutex_t* mutex, const char* spanName) {
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_lock(mutex);
+    heartbeatWaitEnd();
+    return result;
 }
+int tracedMutexTimedLock(pthread_mutex_t* mutex, const struct timespec* timeout, const char* spanName) {
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_timedlock(mutex, timeout);
+    heartbeatWaitEnd();
+    return result;
+}
+bool traceDump(const char* path) { (void)path; return false; }
+void traceStart(const char* path) { (void)path; printf("Tracing was compiled out (ENABLE_TRACING=0)\n"); }
 
-bool tryAcquireGhostHouseResources(Ghost* ghost, struct timespec* timeout) {
-    if (!ghost->inGhostHouse) return true;
-    // check if already has resources
-    pthread_mutex_lock(&ghostHouseMutex);
-    if (ghost->hasKey && ghost->hasExitPermit) {
-        pthread_mutex_unlock(&ghostHouseMutex);
-        return true;
+#endif
+
+// ---------------------------------------------------------------------------
+// Lock profiling: MUTEX_LOCK / MUTEX_TIMEDLOCK / MUTEX_UNLOCK wrap the shared
+// game mutexes and keep per-lock and per-call-site counters. An uncontended
+// acquire is a trylock plus one clock read (two more and a trace event while
+// tracing); only contended acquires pay for the wait measurement.
+// ---------------------------------------------------------------------------
+#if ENABLE_LOCK_PROFILING
+
+// Bucket 0 is < 1us, bucket k covers [2^(k-1), 2^k) us, the last is open-ended
+static inline int lockHistogramBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us == 0) {
+        return 0;
     }
-    pthread_mutex_unlock(&ghostHouseMutex);
+    int bucket = 64 - __builtin_clzll(us);
+    return bucket < LOCK_HIST_BUCKETS ? bucket : LOCK_HIST_BUCKETS - 1;
+}
 
-    // ensures no two ghosts try acquiring simultaneously.
-    static pthread_mutex_t resourceAcquisitionMutex = PTHREAD_MUTEX_INITIALIZER;
-    struct timespec acquisitionTimeout = *timeout;
-    
-    acquisitionTimeout.tv_nsec += (rand() % 100000000);
-    if (acquisitionTimeout.tv_nsec >= 1000000000) {
-        acquisitionTimeout.tv_sec++;
-        acquisitionTimeout.tv_nsec -= 1000000000;
+static inline void lockStatsMax(_Atomic uint64_t* target, uint64_t value) {
+    uint64_t current = atomic_load_explicit(target, memory_order_relaxed);
+    while (value > current &&
+           !atomic_compare_exchange_weak_explicit(target, &current, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
     }
-    
-    if (pthread_mutex_timedlock(&resourceAcquisitionMutex, &acquisitionTimeout) != 0) {
-        return false; 
+}
+
+static LockStats* lockStatsFor(pthread_mutex_t* mutex, const char* name) {
+    int count = atomic_load_explicit(&lockStatsCount, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (lockStatsTable[i].mutex == mutex) {
+            return &lockStatsTable[i];
+        }
     }
-    
-    int keyResult = sem_timedwait(&keySemaphore, timeout);
-    if (keyResult != 0) {
-        pthread_mutex_unlock(&resourceAcquisitionMutex);
-        return false;
+
+    // First sighting of this mutex: register it (rare, so a plain lock is fine)
+    pthread_mutex_lock(&lockStatsRegistryMutex);
+    count = atomic_load_explicit(&lockStatsCount, memory_order_relaxed);
+    for (int i = 0; i < count; i++) {
+        if (lockStatsTable[i].mutex == mutex) {
+            pthread_mutex_unlock(&lockStatsRegistryMutex);
+            return &lockStatsTable[i];
+        }
     }
-    
-    int permitResult = sem_timedwait(&exitPermitSemaphore, timeout);
-    if (permitResult != 0) {
-        // Release the key if we couldn't get the permit
-        sem_post(&keySemaphore);
-        pthread_mutex_unlock(&resourceAcquisitionMutex);
-        return false;
+    LockStats* stats = NULL;
+    if (count < MAX_PROFILED_LOCKS) {
+        stats = &lockStatsTable[count];
+        stats->mutex = mutex;
+        stats->name = (strncmp(name, "lock ", 5) == 0) ? name + 5 : name;
+        atomic_store_explicit(&lockStatsCount, count + 1, memory_order_release);
     }
-    
-    // Successfully got both resources
-    pthread_mutex_lock(&ghostHouseMutex);
-    ghost->hasKey = true;
-    ghost->hasExitPermit = true;
-    pthread_mutex_unlock(&ghostHouseMutex);
-    
-    pthread_mutex_unlock(&resourceAcquisitionMutex);
-    return true;
+    pthread_mutex_unlock(&lockStatsRegistryMutex);
+    return stats;
 }
 
-void verifyGhostHouseState() {
-    // Check if semaphores have correct values
-    int keyValue, permitValue, speedValue;
-    sem_getvalue(&keySemaphore, &keyValue);
-    sem_getvalue(&exitPermitSemaphore, &permitValue);
-    sem_getvalue(&speedBoostSemaphore, &speedValue);
-    
-   // printf("Ghost house state: keys=%d, permits=%d, speedBoosts=%d\n", 
-     //      keyValue, permitValue, speedValue);
-    
-    // Reset to proper values if needed
-    if (keyValue <= 0) {
-        sem_destroy(&keySemaphore);
-        sem_init(&keySemaphore, 0, MAX_KEYS + 1);
-      //  printf("Reset key semaphore to %d\n", MAX_KEYS + 1);
+// Sites are keyed by file and line. A free slot is claimed by moving its
+// line from 0 to -1, and published with the real line once file is set.
+static LockSiteStats* lockSiteFor(LockStats* stats, const char* file, int line) {
+    for (int i = 0; i < MAX_LOCK_SITES; i++) {
+        LockSiteStats* site = &stats->sites[i];
+        int siteLine = atomic_load_explicit(&site->line, memory_order_acquire);
+        if (siteLine == 0) {
+            int expected = 0;
+            if (atomic_compare_exchange_strong(&site->line, &expected, -1)) {
+                site->file = file;
+                atomic_store_explicit(&site->line, line, memory_order_release);
+                return site;
+            }
+            siteLine = expected;
+        }
+        while (siteLine < 0) { // another thread is filling this slot in
+            siteLine = atomic_load_explicit(&site->line, memory_order_acquire);
+        }
+        if (siteLine == line && (site->file == file || strcmp(site->file, file) == 0)) {
+            return site;
+        }
     }
-    
-    if (permitValue <= 0) {
-        sem_destroy(&exitPermitSemaphore);
-        sem_init(&exitPermitSemaphore, 0, MAX_EXIT_PERMITS + 1);
-       // printf("Reset permit semaphore to %d\n", MAX_EXIT_PERMITS + 1);
+    return NULL; // table full: the lock totals still count it
+}
+
+static void lockRecordAcquire(LockStats* stats, LockSiteStats* site, uint64_t waitNs,
+                              bool contended, uint64_t acquiredAtNs) {
+    atomic_fetch_add_explicit(&stats->acquires, 1, memory_order_relaxed);
+    if (contended) {
+        atomic_fetch_add_explicit(&stats->contended, 1, memory_order_relaxed);
     }
-    
-    if (speedValue <= 0) {
-        sem_destroy(&speedBoostSemaphore);
-        sem_init(&speedBoostSemaphore, 0, 2);
-        // printf("Reset speed boost semaphore to 2\n");
+    atomic_fetch_add_explicit(&stats->waitNsTotal, waitNs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->waitHistogram[lockHistogramBucket(waitNs)], 1, memory_order_relaxed);
+    lockStatsMax(&stats->maxWaitNs, waitNs);
+    if (site != NULL) {
+        atomic_fetch_add_explicit(&site->acquires, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->waitNsTotal, waitNs, memory_order_relaxed);
     }
+    // Only the holder touches these until it unlocks
+    stats->lockedAtNs = acquiredAtNs;
 }
 
-void releaseGhostHouseResources(Ghost* ghost) {
-    bool hadKey = false;
-    bool hadPermit = false;
-    
-    pthread_mutex_lock(&ghostHouseMutex);
-    // Save the state and update ghost flags atomically
-    hadKey = ghost->hasKey;
-    hadPermit = ghost->hasExitPermit;
-    ghost->hasKey = false;
-    ghost->hasExitPermit = false;
-    pthread_mutex_unlock(&ghostHouseMutex);
-    
-    // release the actual semaphores based on saved state
-    if (hadKey) {
-        sem_post(&keySemaphore);
-        printf("Ghost %d released key\n", ghost->id);
+int profiledMutexLock(pthread_mutex_t* mutex, const char* spanName, const char* file, int line) {
+    LockStats* stats = lockStatsFor(mutex, spanName);
+    if (stats == NULL) {
+        return tracedMutexLock(mutex, spanName);
     }
-    
-    if (hadPermit) {
-        sem_post(&exitPermitSemaphore);
-        printf("Ghost %d released exit permit\n", ghost->id);
+    LockSiteStats* site = lockSiteFor(stats, file, line);
+
+    // Every acquire gets its span in the trace, the uncontended ones too
+    TraceSpan span = traceBegin(spanName);
+    if (pthread_mutex_trylock(mutex) == 0) {
+        traceEnd(span);
+        lockRecordAcquire(stats, site, 0, false, monotonicNs());
+        return 0;
     }
+
+    uint64_t start = monotonicNs();
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_lock(mutex);
+    heartbeatWaitEnd();
+    uint64_t acquired = monotonicNs();
+    traceEnd(span);
+    if (result == 0) {
+        lockRecordAcquire(stats, site, acquired - start, true, acquired);
+    }
+    return result;
 }
 
-void initGhosts() {
-    int ghostStartPositions[MAX_GHOSTS][2] = {
-        {6, 8},
-        {6, 9},
-        {7, 11},
-        {7, 12}
-    };
-    
-    int ghostRespawnPositions[MAX_GHOSTS][2] = {
-        {7, 8},  // Respawn in same positions
-        {7, 9},
-        {7, 10},
-        {7, 11}
-    };
-    
-    pthread_mutex_lock(&gameState.mutex);
-   
-    for (int i = 0; i < MAX_GHOSTS; i++) {
-        ghosts[i].row = ghostStartPositions[i][0];
-        ghosts[i].col = ghostStartPositions[i][1];
-        ghosts[i].id = i;
-        ghosts[i].direction = DIR_NONE;
-        ghosts[i].isVulnerable = false;
-        ghosts[i].isActive = true;
-        ghosts[i].needsRespawn = false;
-        ghosts[i].respawnRow = ghostRespawnPositions[i][0];
-        ghosts[i].respawnCol = ghostRespawnPositions[i][1];
-        ghosts[i].ghostType = i + 1;
-        ghosts[i].hasSpeedBoost = false;
-        ghosts[i].speedBoostDuration = 0.0f;
-        ghosts[i].hasKey = false;           
-        ghosts[i].hasExitPermit = false;
-        ghosts[i].inGhostHouse = true;     
-       
-        gameState.board[ghosts[i].row][ghosts[i].col] = '#';
-        ghosts[i].cellContent = ' ';
+int profiledMutexTimedLock(pthread_mutex_t* mutex, const struct timespec* timeout,
+                           const char* spanName, const char* file, int line) {
+    LockStats* stats = lockStatsFor(mutex, spanName);
+    if (stats == NULL) {
+        return tracedMutexTimedLock(mutex, timeout, spanName);
     }
-   
-    pthread_mutex_unlock(&gameState.mutex);
+    LockSiteStats* site = lockSiteFor(stats, file, line);
+
+    TraceSpan span = traceBegin(spanName);
+    if (pthread_mutex_trylock(mutex) == 0) {
+        traceEnd(span);
+        lockRecordAcquire(stats, site, 0, false, monotonicNs());
+        return 0;
+    }
+
+    uint64_t start = monotonicNs();
+    heartbeatWaitBegin(spanName);
+    int result = pthread_mutex_timedlock(mutex, timeout);
+    heartbeatWaitEnd();
+    uint64_t end = monotonicNs();
+    traceEnd(span);
+    if (result == 0) {
+        lockRecordAcquire(stats, site, end - start, true, end);
+    } else {
+        // The caller skips its turn on a timeout; make that visible
+        atomic_fetch_add_explicit(&stats->timeouts, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->waitNsTotal, end - start, memory_order_relaxed);
+        lockStatsMax(&stats->maxWaitNs, end - start);
+        if (site != NULL) {
+            atomic_fetch_add_explicit(&site->timeouts, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&site->waitNsTotal, end - start, memory_order_relaxed);
+        }
+    }
+    return result;
 }
 
-bool isValidGhostMove(int row, int col) {
-    if (row < 0 || row >= ROWS || col < 0 || col >= COLS) {
-        return false;
+int profiledMutexUnlock(pthread_mutex_t* mutex) {
+    LockStats* stats = lockStatsFor(mutex, "unknown");
+    if (stats != NULL) {
+        uint64_t holdNs = monotonicNs() - stats->lockedAtNs;
+        atomic_fetch_add_explicit(&stats->holdNsTotal, holdNs, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->holdHistogram[lockHistogramBucket(holdNs)], 1, memory_order_relaxed);
+        lockStatsMax(&stats->maxHoldNs, holdNs);
     }
-   
-    char cell = gameState.board[row][col];
-    return (cell != '=' && cell != '#');
+    return pthread_mutex_unlock(mutex);
 }
 
-DirectionWeights calculateDirectionWeights(Ghost* ghost, int targetRow, int targetCol) {
-    DirectionWeights weights = {1.0f, 1.0f, 1.0f, 1.0f};
-   
-    int currentRow = ghost->row;
-    int currentCol = ghost->col;
-   
-    int rowDiff = targetRow - currentRow;
-    int colDiff = targetCol - currentCol;
-   
-    switch (ghost->ghostType) {
-        case 1:
-            if (rowDiff < 0) weights.up *= 3.0f;
-            if (rowDiff > 0) weights.down *= 3.0f;
-            if (colDiff < 0) weights.left *= 3.0f;
-            if (colDiff > 0) weights.right *= 3.0f;
-            break;
-           
-        case 2:
-            pthread_mutex_lock(&gameState.mutex);
-            Direction pacmanDir = gameState.currentDirection;
-            pthread_mutex_unlock(&gameState.mutex);
-           
-            int aheadRow = targetRow;
-            int aheadCol = targetCol;
-           
-            switch (pacmanDir) {
-                case DIR_UP:    aheadRow -= 4; break;
-                case DIR_DOWN:  aheadRow += 4; break;
-                case DIR_LEFT:  aheadCol -= 4; break;
-                case DIR_RIGHT: aheadCol += 4; break;
-                default: break;
-            }
-           
-            rowDiff = aheadRow - currentRow;
-            colDiff = aheadCol - currentCol;
-           
-            if (rowDiff < 0) weights.up *= 2.5f;
-            if (rowDiff > 0) weights.down *= 2.5f;
-            if (colDiff < 0) weights.left *= 2.5f;
-            if (colDiff > 0) weights.right *= 2.5f;
-            break;
-           
-        case 3:
-            if (rowDiff < 0) weights.up *= 2.0f;
-            if (rowDiff > 0) weights.down *= 2.0f;
-            if (colDiff < 0) weights.left *= 2.0f;
-            if (colDiff > 0) weights.right *= 2.0f;
-           
-            weights.up *= (1.0f + ((float)rand() / RAND_MAX));
-            weights.down *= (1.0f + ((float)rand() / RAND_MAX));
-            weights.left *= (1.0f + ((float)rand() / RAND_MAX));
-            weights.right *= (1.0f + ((float)rand() / RAND_MAX));
-            break;
-           
-        case 4:
-            float distance = sqrt((rowDiff * rowDiff) + (colDiff * colDiff));
-           
-            if (distance > 8.0f) {
-                if (rowDiff < 0) weights.up *= 3.0f;
-                if (rowDiff > 0) weights.down *= 3.0f;
-                if (colDiff < 0) weights.left *= 3.0f;
-                if (colDiff > 0) weights.right *= 3.0f;
-            } else {
-                int cornerRow = ROWS - 1;
-                int cornerCol = 0;
-               
-                int cornerRowDiff = cornerRow - currentRow;
-                int cornerColDiff = cornerCol - currentCol;
-               
-                if (cornerRowDiff < 0) weights.up *= 2.0f;
-                if (cornerRowDiff > 0) weights.down *= 2.0f;
-                if (cornerColDiff < 0) weights.left *= 2.0f;
-                if (cornerColDiff > 0) weights.right *= 2.0f;
-            }
-            break;
+// Upper edge of the histogram bucket holding the given percentile, in us
+static uint64_t lockHistogramPercentileUs(_Atomic uint64_t* histogram, double percentile) {
+    uint64_t total = 0;
+    for (int i = 0; i < LOCK_HIST_BUCKETS; i++) {
+        total += atomic_load(&histogram[i]);
     }
-   
-    if (ghost->isVulnerable) {
-        float temp = weights.up;
-        weights.up = weights.down;
-        weights.down = temp;
-       
-        temp = weights.left;
-        weights.left = weights.right;
-        weights.right = temp;
+    if (total == 0) {
+        return 0;
     }
-   
-    switch (ghost->direction) {
-        case DIR_UP:    weights.down *= 0.2f; break;
-        case DIR_DOWN:  weights.up *= 0.2f; break;
-        case DIR_LEFT:  weights.right *= 0.2f; break;
-        case DIR_RIGHT: weights.left *= 0.2f; break;
-        default: break;
+    uint64_t target = (uint64_t)ceil(total * percentile);
+    uint64_t seen = 0;
+    for (int i = 0; i < LOCK_HIST_BUCKETS; i++) {
+        seen += atomic_load(&histogram[i]);
+        if (seen >= target) {
+            return 1ull << i;
+        }
     }
-   
-    return weights;
+    return 1ull << (LOCK_HIST_BUCKETS - 1);
 }
 
-Direction chooseGhostDirection(Ghost* ghost, DirectionWeights weights) {
-    bool validMoves[4] = {false};
-    int validCount = 0;
-   
-    if (isValidGhostMove(ghost->row - 1, ghost->col)) {
-        validMoves[DIR_UP - 1] = true;
-        validCount++;
-    }
-    if (isValidGhostMove(ghost->row + 1, ghost->col)) {
-        validMoves[DIR_DOWN - 1] = true;
-        validCount++;
+static int compareLockStatsByWait(const void* a, const void* b) {
+    const LockStats* la = *(const LockStats* const*)a;
+    const LockStats* lb = *(const LockStats* const*)b;
+    uint64_t wa = atomic_load(&la->waitNsTotal);
+    uint64_t wb = atomic_load(&lb->waitNsTotal);
+    return (wa < wb) - (wa > wb);
+}
+
+void printLockReport() {
+    int count = atomic_load(&lockStatsCount);
+    if (count == 0) {
+        return;
     }
-    if (isValidGhostMove(ghost->row, ghost->col - 1)) {
-        validMoves[DIR_LEFT - 1] = true;
-        validCount++;
+    LockStats* sorted[MAX_PROFILED_LOCKS];
+    for (int i = 0; i < count; i++) {
+        sorted[i] = &lockStatsTable[i];
     }
-    if (isValidGhostMove(ghost->row, ghost->col + 1)) {
-        validMoves[DIR_RIGHT - 1] = true;
-        validCount++;
+    qsort(sorted, count, sizeof(sorted[0]), compareLockStatsByWait);
+
+    printf("\n=== Lock contention report (sorted by total wait) ===\n");
+    printf("%-26s %10s %7s %8s %10s %9s %9s %10s %9s %9s\n",
+           "lock", "acquires", "contend", "timeouts", "wait ms", "wait p99", "wait max",
+           "hold ms", "hold p99", "hold max");
+    for (int i = 0; i < count; i++) {
+        LockStats* stats = sorted[i];
+        uint64_t acquires = atomic_load(&stats->acquires);
+        uint64_t contended = atomic_load(&stats->contended);
+        printf("%-26s %10llu %6.1f%% %8llu %10.2f %7lluus %7.2fms %10.2f %7lluus %7.2fms\n",
+               stats->name,
+               (unsigned long long)acquires,
+               acquires ? 100.0 * contended / acquires : 0.0,
+               (unsigned long long)atomic_load(&stats->timeouts),
+               atomic_load(&stats->waitNsTotal) / 1e6,
+               (unsigned long long)lockHistogramPercentileUs(stats->waitHistogram, 0.99),
+               atomic_load(&stats->maxWaitNs) / 1e6,
+               atomic_load(&stats->holdNsTotal) / 1e6,
+               (unsigned long long)lockHistogramPercentileUs(stats->holdHistogram, 0.99),
+               atomic_load(&stats->maxHoldNs) / 1e6);
+
+        for (int s = 0; s < MAX_LOCK_SITES; s++) {
+            LockSiteStats* site = &stats->sites[s];
+            int line = atomic_load(&site->line);
+            if (line <= 0) {
+                break;
+            }
+            printf("    %s:%-5d acquires=%llu timeouts=%llu wait=%.2fms\n",
+                   site->file, line,
+                   (unsigned long long)atomic_load(&site->acquires),
+                   (unsigned long long)atomic_load(&site->timeouts),
+                   atomic_load(&site->waitNsTotal) / 1e6);
+        }
     }
-   
-    if (!validMoves[DIR_UP - 1]) weights.up = 0.0f;
-    if (!validMoves[DIR_DOWN - 1]) weights.down = 0.0f;
-    if (!validMoves[DIR_LEFT - 1]) weights.left = 0.0f;
-    if (!validMoves[DIR_RIGHT - 1]) weights.right = 0.0f;
-   
-    float totalWeight = weights.up + weights.down + weights.left + weights.right;
-   
-    if (totalWeight <= 0.0f || validCount == 0) {
-        if (validCount > 0) {
-            int randomIndex = rand() % validCount;
-            int count = 0;
-            for (int i = 0; i < 4; i++) {
-                if (validMoves[i]) {
-                    if (count == randomIndex) {
-                        return (Direction)(i + 1);
-                    }
-                    count++;
-                }
+
+    printf("\nWait-time histograms (us, upper bucket edge: count)\n");
+    for (int i = 0; i < count; i++) {
+        LockStats* stats = sorted[i];
+        printf("  %-24s", stats->name);
+        for (int b = 0; b < LOCK_HIST_BUCKETS; b++) {
+            uint64_t n = atomic_load(&stats->waitHistogram[b]);
+            if (n > 0) {
+                printf(" <%llu:%llu", 1ull << b, (unsigned long long)n);
             }
         }
-        return DIR_NONE;
+        printf("\n");
     }
-   
-    float random = ((float)rand() / RAND_MAX) * totalWeight;
-   
-    if (random < weights.up) return DIR_UP;
-    random -= weights.up;
-   
-    if (random < weights.down) return DIR_DOWN;
-    random -= weights.down;
-   
-    if (random < weights.left) return DIR_LEFT;
-   
-    return DIR_RIGHT;
 }
 
-void moveGhost(Ghost* ghost, Direction direction) {
-    pthread_mutex_lock(&gameState.mutex);
-    
-    int oldRow = ghost->row;
-    int oldCol = ghost->col;
-    int newRow = oldRow;
-    int newCol = oldCol;
-    
-    switch (direction) {
-        case DIR_UP:    newRow--; break;
-        case DIR_DOWN:  newRow++; break;
-        case DIR_LEFT:  newCol--; break;
-        case DIR_RIGHT: newCol++; break;
-        default: break;
-    }
-    
-    // if ghost is trying to leave ghost house
-    bool canLeaveGhostHouse = true;
-    if (ghost->inGhostHouse && !isInGhostHouse(newRow, newCol)) {
-        canLeaveGhostHouse = (ghost->hasKey && ghost->hasExitPermit);
+#else
+
+void printLockReport() {}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Logging: LOG_* formats into the calling thread's own ring (single producer,
+// single consumer, no locks) and a background thread writes the rings to
+// stdout in timestamp order. A full ring drops the message rather than stall
+// a thread that may be holding gameState.mutex.
+// ---------------------------------------------------------------------------
+static const char* logLevelNames[] = { "DEBUG", "INFO", "WARN", "ERROR", "OFF" };
+
+static LogRing* logCurrentRing() {
+    if (logThreadRing != NULL) {
+        return logThreadRing;
     }
-    
-    if (!isValidGhostMove(newRow, newCol) || !canLeaveGhostHouse) {
-        pthread_mutex_unlock(&gameState.mutex);
-        return;
+    int slot = atomic_fetch_add(&logRingCount, 1);
+    if (slot >= MAX_LOG_THREADS) {
+        atomic_fetch_sub(&logRingCount, 1);
+        return NULL;
     }
-    
-    // Handle collision with Pacman
-    if (newRow == gameState.pacmanRow && newCol == gameState.pacmanCol) {
-        if (ghost->isVulnerable) {
-            // Ghost gets eaten - DEBUG output
-           // printf("Ghost %d eaten! Setting needsRespawn=true\n", ghost->id);
-            
-            // Mark ghost as eaten
-            ghost->needsRespawn = true;
-            
-            // Restore cell content where ghost was
-            gameState.board[oldRow][oldCol] = ghost->cellContent;
-            
-            // Release any held resources immediately
-            pthread_mutex_unlock(&gameState.mutex); // Release mutex before calling resource release
-            releaseGhostHouseResources(ghost);
-          
-            return;
-        }
-        pthread_mutex_unlock(&gameState.mutex);
-        return;
+    LogRing* ring = calloc(1, sizeof(LogRing));
+    if (ring == NULL) {
+        return NULL;
     }
-    
-    // Regular movement
-    // Restore what was under the ghost if it's not another entity
-    if (gameState.board[oldRow][oldCol] == '#') {
-        gameState.board[oldRow][oldCol] = ghost->cellContent;
+    snprintf(ring->threadName, sizeof(ring->threadName), "thread %d", slot + 1);
+    atomic_store_explicit(&logRings[slot], ring, memory_order_release);
+    logThreadRing = ring;
+    return ring;
+}
+
+void logSetThreadName(const char* name) {
+    LogRing* ring = logCurrentRing();
+    if (ring != NULL) {
+        snprintf(ring->threadName, sizeof(ring->threadName), "%s", name);
     }
-    
-    ghost->row = newRow;
-    ghost->col = newCol;
-    
-    // Save what's at the new position if it's not another entity
-    char newCellContent = gameState.board[newRow][newCol];
-    if (newCellContent != '@' && newCellContent != '#') {
-        ghost->cellContent = newCellContent;
+}
+
+void setThreadName(const char* name) {
+    traceSetThreadName(name);
+    logSetThreadName(name);
+}
+
+void logWrite(LogLevel level, const char* format, ...) {
+    LogRing* ring = logCurrentRing();
+    if (ring == NULL) {
+        return;
     }
-    
-    // Place ghost at new position
-    gameState.board[newRow][newCol] = '#';
-    
-    ghost->direction = direction;
-    
-    if (ghost->inGhostHouse && !isInGhostHouse(newRow, newCol)) {
-        ghost->inGhostHouse = false;
-        pthread_mutex_unlock(&gameState.mutex); // Release mutex before calling resource release
-        releaseGhostHouseResources(ghost);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_SIZE) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
         return;
     }
-    
-    pthread_mutex_unlock(&gameState.mutex);
+    LogRecord* record = &ring->records[head & (LOG_RING_SIZE - 1)];
+    record->timestampNs = monotonicNs();
+    record->level = level;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record->text, sizeof(record->text), format, args);
+    va_end(args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
 }
 
-void cleanupGhostHouseResources() {
-    sem_destroy(&keySemaphore);
-    sem_destroy(&exitPermitSemaphore);
-    pthread_mutex_destroy(&ghostHouseMutex);
-}
+// Writes out everything currently queued, oldest first across all threads
+static void logDrain() {
+    int ringCount = atomic_load(&logRingCount);
+    if (ringCount > MAX_LOG_THREADS) ringCount = MAX_LOG_THREADS;
+    LogRing* rings[MAX_LOG_THREADS];
+    uint64_t heads[MAX_LOG_THREADS];
+    for (int r = 0; r < ringCount; r++) {
+        rings[r] = atomic_load_explicit(&logRings[r], memory_order_acquire);
+        heads[r] = rings[r] ? atomic_load_explicit(&rings[r]->head, memory_order_acquire) : 0;
+    }
 
-void* ghostThreadFunc(void* arg) {
-    Ghost* ghost = (Ghost*)arg;
-   
-    int baseInterval = 200 + (ghost->id * 50);
-    int currentInterval = baseInterval;
-   
-    sem_t moveSemaphore;
-    sem_init(&moveSemaphore, 0, 0);
-   
-    pthread_t timerThread;
-    TimerThreadArgs timerArgs;
-    timerArgs.semaphore = &moveSemaphore;
-    timerArgs.intervalMs = currentInterval;
-    timerArgs.isRunning = true;
-   
-    // Create the timer thread with detached attribute
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    pthread_create(&timerThread, &attr, ghostTimerThread, &timerArgs);
-    pthread_attr_destroy(&attr);
-    
-    // Reset any speed boost at initialization
-    if (ghost->hasSpeedBoost) {
-        sem_post(&speedBoostSemaphore);
-        ghost->hasSpeedBoost = false;
-        ghost->speedBoostDuration = 0.0f;
-    }
-    
-    // Main ghost behavior loop
-    while (ghostThreadsRunning) {
-        // Check status before waiting to avoid being stuck in sem_wait
-        if (!ghostThreadsRunning) {
-            break;
-        }
-        
-        // Wait for timer signal with timeout to avoid deadlock
-        struct timespec waitTimeout;
-        clock_gettime(CLOCK_REALTIME, &waitTimeout);
-        waitTimeout.tv_sec += 2; // 2-second maximum wait as a safety
-        
-        if (sem_timedwait(&moveSemaphore, &waitTimeout) != 0) {
-            // Timed out waiting for movement signal - safety check
-            if (!ghostThreadsRunning) break;
-            continue; 
-        }
-       
-        // Handle ghost respawn 
-        if (ghost->needsRespawn) {
-            printf("Ghost %d respawning...\n", ghost->id);
-            
-            // Try to get game state mutex with timeout
-            struct timespec lockTimeout;
-            clock_gettime(CLOCK_REALTIME, &lockTimeout);
-            lockTimeout.tv_sec += 1; // 1-second timeout
-            
-            if (pthread_mutex_timedlock(&gameState.mutex, &lockTimeout) != 0) {
-                continue; // Couldn't get mutex, try again next tick
-            }
-            
-            // Set position to respawn coordinates
-            ghost->row = ghost->respawnRow;
-            ghost->col = ghost->respawnCol;
-            ghost->isVulnerable = false;
-            ghost->needsRespawn = false; // Clear respawn flag
-            ghost->inGhostHouse = true;  // Back in ghost house
-            
-            // Store what's at the respawn position and place ghost
-            ghost->cellContent = gameState.board[ghost->row][ghost->col];
-            gameState.board[ghost->row][ghost->col] = '#';
-            
-            printf("Ghost %d respawned at [%d,%d]\n", ghost->id, ghost->row, ghost->col);
-            pthread_mutex_unlock(&gameState.mutex);
-            
-            // Ghosts start without resources when respawning
-            ghost->hasKey = false;
-            ghost->hasExitPermit = false;
-            
-            // Handle speed boost
-            if (ghost->hasSpeedBoost) {
-                sem_post(&speedBoostSemaphore);
-                ghost->hasSpeedBoost = false;
-                ghost->speedBoostDuration = 0.0f;
-                currentInterval = baseInterval;
-                timerArgs.intervalMs = currentInterval;
+    bool wroteAny = false;
+    while (true) {
+        int oldest = -1;
+        uint64_t oldestTime = UINT64_MAX;
+        for (int r = 0; r < ringCount; r++) {
+            if (rings[r] == NULL) continue;
+            uint64_t tail = atomic_load_explicit(&rings[r]->tail, memory_order_relaxed);
+            if (tail == heads[r]) continue;
+            uint64_t time = rings[r]->records[tail & (LOG_RING_SIZE - 1)].timestampNs;
+            if (time < oldestTime) {
+                oldestTime = time;
+                oldest = r;
             }
-            
-            // Add a small delay after respawn to prevent immediate movement
-            struct timespec respawnDelay = { 0, 500000000 }; // 500ms
-            nanosleep(&respawnDelay, NULL);
-            
-            // Skip to next iteration
-            continue;
-        }
-       
-        // Check game state
-        bool gameRunning = false, gamePaused = false, isPlayScreen = false;
-        int pacmanRow = -1, pacmanCol = -1;
-        
-        // Use a timed lock to prevent deadlock on game state mutex
-        struct timespec lockTimeout;
-        clock_gettime(CLOCK_REALTIME, &lockTimeout);
-        lockTimeout.tv_sec += 1; // 1-second timeout
-        
-        // Try to get game state info - skip turn if can't get mutex
-        if (pthread_mutex_timedlock(&gameState.mutex, &lockTimeout) != 0) {
-            continue;
         }
-        gameRunning = gameState.gameRunning;
-        gamePaused = gameState.gamePaused;
-        pthread_mutex_unlock(&gameState.mutex);
-       
-        if (!gameRunning) {
+        if (oldest < 0) {
             break;
         }
-       
-        // Check UI state with timeout
-        if (pthread_mutex_timedlock(&uiState.mutex, &lockTimeout) != 0) {
-            continue;
-        }
-        isPlayScreen = (uiState.currentScreen == SCREEN_PLAY);
-        pthread_mutex_unlock(&uiState.mutex);
-       
-        // Only process ghost logic if in the play screen and not paused
-        if (!isPlayScreen || gamePaused) {
-            continue;
-        }
-            
-        // Handle speed boost duration
-        if (ghost->hasSpeedBoost) {
-            float deltaTime = 0.2f;
-            ghost->speedBoostDuration -= deltaTime;
-            if (ghost->speedBoostDuration <= 0.0f) {
-                ghost->hasSpeedBoost = false;
-                sem_post(&speedBoostSemaphore);
-                currentInterval = baseInterval;
-                timerArgs.intervalMs = currentInterval;
-            }
-        }
-        
-        // Try to get speed boost only if eligible
-        if ((ghost->ghostType == 1 || ghost->ghostType == 2) && 
-            !ghost->hasSpeedBoost && !ghost->inGhostHouse) {
-            
-            // Use a separate function to try acquiring speed boost
-            bool boostAcquired = false;
-            struct timespec boostTimeout;
-            clock_gettime(CLOCK_REALTIME, &boostTimeout);
-            boostTimeout.tv_sec += 1;
-            
-            // Only try if boost might be available
-            pthread_mutex_lock(&speedBoostAvailMutex);
-            bool canTryBoost = speedBoostAvailable && ((float)rand() / RAND_MAX < 0.3f);
-            pthread_mutex_unlock(&speedBoostAvailMutex);
-            
-            if (canTryBoost) {
-                if (sem_timedwait(&speedBoostSemaphore, &boostTimeout) == 0) {
-                    ghost->hasSpeedBoost = true;
-                    ghost->speedBoostDuration = 5.0f;
-                    currentInterval = baseInterval / 2;
-                    timerArgs.intervalMs = currentInterval;
-                    boostAcquired = true;
-                }
-            }
-            
-            // Only update global boost availability if we didn't just get a boost
-            // Reduces contention by limiting how often this is toggled
-            if (!boostAcquired && ((float)rand() / RAND_MAX < 0.05f)) {
-                pthread_mutex_lock(&speedBoostAvailMutex);
-                speedBoostAvailable = !speedBoostAvailable;
-                pthread_mutex_unlock(&speedBoostAvailMutex);
-            }
-        }
-        
-        // Try to acquire ghost house resources if needed
-        if (ghost->inGhostHouse && !ghost->hasKey && !ghost->hasExitPermit) {
-            struct timespec resourceTimeout;
-            clock_gettime(CLOCK_REALTIME, &resourceTimeout);
-            
-            // Add jitter to prevent all ghosts trying at exactly the same time
-            resourceTimeout.tv_nsec += (ghost->id * 50000000) % 1000000000;
-            if (resourceTimeout.tv_nsec >= 1000000000) {
-                resourceTimeout.tv_sec++;
-                resourceTimeout.tv_nsec -= 1000000000;
-            }
-            resourceTimeout.tv_sec += 1; // 1-second timeout
-            
-            if (!tryAcquireGhostHouseResources(ghost, &resourceTimeout)) {
-                continue; // Try again next tick
-            }
-            // Successfully acquired resources
-            printf("Ghost %d acquired house resources\n", ghost->id);
-        }
-           
-        // Update vulnerability state and get pacman position
-        if (pthread_mutex_timedlock(&gameState.mutex, &lockTimeout) != 0) {
-            continue;
-        }
-        ghost->isVulnerable = gameState.ghostVulnerable;
-        pacmanRow = gameState.pacmanRow;
-        pacmanCol = gameState.pacmanCol;
-        pthread_mutex_unlock(&gameState.mutex);
-           
-        // Skip if pacman position is invalid
-        if (pacmanRow == -1 || pacmanCol == -1) {
-            continue;
-        }
-        
-        // Calculate movement direction with defensive error checking
-        DirectionWeights weights = calculateDirectionWeights(ghost, pacmanRow, pacmanCol);
-        Direction newDirection = chooseGhostDirection(ghost, weights);
-           
-        // Move the ghost if we have a valid direction
-        if (newDirection != DIR_NONE) {
-            moveGhost(ghost, newDirection);
+        LogRing* ring = rings[oldest];
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        LogRecord* record = &ring->records[tail & (LOG_RING_SIZE - 1)];
+        printf("[%10.3f] %-5s %s: %s\n", (record->timestampNs - logStartNs) / 1e9,
+               logLevelNames[record->level], ring->threadName, record->text);
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+        wroteAny = true;
+    }
+
+    for (int r = 0; r < ringCount; r++) {
+        if (rings[r] == NULL) continue;
+        uint64_t dropped = atomic_exchange_explicit(&rings[r]->dropped, 0, memory_order_relaxed);
+        if (dropped > 0) {
+            printf("[logger] %s: dropped %llu messages (ring full)\n", rings[r]->threadName,
+                   (unsigned long long)dropped);
+            wroteAny = true;
         }
     }
-   
-    // Clean up before exiting
-    releaseGhostHouseResources(ghost);
-    
-    if (ghost->hasSpeedBoost) {
-        sem_post(&speedBoostSemaphore);
-        ghost->hasSpeedBoost = false;
+    if (wroteAny) {
+        fflush(stdout);
     }
-   
-    // Signal timer thread to exit
-    timerArgs.isRunning = false;
+}
 
-   
-    sem_destroy(&moveSemaphore);
-   
-    // Signal that this ghost thread has exited
-    pthread_mutex_lock(&ghostExitMutex);
-    ghostThreadsExited++;
-   
-    if (ghostThreadsExited >= MAX_GHOSTS) {
-        pthread_cond_signal(&ghostExitCond);
+static void* logDrainThread(void* arg) {
+    (void)arg;
+    struct timespec interval = { 0, LOG_DRAIN_INTERVAL_MS * 1000000L };
+    while (atomic_load(&logRunning)) {
+        nanosleep(&interval, NULL);
+        logDrain();
     }
-    pthread_mutex_unlock(&ghostExitMutex);
-   
+    logDrain();
     return NULL;
 }
 
-void* ghostTimerThread(void* arg) {
-    TimerThreadArgs* args = (TimerThreadArgs*)arg;
-   
-    pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t timerCond = PTHREAD_COND_INITIALIZER;
-   
-    struct timespec ts;
-   
-    while (args->isRunning) {
-        // FIXED: More efficient time calculation
-        clock_gettime(CLOCK_REALTIME, &ts);
-        
-        // Calculate milliseconds into appropriate seconds and nanoseconds
-        long additionalSeconds = args->intervalMs / 1000;
-        long additionalNanoseconds = (args->intervalMs % 1000) * 1000000;
-        
-        ts.tv_sec += additionalSeconds;
-        ts.tv_nsec += additionalNanoseconds;
-        
-        // Handle nanosecond overflow properly
-        if (ts.tv_nsec >= 1000000000) {
-            ts.tv_sec += ts.tv_nsec / 1000000000;
-            ts.tv_nsec %= 1000000000;
-        }
-       
-        pthread_mutex_lock(&timerMutex);
-        int wait_result = pthread_cond_timedwait(&timerCond, &timerMutex, &ts);
-        pthread_mutex_unlock(&timerMutex);
-       
-        if (args->isRunning) {
-            sem_post(args->semaphore);
+void logInit() {
+    const char* levelEnv = getenv("PACMAN_LOG_LEVEL");
+    if (levelEnv != NULL) {
+        for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++) {
+            if (strcasecmp(levelEnv, logLevelNames[i]) == 0) {
+                atomic_store(&logLevel, i);
+            }
         }
     }
-   
-    pthread_mutex_destroy(&timerMutex);
-    pthread_cond_destroy(&timerCond);
-   
-    return NULL;
+    logStartNs = monotonicNs();
+    atomic_store(&logRunning, true);
+    if (pthread_create(&logThread, NULL, logDrainThread, NULL) != 0) {
+        atomic_store(&logRunning, false);
+        printf("Error creating logger thread\n");
+    }
 }
 
-void startGhostThreads() {
-    // FIXED: Properly initialize variables
-    ghostThreadsRunning = true; // Very important!
-    
-    pthread_mutex_lock(&ghostExitMutex);
-    ghostThreadsExited = 0;
-    pthread_mutex_unlock(&ghostExitMutex);
-    
-    // FIXED: Initialize ghost house resources if not already done
-    static bool resourcesInitialized = false;
-    if (!resourcesInitialized) {
-        initGhostHouseResources();
-        resourcesInitialized = true;
-    }
-    
-    // Verify ghost house state is valid before starting threads
-    verifyGhostHouseState();
-    
-    // Make sure all ghosts are properly reset
-    for (int i = 0; i < MAX_GHOSTS; i++) {
-        resetGhost(&ghosts[i]);
-    }
-   
-    for (int i = 0; i < MAX_GHOSTS; i++) {
-        if (pthread_create(&ghosts[i].thread, NULL, ghostThreadFunc, &ghosts[i]) != 0) {
-            printf("Error creating ghost thread %d\n", i);
-        } else {
-            printf("Ghost thread %d started\n", i);
-        }
+void logShutdown() {
+    if (atomic_exchange(&logRunning, false)) {
+        pthread_join(logThread, NULL);
     }
 }
 
+// ---------------------------------------------------------------------------
+// Watchdog: every long-running thread beats a heartbeat once per tick. A
+// thread WATCHDOG_MISSED_TICKS ticks late is reported once, with the lock it
+// is blocked on and for how long, and counted in watchdogStalls. SIGUSR1 logs
+// the whole heartbeat table of a running game.
+// ---------------------------------------------------------------------------
+// Hands a slot back. Also the thread-exit destructor of heartbeatKey, so a
+// thread that returns without heartbeatUnregister() still frees its slot.
+static void heartbeatRelease(void* slot) {
+    Heartbeat* hb = (Heartbeat*)slot;
+    pthread_mutex_lock(&heartbeatSlotsMutex);
+    atomic_store_explicit(&hb->active, false, memory_order_release);
+    hb->inUse = false;
+    pthread_mutex_unlock(&heartbeatSlotsMutex);
+}
+
+static void heartbeatKeyCreate() {
+    pthread_key_create(&heartbeatKey, heartbeatRelease);
+}
 
-void stopGhostThreads() {
-    ghostThreadsRunning = false;
-   
-    pthread_mutex_lock(&ghostExitMutex);
-    while (ghostThreadsExited < MAX_GHOSTS) {
-        pthread_cond_wait(&ghostExitCond, &ghostExitMutex);
+void heartbeatRegister(const char* name, int expectedMs) {
+    pthread_once(&heartbeatKeyOnce, heartbeatKeyCreate);
+    pthread_mutex_lock(&heartbeatSlotsMutex);
+    int count = atomic_load(&heartbeatCount);
+    int slot = 0;
+    while (slot < count && heartbeats[slot].inUse) {
+        slot++;
     }
-    pthread_mutex_unlock(&ghostExitMutex);
+    if (slot >= MAX_HEARTBEATS) {
+        pthread_mutex_unlock(&heartbeatSlotsMutex);
+        return; // unmonitored, but otherwise unaffected
+    }
+    if (slot == count) {
+        atomic_store(&heartbeatCount, count + 1);
+    }
+    Heartbeat* hb = &heartbeats[slot];
+    snprintf(hb->name, sizeof(hb->name), "%s", name);
+    hb->inUse = true;
+    atomic_store(&hb->expectedMs, expectedMs);
+    atomic_store(&hb->beats, 0);
+    atomic_store(&hb->lastBeatNs, monotonicNs());
+    atomic_store(&hb->waitingOn, NULL);
+    atomic_store(&hb->stalls, 0);
+    hb->stalled = false;
+    hb->longestStallNs = 0;
+    atomic_store_explicit(&hb->active, true, memory_order_release);
+    pthread_mutex_unlock(&heartbeatSlotsMutex);
+    threadHeartbeat = hb;
+    pthread_setspecific(heartbeatKey, hb);
 }
 
-void renderGameOver(sfRenderWindow* window, sfFont* font) {
-    static bool scoreAdded = false;
-    if (!scoreAdded) {
-        pthread_mutex_lock(&uiState.mutex);
-        addScore(uiState.username, gameState.score);
-        pthread_mutex_unlock(&uiState.mutex);
-        scoreAdded = true;
+void heartbeatUnregister() {
+    if (threadHeartbeat != NULL) {
+        pthread_setspecific(heartbeatKey, NULL);
+        heartbeatRelease(threadHeartbeat);
+        threadHeartbeat = NULL;
     }
+}
 
-    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
-   
-    sfText* titleText = sfText_create();
-    sfText_setFont(titleText, font);
-    sfText_setString(titleText, "GAME OVER");
-    sfText_setCharacterSize(titleText, 72);
-    sfText_setFillColor(titleText, sfRed);
-   
-    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
-    sfText_setPosition(titleText, (sfVector2f){
-        (WINDOW_WIDTH - titleBounds.width) / 2,
-        WINDOW_HEIGHT * 0.3f
-    });
-   
-    sfRenderWindow_drawText(window, titleText, NULL);
-   
-    char scoreStr[50];
-    pthread_mutex_lock(&gameState.mutex);
-    sprintf(scoreStr, "Final Score: %d", gameState.score);
-    pthread_mutex_unlock(&gameState.mutex);
-   
-    sfText* scoreText = sfText_create();
-    sfText_setFont(scoreText, font);
-    sfText_setString(scoreText, scoreStr);
-    sfText_setCharacterSize(scoreText, 36);
-    sfText_setFillColor(scoreText, sfWhite);
-   
-    sfFloatRect scoreBounds = sfText_getLocalBounds(scoreText);
-    sfText_setPosition(scoreText, (sfVector2f){
-        (WINDOW_WIDTH - scoreBounds.width) / 2,
-        WINDOW_HEIGHT * 0.5f
-    });
-   
-    sfRenderWindow_drawText(window, scoreText, NULL);
-   
-    sfText* instructionsText = sfText_create();
-    sfText_setFont(instructionsText, font);
-    sfText_setString(instructionsText, "Press ESC to return to menu");
-    sfText_setCharacterSize(instructionsText, 24);
-    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
-   
-    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
-    sfText_setPosition(instructionsText, (sfVector2f){
-        (WINDOW_WIDTH - instrBounds.width) / 2,
-        WINDOW_HEIGHT * 0.7f
-    });
-   
-    sfRenderWindow_drawText(window, instructionsText, NULL);
-   
-    sfText_destroy(titleText);
-    sfText_destroy(scoreText);
-    sfText_destroy(instructionsText);
-    sfRenderWindow_display(window);
+void heartbeat() {
+    Heartbeat* hb = threadHeartbeat;
+    if (hb != NULL) {
+        atomic_fetch_add_explicit(&hb->beats, 1, memory_order_relaxed);
+        atomic_store_explicit(&hb->lastBeatNs, monotonicNs(), memory_order_release);
+    }
 }
 
-void addInputEvent(int eventType, int data) {
-    pthread_mutex_lock(&eventQueueMutex);
-    if ((eventQueueTail + 1) % MAX_INPUT_EVENTS != eventQueueHead) {
-        inputEventQueue[eventQueueTail].eventType = eventType;
-        inputEventQueue[eventQueueTail].data = data;
-        inputEventQueue[eventQueueTail].processed = false;
-        eventQueueTail = (eventQueueTail + 1) % MAX_INPUT_EVENTS;
+// Called by the lock wrappers around a blocking acquire
+void heartbeatWaitBegin(const char* lockName) {
+    Heartbeat* hb = threadHeartbeat;
+    if (hb != NULL) {
+        atomic_store_explicit(&hb->waitStartNs, monotonicNs(), memory_order_relaxed);
+        atomic_store_explicit(&hb->waitingOn, lockName, memory_order_release);
     }
-    pthread_mutex_unlock(&eventQueueMutex);
 }
 
-bool getNextInputEvent(InputEvent* event) {
-    bool hasEvent = false;
-    pthread_mutex_lock(&eventQueueMutex);
-    if (eventQueueHead != eventQueueTail) {
-        *event = inputEventQueue[eventQueueHead];
-        inputEventQueue[eventQueueHead].processed = true;
-        eventQueueHead = (eventQueueHead + 1) % MAX_INPUT_EVENTS;
-        hasEvent = true;
+void heartbeatWaitEnd() {
+    Heartbeat* hb = threadHeartbeat;
+    if (hb != NULL) {
+        atomic_store_explicit(&hb->waitingOn, NULL, memory_order_release);
     }
-    pthread_mutex_unlock(&eventQueueMutex);
-    return hasEvent;
 }
 
-void initUIState() {
-    uiState.currentScreen = SCREEN_MENU;
-    uiState.selectedMenuItem = 0;
-    uiState.needsRedraw = true;
-    strcpy(uiState.username, "Unknown");
-    uiState.enteringUsername = false;
-    uiState.usernameCursorPos = 0;
-    pthread_mutex_init(&uiState.mutex, NULL);
+static const char* heartbeatLockName(const char* spanName) {
+    return strncmp(spanName, "lock ", 5) == 0 ? spanName + 5 : spanName;
 }
 
-void initGameState() {      
-    gameState.powerPelletActive = false;
-    gameState.powerPelletDuration = 0.0f;
-    gameState.ghostVulnerable = false;
-    gameState.ghostVulnerableDuration = 0.0f;
-   
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            gameState.board[i][j] = initialBoard[i][j];
-        }
+static void watchdogDescribe(Heartbeat* hb, uint64_t now, char* out, size_t outSize) {
+    const char* waitingOn = atomic_load_explicit(&hb->waitingOn, memory_order_acquire);
+    if (waitingOn != NULL) {
+        uint64_t waitStart = atomic_load_explicit(&hb->waitStartNs, memory_order_relaxed);
+        snprintf(out, outSize, "blocked on %s for %.0f ms", heartbeatLockName(waitingOn),
+                 now > waitStart ? (now - waitStart) / 1e6 : 0.0);
+    } else {
+        snprintf(out, outSize, "not blocked on a lock");
+    }
+}
+
+// Holds heartbeatSlotsMutex so no slot changes hands mid-check
+static void watchdogCheck(uint64_t now, bool dumpAll) {
+    pthread_mutex_lock(&heartbeatSlotsMutex);
+    int count = atomic_load(&heartbeatCount);
+    if (count > MAX_HEARTBEATS) count = MAX_HEARTBEATS;
+    if (dumpAll) {
+        LOG_INFO("%d threads, %llu stalls so far", count,
+                 (unsigned long long)atomic_load(&watchdogStalls));
     }
    
-    gameState.score = 0;
-    gameState.lives = 3;
-    gameState.pacmanRotation = 0.0f;
-    gameState.currentDirection = DIR_NONE;
-    gameState.gameRunning = true;
-    gameState.gamePaused = false;
-   
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            if (gameState.board[i][j] == '@') {
-                gameState.pacmanStartRow = i;
-                gameState.pacmanStartCol = j;
-                gameState.pacmanRow = i;
-                gameState.pacmanCol = j;
-                break;
+    for (int i = 0; i < count; i++) {
+        Heartbeat* hb = &heartbeats[i];
+        if (!atomic_load_explicit(&hb->active, memory_order_acquire)) {
+            hb->stalled = false;
+            continue;
+        }
+        uint64_t lastBeat = atomic_load_explicit(&hb->lastBeatNs, memory_order_acquire);
+        uint64_t sinceBeat = now > lastBeat ? now - lastBeat : 0;
+        int expectedMs = atomic_load(&hb->expectedMs);
+        char state[96];
+        watchdogDescribe(hb, now, state, sizeof(state));
+       
+        if (dumpAll) {
+            LOG_INFO("  %-14s beats=%llu last beat %.0f ms ago (every %d ms), %s, stalls=%llu",
+                     hb->name, (unsigned long long)atomic_load(&hb->beats), sinceBeat / 1e6,
+                     expectedMs, state, (unsigned long long)atomic_load(&hb->stalls));
+        }
+       
+        if (!hb->stalled && sinceBeat > (uint64_t)expectedMs * WATCHDOG_MISSED_TICKS * 1000000ull) {
+            hb->stalled = true;
+            hb->stalledSinceNs = lastBeat;
+            atomic_fetch_add(&hb->stalls, 1);
+            unsigned long long total = atomic_fetch_add(&watchdogStalls, 1) + 1;
+            LOG_WARN("%s stalled, no heartbeat for %.0f ms (%llu ticks of %d ms), %s; stalls so far: %llu",
+                     hb->name, sinceBeat / 1e6, (unsigned long long)(sinceBeat / 1000000ull / expectedMs),
+                     expectedMs, state, total);
+        } else if (hb->stalled && lastBeat > hb->stalledSinceNs) {
+            uint64_t stallNs = lastBeat - hb->stalledSinceNs;
+            if (stallNs > hb->longestStallNs) {
+                hb->longestStallNs = stallNs;
             }
+            hb->stalled = false;
+            LOG_INFO("%s recovered after %.0f ms", hb->name, stallNs / 1e6);
         }
     }
-    saveOriginalBoard();
-    initGhosts();
-    pthread_mutex_init(&gameState.mutex, NULL);
+    pthread_mutex_unlock(&heartbeatSlotsMutex);
 }
 
-bool isInGhostHouse(int row, int col) {
-    // Define the ghost house area
-     return (row >= 6 && row <= 8 && col >= 7 && col <= 12); // Adjust these values based on your game layout
+static void watchdogSignalHandler(int signo) {
+    (void)signo;
+    watchdogDumpRequested = 1;
 }
 
-// Add to your gameState struct definition (typically in a header file):
-// bool powerPelletLocations[ROWS][COLS]; // Tracks positions of power pellets
-
-// Add this to your game initialization function:
-void initializePowerPelletLocations() {
-    pthread_mutex_lock(&gameState.mutex);
-    // Initialize all to false
-    memset(gameState.powerPelletLocations, 0, sizeof(gameState.powerPelletLocations));
-    
-    // Mark power pellet locations from the board
-    for (int row = 0; row < ROWS; row++) {
-        for (int col = 0; col < COLS; col++) {
-            if (gameState.board[row][col] == '0') {
-                gameState.powerPelletLocations[row][col] = true;
-            }
+static void* watchdogThreadFunc(void* arg) {
+    (void)arg;
+    setThreadName("watchdog");
+    pthread_mutex_lock(&watchdogMutex);
+    while (atomic_load(&watchdogRunning)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += WATCHDOG_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&watchdogCond, &watchdogMutex, &deadline);
+        if (!atomic_load(&watchdogRunning)) {
+            break;
         }
+        bool dumpAll = watchdogDumpRequested != 0;
+        watchdogDumpRequested = 0;
+        watchdogCheck(monotonicNs(), dumpAll);
     }
-    pthread_mutex_unlock(&gameState.mutex);
+    pthread_mutex_unlock(&watchdogMutex);
+    return NULL;
 }
 
-void movePacman() {
-    pthread_mutex_lock(&gameState.mutex);
-    int oldRow = gameState.pacmanRow;
-    int oldCol = gameState.pacmanCol;
-    int newRow = oldRow;
-    int newCol = oldCol;
-    switch (gameState.currentDirection) {
-        case DIR_UP:    newRow--; break;
-        case DIR_DOWN:  newRow++; break;
-        case DIR_LEFT:  newCol--; break;
-        case DIR_RIGHT: newCol++; break;
-        case DIR_NONE:
-            pthread_mutex_unlock(&gameState.mutex);
-            return;
+void watchdogStart() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&watchdogCond, &attr);
+    pthread_condattr_destroy(&attr);
+   
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = watchdogSignalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+   
+    atomic_store(&watchdogRunning, true);
+    if (pthread_create(&watchdogThread, NULL, watchdogThreadFunc, NULL) != 0) {
+        atomic_store(&watchdogRunning, false);
+        printf("Error creating watchdog thread\n");
     }
-    if (newRow < 0 || newRow >= ROWS || newCol < 0 || newCol >= COLS ||
-        gameState.board[newRow][newCol] == '=' || isInGhostHouse(newRow, newCol)) {
-        pthread_mutex_unlock(&gameState.mutex);
+}
+
+void watchdogStop() {
+    if (!atomic_exchange(&watchdogRunning, false)) {
         return;
     }
-    char cellContent = gameState.board[newRow][newCol];
-    bool preservePowerPellet = false;
-    if (cellContent == '.') {
-        gameState.score += 10;
+    pthread_mutex_lock(&watchdogMutex);
+    pthread_cond_broadcast(&watchdogCond);
+    pthread_mutex_unlock(&watchdogMutex);
+    pthread_join(watchdogThread, NULL);
+    pthread_cond_destroy(&watchdogCond);
+}
+
+uint64_t watchdogStallCount() {
+    return atomic_load(&watchdogStalls);
+}
+
+void printWatchdogReport() {
+    pthread_mutex_lock(&heartbeatSlotsMutex);
+    int count = atomic_load(&heartbeatCount);
+    if (count > MAX_HEARTBEATS) count = MAX_HEARTBEATS;
+    printf("\n=== Watchdog ===\n");
+    printf("%-14s %10s %8s %8s %14s\n", "thread", "beats", "tick ms", "stalls", "longest stall");
+    for (int i = 0; i < count; i++) {
+        Heartbeat* hb = &heartbeats[i];
+        printf("%-14s %10llu %8d %8llu %11.0f ms\n", hb->name,
+               (unsigned long long)atomic_load(&hb->beats), atomic_load(&hb->expectedMs),
+               (unsigned long long)atomic_load(&hb->stalls), hb->longestStallNs / 1e6);
     }
-    else if (cellContent == '0') {
-        if (gameState.ghostVulnerable) {
-            preservePowerPellet = true;
-            printf("Ghost already vulnerable, preserving power pellet\n");
-        } else {
-            gameState.score += 50;
-            gameState.powerPelletActive = true;
-            gameState.ghostVulnerable = true;
-            gameState.powerPelletDuration = 0.0f;
-            gameState.ghostVulnerableDuration = 0.0f;
-        }
+    pthread_mutex_unlock(&heartbeatSlotsMutex);
+    printf("total stalls: %llu\n", (unsigned long long)watchdogStallCount());
+}
+
+void handlePacmanLeaving(int row, int col) {
+    // If there was a power pellet at this location, restore it
+    if (gameState.powerPelletLocations[row][col]) {
+        gameState.board[row][col] = '0';
+    } else {
+        gameState.board[row][col] = ' ';
     }
-    else if (cellContent == '#') {
-        bool ghostVulnerable = false;
-        for (int g = 0; g < MAX_GHOSTS; g++) {
-            if (ghosts[g].row == newRow && ghosts[g].col == newCol) {
-                ghostVulnerable = ghosts[g].isVulnerable;
-                break;
-            }
-        }
-        if (ghostVulnerable) {
-            gameState.score += 200;
-        } else {
-            gameState.lives--;
-            gameState.currentDirection = DIR_NONE;
-            if (gameState.lives <= 0) {
-                pthread_mutex_lock(&uiState.mutex);
-                uiState.currentScreen = SCREEN_GAME_OVER;
-                uiState.needsRedraw = true;
-                pthread_mutex_unlock(&uiState.mutex);
-            }
-            gameState.board[oldRow][oldCol] = ' ';
-            gameState.pacmanRow = gameState.pacmanStartRow;
-            gameState.pacmanCol = gameState.pacmanStartCol;
-            gameState.board[gameState.pacmanRow][gameState.pacmanCol] = '@';
-            pthread_mutex_unlock(&gameState.mutex);
-            return;
-        }
+}
+//scoreBoard functions
+static bool mapScoreStore(uint64_t capacity) {
+    size_t size = sizeof(ScoreStoreHeader) + capacity * sizeof(ScoreEntry);
+    void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, scoreStore.fd, 0);
+    if (mapped == MAP_FAILED) {
+        return false;
     }
-    
-    // Always clear Pacman's old position
-    // Use the helper function to properly handle power pellet locations
-    handlePacmanLeaving(oldRow, oldCol);
-    
-    // Update Pacman's new position
-    gameState.pacmanRow = newRow;
-    gameState.pacmanCol = newCol;
-    
-    // Update Pacman's new position
-    gameState.pacmanRow = newRow;
-    gameState.pacmanCol = newCol;
-    
-    // If we want to preserve the power pellet, remember it's still there
-    if (preservePowerPellet) {
-        gameState.board[newRow][newCol] = '@';
-        gameState.powerPelletLocations[newRow][newCol] = true;  // Mark that a power pellet is at this location
-    } else {
-        gameState.board[newRow][newCol] = '@';
+    scoreStore.mappedSize = size;
+    scoreStore.header = (ScoreStoreHeader*)mapped;
+    scoreStore.entries = (ScoreEntry*)((char*)mapped + sizeof(ScoreStoreHeader));
+    return true;
+}
+
+static void unmapScoreStore() {
+    if (scoreStore.header != NULL) {
+        munmap(scoreStore.header, scoreStore.mappedSize);
     }
-    
-    pthread_mutex_unlock(&gameState.mutex);
+    scoreStore.header = NULL;
+    scoreStore.entries = NULL;
+    scoreStore.mappedSize = 0;
 }
 
+bool openScoreStore(const char* path) {
+    if (scoreStore.header != NULL) {
+        return true;
+    }
+    scoreStore.fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (scoreStore.fd < 0) {
+        printf("Error opening score store %s\n", path);
+        return false;
+    }
+    // Inserts memmove entries in the shared mapping, so only one game at a
+    // time may have the store open. The lock goes away with the descriptor.
+    if (flock(scoreStore.fd, LOCK_EX | LOCK_NB) != 0) {
+        printf("Score store %s is in use by another game\n", path);
+        closeScoreStore();
+        return false;
+    }
 
-void renderMenu(sfRenderWindow* window, sfFont* font) {
-    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
-   
-    sfText* titleText = sfText_create();
-    sfText_setFont(titleText, font);
-    sfText_setString(titleText, "PACMAN");
-    sfText_setCharacterSize(titleText, 72);
-    sfText_setFillColor(titleText, sfYellow);
-   
-    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
-    sfText_setPosition(titleText, (sfVector2f){
-        (WINDOW_WIDTH - titleBounds.width) / 2,
-        WINDOW_HEIGHT * 0.2f
-    });
-   
-    sfRenderWindow_drawText(window, titleText, NULL);
+    struct stat st;
+    if (fstat(scoreStore.fd, &st) != 0) {
+        closeScoreStore();
+        return false;
+    }
 
-    pthread_mutex_lock(&uiState.mutex);
-    char usernameLabel[64];
-    sprintf(usernameLabel, "Player: %s", uiState.username);
-    bool enteringUsername = uiState.enteringUsername;
-    int selectedItem = uiState.selectedMenuItem;
-    pthread_mutex_unlock(&uiState.mutex);
+    if (st.st_size == 0) {
+        // Fresh store: lay down an empty header with some room to grow
+        size_t size = sizeof(ScoreStoreHeader) + SCORE_STORE_MIN_CAPACITY * sizeof(ScoreEntry);
+        if (ftruncate(scoreStore.fd, size) != 0 || !mapScoreStore(SCORE_STORE_MIN_CAPACITY)) {
+            closeScoreStore();
+            return false;
+        }
+        scoreStore.header->magic = SCORE_STORE_MAGIC;
+        scoreStore.header->version = SCORE_STORE_VERSION;
+        scoreStore.header->count = 0;
+        scoreStore.header->capacity = SCORE_STORE_MIN_CAPACITY;
+        return true;
+    }
 
-    sfText* usernameText = sfText_create();
-    sfText_setFont(usernameText, font);
-    sfText_setString(usernameText, usernameLabel);
-    sfText_setCharacterSize(usernameText, 28);
-    sfText_setFillColor(usernameText, enteringUsername ? sfYellow : sfWhite);
-   
-    sfFloatRect usernameBounds = sfText_getLocalBounds(usernameText);
-    sfText_setPosition(usernameText, (sfVector2f){
-        (WINDOW_WIDTH - usernameBounds.width) / 2,
-        WINDOW_HEIGHT * 0.35f
-    });
-   
-    sfRenderWindow_drawText(window, usernameText, NULL);
-    sfText_destroy(usernameText);
+    if ((size_t)st.st_size < sizeof(ScoreStoreHeader)) {
+        printf("Score store %s is truncated\n", path);
+        closeScoreStore();
+        return false;
+    }
 
-    for (int i = 0; i < MENU_ITEM_COUNT; i++) {
-        sfText* menuItemText = sfText_create();
-        sfText_setFont(menuItemText, font);
-        sfText_setString(menuItemText, menuItems[i]);
-        sfText_setCharacterSize(menuItemText, 36);
-       
-        if (i == selectedItem) {
-            sfText_setFillColor(menuItemText, sfYellow);
-            char selectedText[50];
-            sprintf(selectedText, "> %s", menuItems[i]);
-            sfText_setString(menuItemText, selectedText);
+    uint64_t capacity = ((size_t)st.st_size - sizeof(ScoreStoreHeader)) / sizeof(ScoreEntry);
+    if (!mapScoreStore(capacity)) {
+        closeScoreStore();
+        return false;
+    }
+    if (scoreStore.header->magic != SCORE_STORE_MAGIC ||
+        scoreStore.header->version != SCORE_STORE_VERSION ||
+        scoreStore.header->count > capacity) {
+        printf("Score store %s has an unknown format\n", path);
+        closeScoreStore();
+        return false;
+    }
+    scoreStore.header->capacity = capacity;
+    return true;
+}
+
+void closeScoreStore() {
+    if (scoreStore.header != NULL) {
+        msync(scoreStore.header, scoreStore.mappedSize, MS_SYNC);
+    }
+    unmapScoreStore();
+    if (scoreStore.fd >= 0) {
+        close(scoreStore.fd);
+    }
+    scoreStore.fd = -1;
+}
+
+static bool growScoreStore(uint64_t minCapacity) {
+    uint64_t capacity = scoreStore.header->capacity;
+    if (capacity >= minCapacity) {
+        return true;
+    }
+    while (capacity < minCapacity) {
+        capacity *= 2;
+    }
+    size_t size = sizeof(ScoreStoreHeader) + capacity * sizeof(ScoreEntry);
+    unmapScoreStore();
+    if (ftruncate(scoreStore.fd, size) != 0 || !mapScoreStore(capacity)) {
+        printf("Error growing score store\n");
+        return false;
+    }
+    scoreStore.header->capacity = capacity;
+    return true;
+}
+
+// Index of the first entry whose score is <= score (entries are descending),
+// which is also the number of entries that beat it.
+static uint64_t scoreStoreFirstAtOrBelow(int score) {
+    uint64_t lo = 0;
+    uint64_t hi = scoreStore.header->count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (scoreStore.entries[mid].score > score) {
+            lo = mid + 1;
         } else {
-            sfText_setFillColor(menuItemText, sfWhite);
+            hi = mid;
         }
-       
-        sfFloatRect itemBounds = sfText_getLocalBounds(menuItemText);
-        sfText_setPosition(menuItemText, (sfVector2f){
-            (WINDOW_WIDTH - itemBounds.width) / 2,
-            WINDOW_HEIGHT * 0.4f + i * 60
-        });
-       
-        sfRenderWindow_drawText(window, menuItemText, NULL);
-        sfText_destroy(menuItemText);
     }
-   
-    sfText* instructionsText = sfText_create();
-    sfText_setFont(instructionsText, font);
-    sfText_setString(instructionsText,
-        "Press U to set username | UP/DOWN to navigate | ENTER to select");
-    sfText_setCharacterSize(instructionsText, 20);
-    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
-   
-    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
-    sfText_setPosition(instructionsText, (sfVector2f){
-        (WINDOW_WIDTH - instrBounds.width) / 2,
-        WINDOW_HEIGHT * 0.85f
-    });
-   
-    sfRenderWindow_drawText(window, instructionsText, NULL);
-   
-    sfText_destroy(titleText);
-    sfText_destroy(instructionsText);
-    sfRenderWindow_display(window);
+    return lo;
 }
 
-void renderScoreboard(sfRenderWindow* window, sfFont* font) {
-    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
-   
-    sfText* titleText = sfText_create();
-    sfText_setFont(titleText, font);
-    sfText_setString(titleText, "SCOREBOARD");
-    sfText_setCharacterSize(titleText, 48);
-    sfText_setFillColor(titleText, sfYellow);
-   
-    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
-    sfText_setPosition(titleText, (sfVector2f){
-        (WINDOW_WIDTH - titleBounds.width) / 2,
-        WINDOW_HEIGHT * 0.2f
-    });
-   
-    sfRenderWindow_drawText(window, titleText, NULL);
-   
-    for (int i = 0; i < scoreCount; i++) {
-        char scoreLine[64];
-        sprintf(scoreLine, "%d. %s - %d", i + 1, scoreBoard[i].username, scoreBoard[i].score);
-       
-        sfText* scoreText = sfText_create();
-        sfText_setFont(scoreText, font);
-        sfText_setString(scoreText, scoreLine);
-        sfText_setCharacterSize(scoreText, 24);
-        sfText_setFillColor(scoreText, sfWhite);
-       
-        sfFloatRect scoreBounds = sfText_getLocalBounds(scoreText);
-        sfText_setPosition(scoreText, (sfVector2f){
-            (WINDOW_WIDTH - scoreBounds.width) / 2,
-            WINDOW_HEIGHT * 0.3f + i * 30
-        });
-       
-        sfRenderWindow_drawText(window, scoreText, NULL);
-        sfText_destroy(scoreText);
+// Index of the first entry whose score is strictly below score.
+static uint64_t scoreStoreFirstBelow(int score) {
+    uint64_t lo = 0;
+    uint64_t hi = scoreStore.header->count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (scoreStore.entries[mid].score >= score) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-   
-    sfText* instructionsText = sfText_create();
-    sfText_setFont(instructionsText, font);
-    sfText_setString(instructionsText, "Press ESC to return to menu");
-    sfText_setCharacterSize(instructionsText, 20);
-    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
-   
-    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
-    sfText_setPosition(instructionsText, (sfVector2f){
-        (WINDOW_WIDTH - instrBounds.width) / 2,
-        WINDOW_HEIGHT * 0.85f
-    });
-   
-    sfRenderWindow_drawText(window, instructionsText, NULL);
-   
-    sfText_destroy(titleText);
-    sfText_destroy(instructionsText);
-    sfRenderWindow_display(window);
+    return lo;
 }
 
-void renderInstructions(sfRenderWindow* window, sfFont* font) {
-    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
-   
-    sfText* titleText = sfText_create();
-    sfText_setFont(titleText, font);
-    sfText_setString(titleText, "INSTRUCTIONS");
-    sfText_setCharacterSize(titleText, 48);
-    sfText_setFillColor(titleText, sfYellow);
-   
-    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
-    sfText_setPosition(titleText, (sfVector2f){
-        (WINDOW_WIDTH - titleBounds.width) / 2,
-        WINDOW_HEIGHT * 0.1f
-    });
-   
-    sfRenderWindow_drawText(window, titleText, NULL);
-   
-    const char* instructionsLines[] = {
-        "Use the WASD keys to control Pacman:",
-        "W - Move Up",
-        "A - Move Left",
-        "S - Move Down",
-        "D - Move Right",
-        "",
-        "Collect dots for 10 points each",
-        "Power pellets (large dots) worth 50 points",
-        "Eat ghosts for 200 points when powered up",
-        "",
-        "Press ESC to return to menu during gameplay"
+bool scoreStoreInsert(const char* username, int score) {
+    if (scoreStore.header == NULL) {
+        return false;
+    }
+    uint64_t count = scoreStore.header->count;
+    if (!growScoreStore(count + 1)) {
+        return false;
+    }
+
+    // Ties keep arrival order: the new entry goes after every equal score
+    uint64_t insertPos = scoreStoreFirstBelow(score);
+    memmove(&scoreStore.entries[insertPos + 1], &scoreStore.entries[insertPos],
+            (count - insertPos) * sizeof(ScoreEntry));
+
+    ScoreEntry* entry = &scoreStore.entries[insertPos];
+    memset(entry->username, 0, sizeof(entry->username));
+    strncpy(entry->username, username, sizeof(entry->username) - 1);
+    entry->score = score;
+    scoreStore.header->count = count + 1;
+    return true;
+}
+
+uint64_t scoreStoreRank(int score) {
+    if (scoreStore.header == NULL) {
+        return 0;
+    }
+    return scoreStoreFirstAtOrBelow(score) + 1;
+}
+
+uint64_t scoreStoreCount() {
+    return scoreStore.header != NULL ? scoreStore.header->count : 0;
+}
+
+int scoreStoreRange(uint64_t firstRank, int maxCount, ScoreEntry* out) {
+    if (scoreStore.header == NULL || firstRank == 0 || firstRank > scoreStore.header->count) {
+        return 0;
+    }
+    uint64_t available = scoreStore.header->count - (firstRank - 1);
+    int n = (available < (uint64_t)maxCount) ? (int)available : maxCount;
+    memcpy(out, &scoreStore.entries[firstRank - 1], n * sizeof(ScoreEntry));
+    return n;
+}
+
+uint64_t scoreStoreCountInRange(int minScore, int maxScore) {
+    if (scoreStore.header == NULL || minScore > maxScore) {
+        return 0;
+    }
+    return scoreStoreFirstBelow(minScore) - scoreStoreFirstAtOrBelow(maxScore);
+}
+
+int importLegacyScores(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1;
+    }
+    char username[32];
+    int score;
+    int imported = 0;
+    while (fscanf(file, "%31s %d", username, &score) == 2) {
+        if (!scoreStoreInsert(username, score)) {
+            break;
+        }
+        imported++;
+    }
+    fclose(file);
+    msync(scoreStore.header, scoreStore.mappedSize, MS_SYNC);
+    return imported;
+}
+
+void loadScores() {
+    scoreCount = 0;
+    if (!openScoreStore(SCORE_FILE)) {
+        return;
+    }
+    // First run after the switch to the binary store: pull in the old text scores
+    if (scoreStoreCount() == 0 && access(LEGACY_SCORE_FILE, R_OK) == 0) {
+        int imported = importLegacyScores(LEGACY_SCORE_FILE);
+        if (imported > 0) {
+            printf("Imported %d scores from %s\n", imported, LEGACY_SCORE_FILE);
+        }
+    }
+    scoreCount = scoreStoreRange(1, MAX_SCORES, scoreBoard);
+}
+
+void saveScores() {
+    if (scoreStore.header == NULL) {
+        printf("Error opening score file for writing.\n");
+        return;
+    }
+    msync(scoreStore.header, scoreStore.mappedSize, MS_ASYNC);
+}
+
+void addScore(const char* username, int score) {
+    if (!scoreStoreInsert(username, score)) {
+        return;
+    }
+    lastScoreRank = scoreStoreRank(score);
+    lastScoreTotal = scoreStoreCount();
+    lastScoreNearby = scoreStoreCountInRange(score - SCORE_NEARBY_POINTS, score + SCORE_NEARBY_POINTS) - 1;
+    scoreCount = scoreStoreRange(1, MAX_SCORES, scoreBoard);
+    saveScores();
+}
+
+void ledgerInit(ResourceLedger* ledger, const char* name, int total) {
+    memset(ledger, 0, sizeof(*ledger));
+    ledger->name = name;
+    ledger->total = total;
+    ledger->free = total;
+}
+
+static void ledgerViolation(ResourceLedger* ledger) {
+    ledger->violations++;
+    atomic_fetch_add(&resourceViolations, 1);
+}
+
+static inline void ledgerCheck(ResourceLedger* ledger) {
+    if (ledger->heldTotal + ledger->free != ledger->total || ledger->free < 0) {
+        LOG_ERROR("%s accounting broken: held %d + free %d != total %d",
+                  ledger->name, ledger->heldTotal, ledger->free, ledger->total);
+        ledgerViolation(ledger);
+    }
+}
+
+bool ledgerTake(ResourceLedger* ledger, int ghostId) {
+    if (ledger->free <= 0) {
+        return false;
+    }
+    if (ledger->heldBy[ghostId] != 0) {
+        LOG_ERROR("Ghost %d took a second %s while still holding one", ghostId, ledger->name);
+        ledgerViolation(ledger);
+    }
+    ledger->free--;
+    ledger->heldTotal++;
+    ledger->heldBy[ghostId]++;
+    ledgerCheck(ledger);
+    return true;
+}
+
+bool ledgerGive(ResourceLedger* ledger, int ghostId) {
+    if (ledger->heldBy[ghostId] <= 0) {
+        LOG_ERROR("Ghost %d returned a %s it does not hold", ghostId, ledger->name);
+        ledgerViolation(ledger);
+        return false;
+    }
+    ledger->heldBy[ghostId]--;
+    ledger->heldTotal--;
+    ledger->free++;
+    ledgerCheck(ledger);
+    return true;
+}
+
+// Caller holds speedBoostAvailMutex
+static void endSpeedBoost(Ghost* ghost, uint64_t now) {
+    ledgerGive(&boostLedger, ghost->id);
+    boostScheduler.boostedNsTotal += now - ghost->boostStartNs;
+    ghost->hasSpeedBoost = false;
+    ghost->speedBoostDuration = 0.0f;
+    atomic_store(&ghost->moveTimer.intervalMs, ghost->baseIntervalMs);
+}
+
+void returnSpeedBoost(Ghost* ghost) {
+    MUTEX_LOCK(speedBoostAvailMutex);
+    if (ghost->hasSpeedBoost) {
+        endSpeedBoost(ghost, monotonicNs());
+    }
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+}
+
+void boostSchedulerInit() {
+    MUTEX_LOCK(speedBoostAvailMutex);
+    ledgerInit(&boostLedger, "speed boost", BOOST_SLOTS);
+    memset(&boostScheduler, 0, sizeof(boostScheduler));
+    boostScheduler.tokens = BOOST_BUCKET_CAPACITY;
+    boostScheduler.startNs = monotonicNs();
+    boostScheduler.lastRefillNs = boostScheduler.startNs;
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+}
+
+static bool isBoostEligible(const Ghost* ghost) {
+    return (ghost->ghostType == 1 || ghost->ghostType == 2) &&
+           ghost->isActive && !ghost->inGhostHouse && !ghost->needsRespawn &&
+           !ghost->hasSpeedBoost;
+}
+
+void boostSchedulerTick() {
+    uint64_t now = monotonicNs();
+    // Eligibility reads ghost flags that the ghost threads write under their
+    // cells' locks, so the board is held for the pass
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    MUTEX_LOCK(speedBoostAvailMutex);
+
+    double elapsed = (now - boostScheduler.lastRefillNs) / 1e9;
+    boostScheduler.lastRefillNs = now;
+    boostScheduler.tokens += elapsed * BOOST_TOKENS_PER_SEC;
+    if (boostScheduler.tokens > BOOST_BUCKET_CAPACITY) {
+        boostScheduler.tokens = BOOST_BUCKET_CAPACITY;
+    }
+
+    // Expire on wall-clock time, independent of each ghost's tick rate
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        if (!ghost->hasSpeedBoost) continue;
+        if (now >= ghost->boostEndNs) {
+            endSpeedBoost(ghost, now);
+        } else {
+            ghost->speedBoostDuration = (ghost->boostEndNs - now) / 1e9f;
+        }
+    }
+
+    for (int n = 0; n < MAX_GHOSTS; n++) {
+        Ghost* ghost = &ghosts[(boostScheduler.nextGhost + n) % MAX_GHOSTS];
+        if (!isBoostEligible(ghost)) continue;
+        if (boostScheduler.tokens < 1.0 || !ledgerTake(&boostLedger, ghost->id)) {
+            boostScheduler.denied++;
+            continue;
+        }
+        boostScheduler.tokens -= 1.0;
+        boostScheduler.grants++;
+        ghost->hasSpeedBoost = true;
+        ghost->boostStartNs = now;
+        ghost->boostEndNs = now + (uint64_t)BOOST_DURATION_MS * 1000000ull;
+        ghost->speedBoostDuration = BOOST_DURATION_MS / 1000.0f;
+        atomic_store(&ghost->moveTimer.intervalMs, ghost->baseIntervalMs / 2);
+        boostScheduler.nextGhost = (ghost->id + 1) % MAX_GHOSTS;
+    }
+
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+void printBoostReport() {
+    MUTEX_LOCK(speedBoostAvailMutex);
+    uint64_t now = monotonicNs();
+    uint64_t boostedNs = boostScheduler.boostedNsTotal;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (ghosts[i].hasSpeedBoost) {
+            boostedNs += now - ghosts[i].boostStartNs;
+        }
+    }
+    double wallSeconds = (now - boostScheduler.startNs) / 1e9;
+    printf("\n=== Speed boosts ===\n");
+    printf("grants=%llu denied=%llu boosted=%.1fs utilization=%.1f%% of %d slots\n",
+           (unsigned long long)boostScheduler.grants,
+           (unsigned long long)boostScheduler.denied,
+           boostedNs / 1e9,
+           wallSeconds > 0 ? 100.0 * (boostedNs / 1e9) / (wallSeconds * BOOST_SLOTS) : 0.0,
+           BOOST_SLOTS);
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+}
+
+// pacmanView layout: bits 0-15 row, 16-31 col, 32-39 direction,
+// bit 40 ghostVulnerable, 41 gameRunning, 42 gamePaused, 43 valid.
+#define PACMAN_VIEW_VULNERABLE (1ull << 40)
+#define PACMAN_VIEW_RUNNING (1ull << 41)
+#define PACMAN_VIEW_PAUSED (1ull << 42)
+#define PACMAN_VIEW_VALID (1ull << 43)
+
+// Called by every writer of the packed fields, with gameState.mutex held, so
+// publishes are ordered and readers always see one coherent state.
+void publishPacmanView() {
+    uint64_t word = (uint64_t)(uint16_t)gameState.pacmanRow |
+                    ((uint64_t)(uint16_t)gameState.pacmanCol << 16) |
+                    ((uint64_t)(uint8_t)gameState.currentDirection << 32) |
+                    PACMAN_VIEW_VALID;
+    if (gameState.ghostVulnerable) word |= PACMAN_VIEW_VULNERABLE;
+    if (gameState.gameRunning) word |= PACMAN_VIEW_RUNNING;
+    if (gameState.gamePaused) word |= PACMAN_VIEW_PAUSED;
+    atomic_store_explicit(&gameState.pacmanView, word, memory_order_release);
+}
+
+PacmanView loadPacmanView() {
+    uint64_t word = atomic_load_explicit(&gameState.pacmanView, memory_order_acquire);
+    PacmanView view;
+    view.valid = (word & PACMAN_VIEW_VALID) != 0;
+    view.row = (int16_t)(word & 0xFFFF);
+    view.col = (int16_t)((word >> 16) & 0xFFFF);
+    view.direction = (Direction)((word >> 32) & 0xFF);
+    view.ghostVulnerable = (word & PACMAN_VIEW_VULNERABLE) != 0;
+    view.gameRunning = (word & PACMAN_VIEW_RUNNING) != 0;
+    view.gamePaused = (word & PACMAN_VIEW_PAUSED) != 0;
+    return view;
+}
+
+static const char* boardLockModeNames[BOARD_LOCK_MODE_COUNT] = { "global", "tiles", "cas" };
+
+bool tileGridInit(TileLockGrid* grid, int rows, int cols, int tileSize) {
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->tileSize = tileSize;
+    grid->tileCols = (cols + tileSize - 1) / tileSize;
+    grid->tileCount = ((rows + tileSize - 1) / tileSize) * grid->tileCols;
+    grid->locks = malloc(sizeof(pthread_mutex_t) * grid->tileCount);
+    if (grid->locks == NULL) {
+        grid->tileCount = 0;
+        return false;
+    }
+    for (int t = 0; t < grid->tileCount; t++) {
+        pthread_mutex_init(&grid->locks[t], NULL);
+    }
+    return true;
+}
+
+void tileGridDestroy(TileLockGrid* grid) {
+    for (int t = 0; t < grid->tileCount; t++) {
+        pthread_mutex_destroy(&grid->locks[t]);
+    }
+    free(grid->locks);
+    grid->locks = NULL;
+    grid->tileCount = 0;
+}
+
+static inline int tileIndex(const TileLockGrid* grid, int row, int col) {
+    return (row / grid->tileSize) * grid->tileCols + col / grid->tileSize;
+}
+
+// Both cells must be on the grid. Returns how many tiles were locked (1 or 2).
+int tileGridLockCells(TileLockGrid* grid, int row1, int col1, int row2, int col2, int held[2]) {
+    int a = tileIndex(grid, row1, col1);
+    int b = tileIndex(grid, row2, col2);
+    if (a == b) {
+        tracedMutexLock(&grid->locks[a], "lock board tile");
+        held[0] = a;
+        return 1;
+    }
+    held[0] = a < b ? a : b;
+    held[1] = a < b ? b : a;
+    tracedMutexLock(&grid->locks[held[0]], "lock board tile");
+    tracedMutexLock(&grid->locks[held[1]], "lock board tile");
+    return 2;
+}
+
+void tileGridUnlock(TileLockGrid* grid, const int held[2], int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        pthread_mutex_unlock(&grid->locks[held[i]]);
+    }
+}
+
+void tileGridLockAll(TileLockGrid* grid) {
+    for (int t = 0; t < grid->tileCount; t++) {
+        tracedMutexLock(&grid->locks[t], "lock board tile");
+    }
+}
+
+void tileGridUnlockAll(TileLockGrid* grid) {
+    for (int t = grid->tileCount - 1; t >= 0; t--) {
+        pthread_mutex_unlock(&grid->locks[t]);
+    }
+}
+
+// PACMAN_BOARD_LOCKS=global falls back to the single board mutex
+void initBoardLocks() {
+    const char* modeEnv = getenv("PACMAN_BOARD_LOCKS");
+    if (modeEnv != NULL && strcasecmp(modeEnv, "global") == 0) {
+        boardLockMode = BOARD_LOCK_GLOBAL;
+    }
+    if (!tileGridInit(&boardTiles, ROWS, COLS, BOARD_TILE_SIZE)) {
+        boardLockMode = BOARD_LOCK_GLOBAL;
+    }
+    LOG_INFO("Board locking: %s", boardLockModeNames[boardLockMode]);
+}
+
+// Lock order: gameState.mutex, then board tiles in ascending index, then
+// uiState.mutex. Ghost moves take only the tiles they touch; code that already
+// holds gameState.mutex adds tiles with lockBoardTiles()/lockWholeBoard().
+BoardCellLock lockBoardCells(int row1, int col1, int row2, int col2) {
+    if (boardLockMode == BOARD_LOCK_GLOBAL) {
+        BoardCellLock lock = { true, { 0, 0 }, 0 };
+        MUTEX_LOCK(gameState.mutex);
+        return lock;
+    }
+    return lockBoardTiles(row1, col1, row2, col2);
+}
+
+// For callers holding gameState.mutex: adds the tiles in tile mode, else nothing
+BoardCellLock lockBoardTiles(int row1, int col1, int row2, int col2) {
+    BoardCellLock lock = { false, { 0, 0 }, 0 };
+    if (boardLockMode == BOARD_LOCK_TILES) {
+        lock.count = tileGridLockCells(&boardTiles, row1, col1, row2, col2, lock.held);
+    }
+    return lock;
+}
+
+void unlockBoardCells(BoardCellLock lock) {
+    if (lock.global) {
+        MUTEX_UNLOCK(gameState.mutex);
+    } else {
+        tileGridUnlock(&boardTiles, lock.held, lock.count);
+    }
+}
+
+// Whole-board readers and writers, called with gameState.mutex held
+void lockWholeBoard() {
+    if (boardLockMode == BOARD_LOCK_TILES) {
+        tileGridLockAll(&boardTiles);
+    }
+}
+
+void unlockWholeBoard() {
+    if (boardLockMode == BOARD_LOCK_TILES) {
+        tileGridUnlockAll(&boardTiles);
+    }
+}
+
+void resetGhost(Ghost* ghost) {
+    // Hand back anything still held so the house counts stay exact
+    releaseGhostHouseResources(ghost);
+    returnSpeedBoost(ghost);
+
+    BoardCellLock cells = lockBoardCells(ghost->respawnRow, ghost->respawnCol,
+                                         ghost->respawnRow, ghost->respawnCol);
+    ghost->row = ghost->respawnRow;
+    ghost->col = ghost->respawnCol;
+    
+    ghost->isVulnerable = false;
+    ghost->needsRespawn = false;
+    ghost->inGhostHouse = true;
+    
+    ghost->cellContent = gameState.board[ghost->row][ghost->col];
+    gameState.board[ghost->row][ghost->col] = '#';
+    
+    //printf("Ghost %d has been reset\n", ghost->id);
+    unlockBoardCells(cells);
+}
+
+void initGhostHouseResources() {
+    static bool resourcesInitialized = false;
+    if (resourcesInitialized) {
+        return;
+    }
+    resourcesInitialized = true;
+
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        GhostHouse* house = &ghostHouses[h];
+        pthread_mutex_init(&house->mutex, NULL);
+        ledgerInit(&house->keys, "key", GHOST_HOUSE_KEYS);
+        ledgerInit(&house->permits, "exit permit", GHOST_HOUSE_PERMITS);
+        house->queueHead = 0;
+        house->queueLength = 0;
+    }
+    boostSchedulerInit();
+}
+
+// Grants key + permit pairs to the front of the queue while both are free.
+// roster is the ghost table the queued ids index. Caller holds whatever
+// guards the house.
+static void ghostHouseGrantWaiting(GhostHouse* house, Ghost* roster) {
+    while (house->queueLength > 0 && house->keys.free > 0 && house->permits.free > 0) {
+        Ghost* ghost = &roster[house->queue[house->queueHead]];
+        house->queueHead = (house->queueHead + 1) % MAX_GHOSTS;
+        house->queueLength--;
+
+        ledgerTake(&house->keys, ghost->id);
+        ledgerTake(&house->permits, ghost->id);
+        ghost->hasKey = true;
+        ghost->hasExitPermit = true;
+        ghost->queuedForHouse = false;
+
+        uint64_t waitNs = monotonicNs() - ghost->houseRequestNs;
+        ghost->houseGrants++;
+        ghost->houseWaitNsTotal += waitNs;
+        if (waitNs > ghost->houseWaitNsMax) {
+            ghost->houseWaitNsMax = waitNs;
+        }
+    }
+}
+
+// Removes a ghost's pending request, keeping everyone else's order.
+// Caller holds house->mutex.
+static void ghostHouseCancelRequest(GhostHouse* house, Ghost* ghost) {
+    int kept = 0;
+    for (int i = 0; i < house->queueLength; i++) {
+        int id = house->queue[(house->queueHead + i) % MAX_GHOSTS];
+        if (id != ghost->id) {
+            house->queue[(house->queueHead + kept) % MAX_GHOSTS] = id;
+            kept++;
+        }
+    }
+    house->queueLength = kept;
+    ghost->queuedForHouse = false;
+}
+
+bool tryAcquireGhostHouseResources(Ghost* ghost) {
+    if (!ghost->inGhostHouse) return true;
+    GhostHouse* house = &ghostHouses[ghost->houseId];
+
+    MUTEX_LOCK(house->mutex);
+    bool granted = ghostHouseTryAcquire(house, ghosts, ghost);
+    MUTEX_UNLOCK(house->mutex);
+    return granted;
+}
+
+// The ticket logic itself, for any house and ghost table (the session server
+// gives every session its own). Caller holds whatever guards the house.
+bool ghostHouseTryAcquire(GhostHouse* house, Ghost* roster, Ghost* ghost) {
+    if (!ghost->inGhostHouse) return true;
+
+    if (!(ghost->hasKey && ghost->hasExitPermit) && !ghost->queuedForHouse) {
+        // Take a ticket: join the back of the queue
+        house->queue[(house->queueHead + house->queueLength) % MAX_GHOSTS] = ghost->id;
+        house->queueLength++;
+        ghost->queuedForHouse = true;
+        ghost->houseRequestNs = monotonicNs();
+        ghostHouseGrantWaiting(house, roster);
+    }
+    return ghost->hasKey && ghost->hasExitPermit;
+}
+
+// Compares what each ledger says a ghost holds with the ghost's own flags.
+// A mismatch is reported as a leak with the owning ghost and repaired by
+// returning the unit to its pool; live semaphores and mutexes are never
+// destroyed or re-initialised, so blocked ghosts are unaffected.
+void verifyGhostHouseState() {
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        GhostHouse* house = &ghostHouses[h];
+        MUTEX_LOCK(house->mutex);
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            Ghost* ghost = &ghosts[i];
+            if (ghost->houseId != h) continue;
+            if (house->keys.heldBy[i] > 0 && !ghost->hasKey) {
+                LOG_WARN("Leak: ghost %d's key is unaccounted for, reclaiming it", i);
+                ledgerGive(&house->keys, i);
+            } else if (house->keys.heldBy[i] == 0 && ghost->hasKey) {
+                LOG_WARN("Ghost %d claims a key the house never granted", i);
+                ghost->hasKey = false;
+            }
+            if (house->permits.heldBy[i] > 0 && !ghost->hasExitPermit) {
+                LOG_WARN("Leak: ghost %d's exit permit is unaccounted for, reclaiming it", i);
+                ledgerGive(&house->permits, i);
+            } else if (house->permits.heldBy[i] == 0 && ghost->hasExitPermit) {
+                LOG_WARN("Ghost %d claims an exit permit the house never granted", i);
+                ghost->hasExitPermit = false;
+            }
+        }
+        ghostHouseGrantWaiting(house, ghosts);
+        MUTEX_UNLOCK(house->mutex);
+    }
+
+    MUTEX_LOCK(speedBoostAvailMutex);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (boostLedger.heldBy[i] > 0 && !ghosts[i].hasSpeedBoost) {
+            LOG_WARN("Leak: ghost %d's speed boost is unaccounted for, reclaiming it", i);
+            ledgerGive(&boostLedger, i);
+        } else if (boostLedger.heldBy[i] == 0 && ghosts[i].hasSpeedBoost) {
+            LOG_WARN("Ghost %d claims a speed boost the scheduler never granted", i);
+            ghosts[i].hasSpeedBoost = false;
+            atomic_store(&ghosts[i].moveTimer.intervalMs, ghosts[i].baseIntervalMs);
+        }
+    }
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+}
+
+void releaseGhostHouseResources(Ghost* ghost) {
+    GhostHouse* house = &ghostHouses[ghost->houseId];
+    MUTEX_LOCK(house->mutex);
+    ghostHouseRelease(house, ghosts, ghost);
+    MUTEX_UNLOCK(house->mutex);
+}
+
+// Caller holds whatever guards the house
+void ghostHouseRelease(GhostHouse* house, Ghost* roster, Ghost* ghost) {
+    bool hadKey = ghost->hasKey;
+    bool hadPermit = ghost->hasExitPermit;
+    
+    ghost->hasKey = false;
+    ghost->hasExitPermit = false;
+    if (hadKey) ledgerGive(&house->keys, ghost->id);
+    if (hadPermit) ledgerGive(&house->permits, ghost->id);
+    if (ghost->queuedForHouse) {
+        ghostHouseCancelRequest(house, ghost);
+    }
+    // Returned resources go straight to whoever is next in line
+    ghostHouseGrantWaiting(house, roster);
+    
+    if (hadKey) {
+        LOG_DEBUG("Ghost %d released key", ghost->id);
+    }
+    
+    if (hadPermit) {
+        LOG_DEBUG("Ghost %d released exit permit", ghost->id);
+    }
+}
+
+void printGhostHouseReport() {
+    printf("\n=== Ghost house waits ===\n");
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        printf("ghost %d (house %d): grants=%llu avg wait=%.2fms max wait=%.2fms\n",
+               ghost->id, ghost->houseId,
+               (unsigned long long)ghost->houseGrants,
+               ghost->houseGrants ? ghost->houseWaitNsTotal / 1e6 / ghost->houseGrants : 0.0,
+               ghost->houseWaitNsMax / 1e6);
+    }
+    printf("resource accounting violations: %llu\n",
+           (unsigned long long)atomic_load(&resourceViolations));
+}
+
+// Puts every ghost of roster back in its start slot on board. For the game
+// itself the caller holds gameState.mutex and the whole board, and has
+// already returned the ghosts' resources.
+void resetGhostSlots(Ghost* roster, char board[ROWS][COLS]) {
+    static const int ghostStartPositions[MAX_GHOSTS][2] = {
+        {6, 8},
+        {6, 9},
+        {7, 11},
+        {7, 12}
+    };
+    
+    static const int ghostRespawnPositions[MAX_GHOSTS][2] = {
+        {7, 8},  // Respawn in same positions
+        {7, 9},
+        {7, 10},
+        {7, 11}
     };
    
-    for (int i = 0; i < 11; i++) {
-        sfText* lineText = sfText_create();
-        sfText_setFont(lineText, font);
-        sfText_setString(lineText, instructionsLines[i]);
-        sfText_setCharacterSize(lineText, 24);
-        sfText_setFillColor(lineText, sfWhite);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        roster[i].row = ghostStartPositions[i][0];
+        roster[i].col = ghostStartPositions[i][1];
+        roster[i].id = i;
+        roster[i].direction = DIR_NONE;
+        roster[i].isVulnerable = false;
+        roster[i].isActive = true;
+        roster[i].needsRespawn = false;
+        roster[i].respawnRow = ghostRespawnPositions[i][0];
+        roster[i].respawnCol = ghostRespawnPositions[i][1];
+        roster[i].ghostType = i + 1;
+        roster[i].hasKey = false;           
+        roster[i].hasExitPermit = false;
+        roster[i].inGhostHouse = true;     
+        roster[i].houseId = i % MAX_GHOST_HOUSES;
+        roster[i].baseIntervalMs = GHOST_INTERVAL_MS + i * GHOST_INTERVAL_STEP_MS;
+        roster[i].queuedForHouse = false;
        
-        sfText_setPosition(lineText, (sfVector2f){
-            WINDOW_WIDTH * 0.15f,
-            WINDOW_HEIGHT * 0.25f + i * 35
-        });
+        board[roster[i].row][roster[i].col] = '#';
+        roster[i].cellContent = ' ';
+    }
+}
+
+static const int directionStepRow[] = { 0, -1, 1, 0, 0 };
+static const int directionStepCol[] = { 0, 0, 0, -1, 1 };
+
+// Only walls matter here; what else is on the board changes every move and
+// is checked by the mover
+void buildNeighborTable(CellNeighbors neighbors, const char board[ROWS][COLS]) {
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+                int nextRow = row + directionStepRow[d];
+                int nextCol = col + directionStepCol[d];
+                int next = nextRow * COLS + nextCol;
+                if (nextRow < 0 || nextRow >= ROWS || nextCol < 0 || nextCol >= COLS) {
+                    nextRow = (nextRow + ROWS) % ROWS;
+                    nextCol = (nextCol + COLS) % COLS;
+                    bool tunnel = board[row][col] != '=' && board[nextRow][nextCol] != '=';
+                    next = tunnel ? nextRow * COLS + nextCol : -1;
+                }
+                neighbors[row * COLS + col][d - 1] = (int16_t)next;
+            }
+        }
+    }
+}
+
+// Cell index one step from row,col, or -1 (off the board, or DIR_NONE)
+static inline int cellNeighbor(CellNeighbors neighbors, int row, int col, Direction direction) {
+    return direction == DIR_NONE ? -1 : neighbors[row * COLS + col][direction - 1];
+}
+
+// Pacman and a ghost on the same cell, whichever of them stepped there: a
+// vulnerable ghost is eaten, anything else costs pacman a life. The window
+// and the sessions both decide through this.
+typedef enum {
+    MEET_GHOST_EATEN,
+    MEET_PACMAN_CAUGHT
+} GhostMeeting;
+
+static inline GhostMeeting ghostMeetsPacman(const Ghost* ghost) {
+    return (ghost != NULL && ghost->isVulnerable) ? MEET_GHOST_EATEN : MEET_PACMAN_CAUGHT;
+}
+
+bool isValidGhostMove(char board[ROWS][COLS], int row, int col) {
+    if (row < 0 || row >= ROWS || col < 0 || col >= COLS) {
+        return false;
+    }
+   
+    char cell = board[row][col];
+    return (cell != '=' && cell != '#');
+}
+
+DirectionWeights calculateDirectionWeights(Ghost* ghost, int targetRow, int targetCol, Direction targetDirection) {
+    DirectionWeights weights = {1.0f, 1.0f, 1.0f, 1.0f};
+   
+    int currentRow = ghost->row;
+    int currentCol = ghost->col;
+   
+    int rowDiff = targetRow - currentRow;
+    int colDiff = targetCol - currentCol;
+   
+    switch (ghost->ghostType) {
+        case 1:
+            if (rowDiff < 0) weights.up *= 3.0f;
+            if (rowDiff > 0) weights.down *= 3.0f;
+            if (colDiff < 0) weights.left *= 3.0f;
+            if (colDiff > 0) weights.right *= 3.0f;
+            break;
+           
+        case 2: {
+            int aheadRow = targetRow;
+            int aheadCol = targetCol;
+           
+            switch (targetDirection) {
+                case DIR_UP:    aheadRow -= 4; break;
+                case DIR_DOWN:  aheadRow += 4; break;
+                case DIR_LEFT:  aheadCol -= 4; break;
+                case DIR_RIGHT: aheadCol += 4; break;
+                default: break;
+            }
+           
+            rowDiff = aheadRow - currentRow;
+            colDiff = aheadCol - currentCol;
+           
+            if (rowDiff < 0) weights.up *= 2.5f;
+            if (rowDiff > 0) weights.down *= 2.5f;
+            if (colDiff < 0) weights.left *= 2.5f;
+            if (colDiff > 0) weights.right *= 2.5f;
+            break;
+        }
+           
+        case 3:
+            if (rowDiff < 0) weights.up *= 2.0f;
+            if (rowDiff > 0) weights.down *= 2.0f;
+            if (colDiff < 0) weights.left *= 2.0f;
+            if (colDiff > 0) weights.right *= 2.0f;
+           
+            weights.up *= (1.0f + ((float)rand_r(&ghost->rngSeed) / RAND_MAX));
+            weights.down *= (1.0f + ((float)rand_r(&ghost->rngSeed) / RAND_MAX));
+            weights.left *= (1.0f + ((float)rand_r(&ghost->rngSeed) / RAND_MAX));
+            weights.right *= (1.0f + ((float)rand_r(&ghost->rngSeed) / RAND_MAX));
+            break;
+           
+        case 4:
+            float distance = sqrt((rowDiff * rowDiff) + (colDiff * colDiff));
+           
+            if (distance > 8.0f) {
+                if (rowDiff < 0) weights.up *= 3.0f;
+                if (rowDiff > 0) weights.down *= 3.0f;
+                if (colDiff < 0) weights.left *= 3.0f;
+                if (colDiff > 0) weights.right *= 3.0f;
+            } else {
+                int cornerRow = ROWS - 1;
+                int cornerCol = 0;
+               
+                int cornerRowDiff = cornerRow - currentRow;
+                int cornerColDiff = cornerCol - currentCol;
+               
+                if (cornerRowDiff < 0) weights.up *= 2.0f;
+                if (cornerRowDiff > 0) weights.down *= 2.0f;
+                if (cornerColDiff < 0) weights.left *= 2.0f;
+                if (cornerColDiff > 0) weights.right *= 2.0f;
+            }
+            break;
+    }
+   
+    if (ghost->isVulnerable) {
+        float temp = weights.up;
+        weights.up = weights.down;
+        weights.down = temp;
        
-        sfRenderWindow_drawText(window, lineText, NULL);
-        sfText_destroy(lineText);
+        temp = weights.left;
+        weights.left = weights.right;
+        weights.right = temp;
+    }
+   
+    switch (ghost->direction) {
+        case DIR_UP:    weights.down *= 0.2f; break;
+        case DIR_DOWN:  weights.up *= 0.2f; break;
+        case DIR_LEFT:  weights.right *= 0.2f; break;
+        case DIR_RIGHT: weights.left *= 0.2f; break;
+        default: break;
+    }
+   
+    return weights;
+}
+
+// Marks which of the four steps from the ghost's cell are open on a board
+// no other thread writes (a session's). Returns how many are.
+int ghostOpenMoves(char board[ROWS][COLS], CellNeighbors neighbors, const Ghost* ghost,
+                   bool validMoves[4]) {
+    int validCount = 0;
+    for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+        int next = cellNeighbor(neighbors, ghost->row, ghost->col, (Direction)d);
+        validMoves[d - 1] = next >= 0 && isValidGhostMove(board, next / COLS, next % COLS);
+        validCount += validMoves[d - 1];
+    }
+    return validCount;
+}
+
+// ghostOpenMoves() for the shared board. Each pair of opposite neighbours is
+// read under its cells' locks; the answer can still be stale by the time the
+// ghost moves, which is why moveGhost() validates the target again.
+int lockedGhostOpenMoves(const Ghost* ghost, bool validMoves[4]) {
+    int next[4];
+    for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+        next[d - 1] = cellNeighbor(gameState.neighbors, ghost->row, ghost->col, (Direction)d);
+    }
+    int validCount = 0;
+    for (int pair = 0; pair < 4; pair += 2) {
+        // A missing neighbour is stood in for by its opposite (or the ghost's cell)
+        int a = next[pair] >= 0 ? next[pair] : next[pair + 1];
+        int b = next[pair + 1] >= 0 ? next[pair + 1] : a;
+        if (a < 0) {
+            validMoves[pair] = validMoves[pair + 1] = false;
+            continue;
+        }
+        BoardCellLock cells = lockBoardCells(a / COLS, a % COLS, b / COLS, b % COLS);
+        for (int i = pair; i < pair + 2; i++) {
+            validMoves[i] = next[i] >= 0 && isValidGhostMove(gameState.board, next[i] / COLS, next[i] % COLS);
+            validCount += validMoves[i];
+        }
+        unlockBoardCells(cells);
+    }
+    return validCount;
+}
+
+Direction chooseGhostDirection(const bool validMoves[4], int validCount, Ghost* ghost,
+                               DirectionWeights weights) {
+    if (!validMoves[DIR_UP - 1]) weights.up = 0.0f;
+    if (!validMoves[DIR_DOWN - 1]) weights.down = 0.0f;
+    if (!validMoves[DIR_LEFT - 1]) weights.left = 0.0f;
+    if (!validMoves[DIR_RIGHT - 1]) weights.right = 0.0f;
+   
+    float totalWeight = weights.up + weights.down + weights.left + weights.right;
+   
+    if (totalWeight <= 0.0f || validCount == 0) {
+        if (validCount > 0) {
+            int randomIndex = rand_r(&ghost->rngSeed) % validCount;
+            int count = 0;
+            for (int i = 0; i < 4; i++) {
+                if (validMoves[i]) {
+                    if (count == randomIndex) {
+                        return (Direction)(i + 1);
+                    }
+                    count++;
+                }
+            }
+        }
+        return DIR_NONE;
+    }
+   
+    float random = ((float)rand_r(&ghost->rngSeed) / RAND_MAX) * totalWeight;
+   
+    if (random < weights.up) return DIR_UP;
+    random -= weights.up;
+   
+    if (random < weights.down) return DIR_DOWN;
+    random -= weights.down;
+   
+    if (random < weights.left) return DIR_LEFT;
+   
+    return DIR_RIGHT;
+}
+
+void moveGhost(Ghost* ghost, Direction direction) {
+    int oldRow = ghost->row;
+    int oldCol = ghost->col;
+    
+    // Off-board targets are rejected before any board lock is taken. The
+    // table may be swapped by a level change meanwhile; the generation check
+    // below catches that.
+    int next = cellNeighbor(gameState.neighbors, oldRow, oldCol, direction);
+    if (next < 0) {
+        return;
+    }
+    int newRow = next / COLS;
+    int newCol = next % COLS;
+    
+    // Only the source and target cells are locked (the whole board in global mode)
+    BoardCellLock cells = lockBoardCells(oldRow, oldCol, newRow, newCol);
+    
+    // The move was planned in a session that has since been reset
+    if (ghostSessionChanged(ghost)) {
+        unlockBoardCells(cells);
+        return;
+    }
+    
+    // if ghost is trying to leave ghost house
+    bool canLeaveGhostHouse = true;
+    if (ghost->inGhostHouse && !isInGhostHouse(newRow, newCol)) {
+        canLeaveGhostHouse = (ghost->hasKey && ghost->hasExitPermit);
+    }
+    
+    if (!isValidGhostMove(gameState.board, newRow, newCol) || !canLeaveGhostHouse) {
+        unlockBoardCells(cells);
+        return;
+    }
+    
+    // Handle collision with Pacman. Pacman publishes its position while it
+    // holds the tiles it moves between, so this is exact for the target cell.
+    PacmanView pacman = loadPacmanView();
+    if (pacman.valid && newRow == pacman.row && newCol == pacman.col) {
+        if (ghostMeetsPacman(ghost) == MEET_GHOST_EATEN) {
+            // Ghost gets eaten - DEBUG output
+           // printf("Ghost %d eaten! Setting needsRespawn=true\n", ghost->id);
+            
+            // Mark ghost as eaten
+            ghost->needsRespawn = true;
+            
+            // Restore cell content where ghost was
+            gameState.board[oldRow][oldCol] = ghost->cellContent;
+            
+            // Release any held resources immediately
+            unlockBoardCells(cells); // Release board locks before calling resource release
+            releaseGhostHouseResources(ghost);
+          
+            return;
+        }
+        // Caught; the ghost stays put this turn
+        unlockBoardCells(cells);
+        ghostCatchesPacman(ghost, newRow, newCol);
+        return;
+    }
+    
+    // Regular movement
+    // Restore what was under the ghost if it's not another entity
+    if (gameState.board[oldRow][oldCol] == '#') {
+        gameState.board[oldRow][oldCol] = ghost->cellContent;
+    }
+    
+    ghost->row = newRow;
+    ghost->col = newCol;
+    
+    // Save what's at the new position if it's not another entity
+    char newCellContent = gameState.board[newRow][newCol];
+    if (newCellContent != '@' && newCellContent != '#') {
+        ghost->cellContent = newCellContent;
+    }
+    
+    // Place ghost at new position
+    gameState.board[newRow][newCol] = '#';
+    
+    ghost->direction = direction;
+    
+    if (ghost->inGhostHouse && !isInGhostHouse(newRow, newCol)) {
+        ghost->inGhostHouse = false;
+        unlockBoardCells(cells); // Release board locks before calling resource release
+        releaseGhostHouseResources(ghost);
+        return;
+    }
+    
+    unlockBoardCells(cells);
+}
+
+void cleanupGhostHouseResources() {
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        pthread_mutex_destroy(&ghostHouses[h].mutex);
+    }
+}
+
+void* ghostThreadFunc(void* arg) {
+    Ghost* ghost = (Ghost*)arg;
+    char threadName[24];
+    snprintf(threadName, sizeof(threadName), "ghost %d", ghost->id);
+    setThreadName(threadName);
+    heartbeatRegister(threadName, ghost->baseIntervalMs);
+   
+    // The boost scheduler retunes this interval while the timer runs.
+    // The timer is joined before this thread returns.
+    TimerThreadArgs* timerArgs = &ghost->moveTimer;
+    snprintf(timerArgs->name, sizeof(timerArgs->name), "ghost %d timer", ghost->id);
+    timerArgs->semaphore = &ghost->moveSemaphore;
+    timerArgs->cpu = realtimeConfig.timerCpu;
+    timerArgs->fifoPriority = 0;
+    atomic_store(&timerArgs->intervalMs, ghost->baseIntervalMs);
+    atomic_store(&timerArgs->isRunning, true);
+    bool timerStarted = (pthread_create(&ghost->timerThread, NULL, ghostTimerThread, timerArgs) == 0);
+    
+    // Reset any speed boost at initialization
+    returnSpeedBoost(ghost);
+    
+    // Main ghost behavior loop
+    while (!simulationCancelled()) {
+        // Wait for timer signal; cancelSimulation() posts here to wake us at once
+        struct timespec waitTimeout;
+        clock_gettime(CLOCK_REALTIME, &waitTimeout);
+        waitTimeout.tv_sec += 2; // 2-second maximum wait as a safety
+        
+        int waitResult = sem_timedwait(&ghost->moveSemaphore, &waitTimeout);
+        heartbeat();
+        if (simulationCancelled()) {
+            break;
+        }
+        if (waitResult != 0) {
+            continue; 
+        }
+       
+        // Pick up a session reset on the first tick after it
+        ghost->sessionEpoch = atomic_load_explicit(&gameState.generation, memory_order_acquire);
+       
+        // Handle ghost respawn 
+        if (ghost->needsRespawn) {
+            LOG_INFO("Ghost %d respawning...", ghost->id);
+            
+            // Only the respawn cell is touched, so only its tile is locked
+            BoardCellLock cells = lockBoardCells(ghost->respawnRow, ghost->respawnCol,
+                                                 ghost->respawnRow, ghost->respawnCol);
+            if (ghostSessionChanged(ghost)) {
+                unlockBoardCells(cells); // the reset already put this ghost back
+                continue;
+            }
+            
+            // Set position to respawn coordinates
+            ghost->row = ghost->respawnRow;
+            ghost->col = ghost->respawnCol;
+            ghost->isVulnerable = false;
+            ghost->needsRespawn = false; // Clear respawn flag
+            ghost->inGhostHouse = true;  // Back in ghost house
+            
+            // Store what's at the respawn position and place ghost
+            ghost->cellContent = gameState.board[ghost->row][ghost->col];
+            gameState.board[ghost->row][ghost->col] = '#';
+            
+            LOG_INFO("Ghost %d respawned at [%d,%d]", ghost->id, ghost->row, ghost->col);
+            unlockBoardCells(cells);
+            
+            // Ghosts start without resources when respawning
+            releaseGhostHouseResources(ghost);
+            
+            // A respawned ghost loses its boost
+            returnSpeedBoost(ghost);
+            
+            // Add a small delay after respawn to prevent immediate movement
+            cancellableSleepMs(500, NULL);
+            
+            // Skip to next iteration
+            continue;
+        }
+       
+        // One lock-free snapshot of pacman and the run flags for this tick
+        bool isPlayScreen = false;
+        PacmanView view = loadPacmanView();
+       
+        if (view.valid && !view.gameRunning) {
+            break;
+        }
+        
+        struct timespec lockTimeout;
+        clock_gettime(CLOCK_REALTIME, &lockTimeout);
+        lockTimeout.tv_sec += 1; // 1-second timeout
+       
+        // Check UI state with timeout
+        if (MUTEX_TIMEDLOCK(uiState.mutex, &lockTimeout) != 0) {
+            LOG_WARN("Ghost %d skipped a turn: uiState.mutex busy for over 1 s", ghost->id);
+            continue;
+        }
+        isPlayScreen = (uiState.currentScreen == SCREEN_PLAY);
+        MUTEX_UNLOCK(uiState.mutex);
+       
+        // Only process ghost logic if in the play screen and not paused
+        if (!isPlayScreen || view.gamePaused) {
+            continue;
+        }
+            
+        // Try to acquire ghost house resources if needed. Another ghost's
+        // release can grant them, so the flags are only read under the house
+        // mutex, inside tryAcquireGhostHouseResources().
+        if (ghost->inGhostHouse) {
+            TraceSpan acquireSpan = traceBegin("tryAcquireGhostHouseResources");
+            bool acquired = tryAcquireGhostHouseResources(ghost);
+            traceEnd(acquireSpan);
+            if (!acquired) {
+                continue; // Still queued; the grant shows up on a later tick
+            }
+            // Successfully acquired resources
+            LOG_DEBUG("Ghost %d acquired house resources", ghost->id);
+        }
+           
+        // Update vulnerability state from the snapshot. The ghost's cell is
+        // locked because movePacman() and captureGameSnapshot() read the
+        // flags under the board locks.
+        BoardCellLock ghostCell = lockBoardCells(ghost->row, ghost->col, ghost->row, ghost->col);
+        ghost->isVulnerable = view.ghostVulnerable;
+        unlockBoardCells(ghostCell);
+           
+        // Skip if pacman position is invalid
+        if (!view.valid) {
+            continue;
+        }
+        
+        // Calculate movement direction with defensive error checking
+        TraceSpan weightsSpan = traceBegin("calculateDirectionWeights");
+        DirectionWeights weights = calculateDirectionWeights(ghost, view.row, view.col, view.direction);
+        traceEnd(weightsSpan);
+        bool validMoves[4];
+        int validCount = lockedGhostOpenMoves(ghost, validMoves);
+        Direction newDirection = chooseGhostDirection(validMoves, validCount, ghost, weights);
+           
+        // Move the ghost if we have a valid direction
+        if (newDirection != DIR_NONE) {
+            TraceSpan moveSpan = traceBegin("moveGhost");
+            moveGhost(ghost, newDirection);
+            traceEnd(moveSpan);
+        }
+    }
+   
+    // Clean up before exiting
+    releaseGhostHouseResources(ghost);
+    
+    returnSpeedBoost(ghost);
+   
+    // Stop and join the timer; the wake cuts its current interval short
+    atomic_store(&timerArgs->isRunning, false);
+    wakeSimulationSleepers();
+    if (timerStarted) {
+        pthread_join(ghost->timerThread, NULL);
+    }
+   
+    heartbeatUnregister();
+    return NULL;
+}
+
+void* ghostTimerThread(void* arg) {
+    runTimerLoop((TimerThreadArgs*)arg);
+    return NULL;
+}
+
+void initSimulationCancel() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&simulationCancel.mutex, NULL);
+    pthread_cond_init(&simulationCancel.cond, &attr);
+    pthread_condattr_destroy(&attr);
+    atomic_store(&simulationCancel.cancelled, false);
+}
+
+bool simulationCancelled() {
+    return atomic_load_explicit(&simulationCancel.cancelled, memory_order_acquire);
+}
+
+// Wakes every thread in cancellableSleepMs() so it re-checks its flags
+void wakeSimulationSleepers() {
+    pthread_mutex_lock(&simulationCancel.mutex);
+    pthread_cond_broadcast(&simulationCancel.cond);
+    pthread_mutex_unlock(&simulationCancel.mutex);
+}
+
+// Stops the engine, ghosts and their timers without waiting out any sleep:
+// sleepers are woken by the broadcast, semaphore waiters by an extra post
+// and the engine by its control eventfd.
+void cancelSimulation() {
+    atomic_store_explicit(&simulationCancel.cancelled, true, memory_order_release);
+    wakeSimulationSleepers();
+    if (engineControlFd >= 0) {
+        uint64_t one = 1;
+        if (write(engineControlFd, &one, sizeof(one)) != sizeof(one)) {
+            LOG_WARN("Could not signal the engine to stop: %s", strerror(errno));
+        }
+    }
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (ghosts[i].threadStarted) {
+            sem_post(&ghosts[i].moveSemaphore);
+        }
+    }
+}
+
+// Sleeps for ms unless the simulation is cancelled or *keepRunning (if given)
+// goes false first. Returns false when woken for either reason.
+static inline void timespecAddMs(struct timespec* ts, int ms) {
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+bool cancellableSleepMs(int ms, atomic_bool* keepRunning) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespecAddMs(&deadline, ms);
+    return cancellableSleepUntil(&deadline, keepRunning);
+}
+
+// Same, with an absolute CLOCK_MONOTONIC deadline
+bool cancellableSleepUntil(const struct timespec* deadline, atomic_bool* keepRunning) {
+    bool awake = true;
+    pthread_mutex_lock(&simulationCancel.mutex);
+    while (true) {
+        awake = !simulationCancelled() && (keepRunning == NULL || atomic_load(keepRunning));
+        if (!awake) {
+            break;
+        }
+        if (pthread_cond_timedwait(&simulationCancel.cond, &simulationCancel.mutex, deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&simulationCancel.mutex);
+    return awake;
+}
+
+// Bucket 0 is < 1us, bucket k covers [2^(k-1), 2^k) us, the last is open-ended
+static inline int latencyBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    if (us == 0) {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(us);
+    return bucket < LATENCY_HIST_BUCKETS ? bucket : LATENCY_HIST_BUCKETS - 1;
+}
+
+static void timerRecordLateness(TimerThreadArgs* args, const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t nowNs = timespecNs(&now);
+    uint64_t deadlineNs = timespecNs(deadline);
+    uint64_t lateNs = nowNs > deadlineNs ? nowNs - deadlineNs : 0;
+    args->wakeups++;
+    args->lateNsTotal += lateNs;
+    if (lateNs > args->lateNsMax) {
+        args->lateNsMax = lateNs;
+    }
+    args->lateHistogram[latencyBucket(lateNs)]++;
+}
+
+// Shared by the tick and ghost timers: fires every intervalMs on absolute
+// deadlines, so a late wake-up does not push every later tick back, and
+// records how late each wake-up was
+void runTimerLoop(TimerThreadArgs* args) {
+    setThreadName(args->name);
+    applyThreadPlacement(args->name, args->cpu, args->fifoPriority);
+    heartbeatRegister(args->name, atomic_load(&args->intervalMs));
+   
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (atomic_load(&args->isRunning)) {
+        // The interval is re-read every period so boosts take effect on the next move
+        int intervalMs = atomic_load(&args->intervalMs);
+        timespecAddMs(&next, intervalMs);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespecNs(&now) > timespecNs(&next) + (uint64_t)intervalMs * 1000000ull) {
+            next = now; // more than a period behind: resync instead of bursting
+        }
+        if (!cancellableSleepUntil(&next, &args->isRunning)) {
+            break;
+        }
+        timerRecordLateness(args, &next);
+        heartbeat();
+        sem_post(args->semaphore);
+    }
+   
+    heartbeatUnregister();
+}
+
+void loadRealtimeConfig() {
+    const char* value;
+    if ((value = getenv("PACMAN_PIN_ENGINE")) != NULL) realtimeConfig.engineCpu = atoi(value);
+    if ((value = getenv("PACMAN_PIN_TIMERS")) != NULL) realtimeConfig.timerCpu = atoi(value);
+    if ((value = getenv("PACMAN_PIN_RENDER")) != NULL) realtimeConfig.renderCpu = atoi(value);
+    if ((value = getenv("PACMAN_TICK_FIFO")) != NULL) realtimeConfig.tickPriority = atoi(value);
+    if ((value = getenv("PACMAN_MLOCK")) != NULL) realtimeConfig.lockMemory = atoi(value) != 0;
+}
+
+// Pins and/or raises the calling thread. Failures (no CAP_SYS_NICE, no such
+// CPU) are logged and the thread carries on with default scheduling.
+void applyThreadPlacement(const char* who, int cpu, int fifoPriority) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            LOG_WARN("Could not pin %s to CPU %d: %s", who, cpu, strerror(err));
+        } else {
+            LOG_INFO("Pinned %s to CPU %d", who, cpu);
+        }
+    }
+    if (fifoPriority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = fifoPriority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            LOG_WARN("Could not give %s SCHED_FIFO %d: %s", who, fifoPriority, strerror(err));
+        } else {
+            LOG_INFO("%s runs SCHED_FIFO at priority %d", who, fifoPriority);
+        }
+    }
+}
+
+// Keeps the state the tick path touches resident, so a tick never waits on
+// a page fault. The textures and fonts are left pageable.
+void lockSimulationMemory() {
+    if (!realtimeConfig.lockMemory) {
+        return;
+    }
+    struct { const void* address; size_t size; } regions[] = {
+        { &gameState, sizeof(gameState) },
+        { ghosts, sizeof(ghosts) },
+        { ghostHouses, sizeof(ghostHouses) },
+        { &sessionTemplate, sizeof(sessionTemplate) },
+        { &gameTickTimer, sizeof(gameTickTimer) },
+        { heartbeats, sizeof(heartbeats) },
+        { boardTiles.locks, sizeof(pthread_mutex_t) * boardTiles.tileCount },
+    };
+    size_t locked = 0;
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++) {
+        if (regions[i].size == 0) {
+            continue;
+        }
+        if (mlock(regions[i].address, regions[i].size) != 0) {
+            LOG_WARN("mlock of %zu bytes failed: %s", regions[i].size, strerror(errno));
+        } else {
+            locked += regions[i].size;
+        }
+    }
+    LOG_INFO("Locked %zu bytes of simulation state in memory", locked);
+}
+
+static uint64_t latencyPercentileUs(const uint64_t* histogram, uint64_t total, double percentile) {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)ceil(total * percentile);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen >= target) {
+            return 1ull << i;
+        }
+    }
+    return 1ull << (LATENCY_HIST_BUCKETS - 1);
+}
+
+static void printTimerLatency(const TimerThreadArgs* args) {
+    printf("%-14s %8llu %9.1f %8llu %8llu %9.1f\n", args->name,
+           (unsigned long long)args->wakeups,
+           args->wakeups ? args->lateNsTotal / 1e3 / args->wakeups : 0.0,
+           (unsigned long long)latencyPercentileUs(args->lateHistogram, args->wakeups, 0.50),
+           (unsigned long long)latencyPercentileUs(args->lateHistogram, args->wakeups, 0.99),
+           args->lateNsMax / 1e3);
+}
+
+// Call after the timers are joined
+void printSchedLatencyReport() {
+    char engineCpu[8], timerCpu[8], renderCpu[8];
+    snprintf(engineCpu, sizeof(engineCpu), realtimeConfig.engineCpu >= 0 ? "%d" : "any", realtimeConfig.engineCpu);
+    snprintf(timerCpu, sizeof(timerCpu), realtimeConfig.timerCpu >= 0 ? "%d" : "any", realtimeConfig.timerCpu);
+    snprintf(renderCpu, sizeof(renderCpu), realtimeConfig.renderCpu >= 0 ? "%d" : "any", realtimeConfig.renderCpu);
+    printf("\n=== Timer wake-up latency ===\n");
+    printf("engine cpu %s, timers cpu %s, render cpu %s, tick SCHED_FIFO %d, mlock %s\n",
+           engineCpu, timerCpu, renderCpu, realtimeConfig.tickPriority,
+           realtimeConfig.lockMemory ? "on" : "off");
+    printf("%-14s %8s %9s %8s %8s %9s\n", "timer", "wakeups", "avg us", "p50 us", "p99 us", "max us");
+    printTimerLatency(&gameTickTimer);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        printTimerLatency(&ghosts[i].moveTimer);
+    }
+}
+
+void startGhostThreads() {
+    // FIXED: Initialize ghost house resources if not already done
+    initGhostHouseResources();
+    
+    // Verify ghost house state is valid before starting threads
+    verifyGhostHouseState();
+    
+    // Make sure all ghosts are properly reset
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        resetGhost(&ghosts[i]);
+    }
+   
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        sem_init(&ghosts[i].moveSemaphore, 0, 0);
+        ghosts[i].threadStarted = (pthread_create(&ghosts[i].thread, NULL, ghostThreadFunc, &ghosts[i]) == 0);
+        if (!ghosts[i].threadStarted) {
+            LOG_ERROR("Error creating ghost thread %d", i);
+        } else {
+            LOG_INFO("Ghost thread %d started", i);
+        }
+    }
+}
+
+
+// Returns promptly: cancellation wakes every ghost and timer, then each
+// ghost is joined (and joins its own timer) before its semaphore goes away.
+void stopGhostThreads() {
+    cancelSimulation();
+   
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (ghosts[i].threadStarted) {
+            pthread_join(ghosts[i].thread, NULL);
+            ghosts[i].threadStarted = false;
+        }
+        sem_destroy(&ghosts[i].moveSemaphore);
+    }
+}
+
+// Writes value with thousands separators, e.g. 2000000 -> "2,000,000"
+void formatWithCommas(uint64_t value, char* out, size_t outSize) {
+    char digits[32];
+    int len = snprintf(digits, sizeof(digits), "%llu", (unsigned long long)value);
+    size_t pos = 0;
+    for (int i = 0; i < len && pos + 1 < outSize; i++) {
+        if (i > 0 && (len - i) % 3 == 0 && pos + 2 < outSize) {
+            out[pos++] = ',';
+        }
+        out[pos++] = digits[i];
+    }
+    out[pos] = '\0';
+}
+
+void renderGameOver(sfRenderWindow* window, sfFont* font) {
+    // Record each session's score once, however many frames this screen shows
+    static unsigned int scoredGeneration = 0;
+    unsigned int generation = atomic_load(&gameState.generation);
+    if (scoredGeneration != generation) {
+        MUTEX_LOCK(uiState.mutex);
+        addScore(uiState.username, gameState.score);
+        MUTEX_UNLOCK(uiState.mutex);
+        scoredGeneration = generation;
+    }
+
+    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
+   
+    sfText* titleText = sfText_create();
+    sfText_setFont(titleText, font);
+    sfText_setString(titleText, "GAME OVER");
+    sfText_setCharacterSize(titleText, 72);
+    sfText_setFillColor(titleText, sfRed);
+   
+    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
+    sfText_setPosition(titleText, (sfVector2f){
+        (WINDOW_WIDTH - titleBounds.width) / 2,
+        WINDOW_HEIGHT * 0.3f
+    });
+   
+    sfRenderWindow_drawText(window, titleText, NULL);
+   
+    char scoreStr[50];
+    MUTEX_LOCK(gameState.mutex);
+    sprintf(scoreStr, "Final Score: %d", gameState.score);
+    MUTEX_UNLOCK(gameState.mutex);
+   
+    sfText* scoreText = sfText_create();
+    sfText_setFont(scoreText, font);
+    sfText_setString(scoreText, scoreStr);
+    sfText_setCharacterSize(scoreText, 36);
+    sfText_setFillColor(scoreText, sfWhite);
+   
+    sfFloatRect scoreBounds = sfText_getLocalBounds(scoreText);
+    sfText_setPosition(scoreText, (sfVector2f){
+        (WINDOW_WIDTH - scoreBounds.width) / 2,
+        WINDOW_HEIGHT * 0.5f
+    });
+   
+    sfRenderWindow_drawText(window, scoreText, NULL);
+   
+    char rankStr[160];
+    char rankNum[32];
+    char totalNum[32];
+    char nearbyNum[32];
+    formatWithCommas(lastScoreRank, rankNum, sizeof(rankNum));
+    formatWithCommas(lastScoreTotal, totalNum, sizeof(totalNum));
+    formatWithCommas(lastScoreNearby, nearbyNum, sizeof(nearbyNum));
+    snprintf(rankStr, sizeof(rankStr), "Your rank: %s of %s (%s within %d points)", rankNum, totalNum,
+             nearbyNum, SCORE_NEARBY_POINTS);
+   
+    sfText* rankText = sfText_create();
+    sfText_setFont(rankText, font);
+    sfText_setString(rankText, rankStr);
+    sfText_setCharacterSize(rankText, 28);
+    sfText_setFillColor(rankText, sfYellow);
+   
+    sfFloatRect rankBounds = sfText_getLocalBounds(rankText);
+    sfText_setPosition(rankText, (sfVector2f){
+        (WINDOW_WIDTH - rankBounds.width) / 2,
+        WINDOW_HEIGHT * 0.6f
+    });
+   
+    if (lastScoreTotal > 0) {
+        sfRenderWindow_drawText(window, rankText, NULL);
+    }
+   
+    sfText* instructionsText = sfText_create();
+    sfText_setFont(instructionsText, font);
+    sfText_setString(instructionsText, "Press ESC to return to menu");
+    sfText_setCharacterSize(instructionsText, 24);
+    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
+   
+    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
+    sfText_setPosition(instructionsText, (sfVector2f){
+        (WINDOW_WIDTH - instrBounds.width) / 2,
+        WINDOW_HEIGHT * 0.7f
+    });
+   
+    sfRenderWindow_drawText(window, instructionsText, NULL);
+   
+    sfText_destroy(titleText);
+    sfText_destroy(scoreText);
+    sfText_destroy(rankText);
+    sfText_destroy(instructionsText);
+    sfRenderWindow_display(window);
+}
+
+void addInputEvent(int eventType, int data) {
+    MUTEX_LOCK(eventQueueMutex);
+    if ((eventQueueTail + 1) % MAX_INPUT_EVENTS != eventQueueHead) {
+        inputEventQueue[eventQueueTail].eventType = eventType;
+        inputEventQueue[eventQueueTail].data = data;
+        inputEventQueue[eventQueueTail].processed = false;
+        eventQueueTail = (eventQueueTail + 1) % MAX_INPUT_EVENTS;
+    }
+    MUTEX_UNLOCK(eventQueueMutex);
+   
+    // Wake the engine so the event is applied now rather than on the next tick
+    if (engineInputFd >= 0) {
+        uint64_t one = 1;
+        if (write(engineInputFd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN) {
+            LOG_WARN("Could not wake the engine for input: %s", strerror(errno));
+        }
+    }
+}
+
+bool getNextInputEvent(InputEvent* event) {
+    bool hasEvent = false;
+    MUTEX_LOCK(eventQueueMutex);
+    if (eventQueueHead != eventQueueTail) {
+        *event = inputEventQueue[eventQueueHead];
+        inputEventQueue[eventQueueHead].processed = true;
+        eventQueueHead = (eventQueueHead + 1) % MAX_INPUT_EVENTS;
+        hasEvent = true;
+    }
+    MUTEX_UNLOCK(eventQueueMutex);
+    return hasEvent;
+}
+
+void initUIState() {
+    uiState.currentScreen = SCREEN_MENU;
+    uiState.selectedMenuItem = 0;
+    uiState.needsRedraw = true;
+    strcpy(uiState.username, "Unknown");
+    uiState.enteringUsername = false;
+    uiState.usernameCursorPos = 0;
+    pthread_mutex_init(&uiState.mutex, NULL);
+}
+
+// One-time setup; later sessions go through resetSession()
+void initGameState() {
+    pthread_mutex_init(&gameState.mutex, NULL);
+    atomic_store(&gameState.generation, 0);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        ghosts[i].rngSeed = i + 1;
+    }
+    buildSessionTemplate();
+    resetSession();
+}
+
+void buildSessionTemplate() {
+    fillSessionTemplate(&sessionTemplate, initialBoard);
+}
+
+void fillSessionTemplate(SessionTemplate* layout, const char board[ROWS][COLS]) {
+    memcpy(layout->board, board, sizeof(layout->board));
+    memset(layout->powerPelletLocations, 0, sizeof(layout->powerPelletLocations));
+    layout->pelletCount = 0;
+    layout->powerPelletCount = 0;
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            char cell = layout->board[i][j];
+            if (cell == '@') {
+                layout->pacmanStartRow = i;
+                layout->pacmanStartCol = j;
+            }
+            layout->pelletCount += cell == '.';
+            layout->powerPelletCount += cell == '0';
+            layout->originalBoard[i][j] = (cell != '#' && cell != '@') ? cell : ' ';
+        }
+    }
+    buildNeighborTable(layout->neighbors, board);
+}
+
+// Level n's ghost interval: LEVEL_GHOST_SPEEDUP percent shorter per level
+static int levelGhostIntervalMs(int baseIntervalMs, int level) {
+    int intervalMs = baseIntervalMs;
+    for (int l = 1; l < level; l++) {
+        intervalMs = intervalMs * (100 - LEVEL_GHOST_SPEEDUP) / 100;
+    }
+    return intervalMs > LEVEL_MIN_GHOST_INTERVAL_MS ? intervalMs : LEVEL_MIN_GHOST_INTERVAL_MS;
+}
+
+// Puts layout on the board as level number level: pacman and the ghosts back
+// at their starts, timers cleared, score and lives untouched. Caller holds
+// gameState.mutex and the whole board and has handed back house resources
+// and boosts.
+static void startLevelLocked(const SessionTemplate* layout, int level) {
+    memcpy(gameState.board, layout->board, sizeof(gameState.board));
+    memcpy(gameState.originalBoard, layout->originalBoard, sizeof(gameState.originalBoard));
+    memcpy(gameState.powerPelletLocations, layout->powerPelletLocations,
+           sizeof(gameState.powerPelletLocations));
+    memcpy(gameState.neighbors, layout->neighbors, sizeof(gameState.neighbors));
+    gameState.level = level;
+    gameState.pelletsLeft = layout->pelletCount;
+    gameState.powerPelletsLeft = layout->powerPelletCount;
+
+    gameState.powerPelletActive = false;
+    gameState.powerPelletDuration = 0.0f;
+    gameState.ghostVulnerable = false;
+    gameState.ghostVulnerableDuration = 0.0f;
+    gameState.pacmanRotation = 0.0f;
+    gameState.currentDirection = DIR_NONE;
+    gameState.pacmanStartRow = layout->pacmanStartRow;
+    gameState.pacmanStartCol = layout->pacmanStartCol;
+    gameState.pacmanRow = layout->pacmanStartRow;
+    gameState.pacmanCol = layout->pacmanStartCol;
+
+    resetGhostSlots(ghosts, gameState.board);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        ghosts[i].baseIntervalMs = levelGhostIntervalMs(ghosts[i].baseIntervalMs, level);
+        atomic_store(&ghosts[i].moveTimer.intervalMs, ghosts[i].baseIntervalMs);
+    }
+    atomic_fetch_add_explicit(&gameState.generation, 1, memory_order_release);
+    publishPacmanView();
+}
+
+// Recounts what is left to eat after the board was replaced wholesale
+// (rewind, load). Pellets under ghosts and a power pellet under pacman count.
+// Caller holds gameState.mutex and the whole board.
+static void recountPelletsLocked() {
+    gameState.pelletsLeft = 0;
+    gameState.powerPelletsLeft = 0;
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            gameState.pelletsLeft += gameState.board[row][col] == '.';
+            gameState.powerPelletsLeft += gameState.board[row][col] == '0';
+        }
+    }
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        if (ghost->row >= 0 && ghost->row < ROWS && ghost->col >= 0 && ghost->col < COLS &&
+            gameState.board[ghost->row][ghost->col] == '#') {
+            gameState.pelletsLeft += ghost->cellContent == '.';
+            gameState.powerPelletsLeft += ghost->cellContent == '0';
+        }
+    }
+    gameState.powerPelletsLeft += gameState.powerPelletLocations[gameState.pacmanRow][gameState.pacmanCol];
+}
+
+// Starts a new session in place: no thread is recreated and no mutex is
+// re-initialised. Everything changes under gameState.mutex and every board
+// tile, together with a generation bump, so a ghost that planned a move in
+// the old session sees the new generation under its tile lock and drops it.
+void resetSession() {
+    // Return anything the previous session still held before wiping the flags
+    initGhostHouseResources();
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        releaseGhostHouseResources(&ghosts[i]);
+        returnSpeedBoost(&ghosts[i]);
+    }
+   
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    gameState.score = 0;
+    gameState.lives = 3;
+    gameState.gameRunning = true;
+    gameState.gamePaused = false;
+    startLevelLocked(&sessionTemplate, 1);
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+    LOG_INFO("Session %u started", atomic_load(&gameState.generation));
+}
+
+// Called by the engine once the last pellet is eaten. The next maze is
+// carved into static buffers before any lock is taken; the switch itself is
+// a resetSession() that keeps score and lives, so threads, timers and
+// buffers carry over and nothing is allocated.
+void loadNextLevel() {
+    MUTEX_LOCK(gameState.mutex);
+    int level = gameState.level < LEVEL_MAX ? gameState.level + 1 : LEVEL_MAX;
+    MUTEX_UNLOCK(gameState.mutex);
+
+    GeneratedMaze maze;
+    if (!mazeCarve(&maze, levelMazeCells, levelMazeStack, ROWS, COLS, GHOST_HOUSE_ROW, GHOST_HOUSE_COL,
+                   MAZE_OPENNESS, LEVEL_SEED + level)) {
+        LOG_ERROR("Could not build level %d; replaying the first maze", level);
+        memcpy(levelTemplate.board, sessionTemplate.board, sizeof(levelTemplate.board));
+    } else {
+        memcpy(levelTemplate.board, levelMazeCells, sizeof(levelTemplate.board));
+    }
+    fillSessionTemplate(&levelTemplate, levelTemplate.board);
+
+    initGhostHouseResources();
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        releaseGhostHouseResources(&ghosts[i]);
+        returnSpeedBoost(&ghosts[i]);
+    }
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    startLevelLocked(&levelTemplate, level);
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+    LOG_INFO("Level %d: %d pellets, ghosts every %d-%d ms", level, levelTemplate.pelletCount,
+             ghosts[0].baseIntervalMs, ghosts[MAX_GHOSTS - 1].baseIntervalMs);
+}
+
+// True if a reset happened since the ghost's thread last looked. Exact when
+// called with any board tile (or gameState.mutex) held, since resets hold all.
+bool ghostSessionChanged(Ghost* ghost) {
+    return atomic_load_explicit(&gameState.generation, memory_order_acquire) != ghost->sessionEpoch;
+}
+
+bool isInGhostHouse(int row, int col) {
+    // Define the ghost house area
+    return row >= GHOST_HOUSE_ROW && row < GHOST_HOUSE_ROW + MAZE_HOUSE_ROWS &&
+           col >= GHOST_HOUSE_COL && col < GHOST_HOUSE_COL + MAZE_HOUSE_COLS;
+}
+
+// Add to your gameState struct definition (typically in a header file):
+// bool powerPelletLocations[ROWS][COLS]; // Tracks positions of power pellets
+
+// Add this to your game initialization function:
+void initializePowerPelletLocations() {
+    MUTEX_LOCK(gameState.mutex);
+    // Initialize all to false
+    memset(gameState.powerPelletLocations, 0, sizeof(gameState.powerPelletLocations));
+    
+    // Mark power pellet locations from the board
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            if (gameState.board[row][col] == '0') {
+                gameState.powerPelletLocations[row][col] = true;
+            }
+        }
+    }
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+// A life lost: pacman at row,col goes back to his start, the game ends on
+// the last one. Called with gameState.mutex and the whole board held.
+void pacmanCaughtLocked(int row, int col) {
+    gameState.lives--;
+    gameState.currentDirection = DIR_NONE;
+    if (gameState.lives <= 0) {
+        MUTEX_LOCK(uiState.mutex);
+        uiState.currentScreen = SCREEN_GAME_OVER;
+        uiState.needsRedraw = true;
+        MUTEX_UNLOCK(uiState.mutex);
+    }
+    handlePacmanLeaving(row, col);
+    gameState.pacmanRow = gameState.pacmanStartRow;
+    gameState.pacmanCol = gameState.pacmanStartCol;
+    gameState.board[gameState.pacmanRow][gameState.pacmanCol] = '@';
+    publishPacmanView();
+}
+
+// moveGhost() found pacman on its target cell. gameState.mutex ranks above
+// the board locks, so the caller dropped those first and the meeting is
+// checked again here: pacman may have moved on or the level been reset.
+void ghostCatchesPacman(Ghost* ghost, int row, int col) {
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    if (!ghostSessionChanged(ghost) && gameState.lives > 0 &&
+        gameState.pacmanRow == row && gameState.pacmanCol == col &&
+        ghostMeetsPacman(ghost) == MEET_PACMAN_CAUGHT) {
+        pacmanCaughtLocked(row, col);
+    }
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+void movePacman() {
+    MUTEX_LOCK(gameState.mutex);
+    int oldRow = gameState.pacmanRow;
+    int oldCol = gameState.pacmanCol;
+    int next = cellNeighbor(gameState.neighbors, oldRow, oldCol, gameState.currentDirection);
+    if (next < 0) {
+        MUTEX_UNLOCK(gameState.mutex);
+        return;
+    }
+    int newRow = next / COLS;
+    int newCol = next % COLS;
+    BoardCellLock cells = lockBoardTiles(oldRow, oldCol, newRow, newCol);
+    // Telling which ghost is on the target reads every ghost's position,
+    // written under that ghost's own cells, so meeting one takes the whole
+    // board. The cell is read again below once it is held.
+    bool wholeBoard = false;
+    if (gameState.board[newRow][newCol] == '#') {
+        unlockBoardCells(cells);
+        lockWholeBoard();
+        wholeBoard = true;
+    }
+    if (gameState.board[newRow][newCol] == '=' || isInGhostHouse(newRow, newCol)) {
+        if (wholeBoard) unlockWholeBoard(); else unlockBoardCells(cells);
+        MUTEX_UNLOCK(gameState.mutex);
+        return;
+    }
+    char cellContent = gameState.board[newRow][newCol];
+    bool preservePowerPellet = false;
+    if (cellContent == '.') {
+        gameState.score += 10;
+        gameState.pelletsLeft--;
+    }
+    else if (cellContent == '0') {
+        if (gameState.ghostVulnerable) {
+            preservePowerPellet = true;
+            LOG_DEBUG("Ghost already vulnerable, preserving power pellet");
+        } else {
+            gameState.score += 50;
+            gameState.powerPelletsLeft--;
+            gameState.powerPelletLocations[newRow][newCol] = false; // eaten for good
+            gameState.powerPelletActive = true;
+            gameState.ghostVulnerable = true;
+            gameState.powerPelletDuration = 0.0f;
+            gameState.ghostVulnerableDuration = 0.0f;
+        }
+    }
+    else if (cellContent == '#') {
+        Ghost* ghostHere = NULL;
+        for (int g = 0; g < MAX_GHOSTS; g++) {
+            if (ghosts[g].row == newRow && ghosts[g].col == newCol) {
+                ghostHere = &ghosts[g];
+                break;
+            }
+        }
+        if (ghostMeetsPacman(ghostHere) == MEET_GHOST_EATEN) {
+            gameState.score += 200;
+            // Whatever the ghost stood on is pacman's now; it would
+            // otherwise vanish when the ghost moves off a cell showing '@'
+            if (ghostHere->cellContent == '.') {
+                gameState.score += 10;
+                gameState.pelletsLeft--;
+            } else if (ghostHere->cellContent == '0') {
+                preservePowerPellet = true;
+            }
+            ghostHere->cellContent = ' ';
+        } else {
+            // The whole board is held, start cell included
+            pacmanCaughtLocked(oldRow, oldCol);
+            unlockWholeBoard();
+            MUTEX_UNLOCK(gameState.mutex);
+            return;
+        }
+    }
+    
+    // Always clear Pacman's old position
+    // Use the helper function to properly handle power pellet locations
+    handlePacmanLeaving(oldRow, oldCol);
+    
+    // Update Pacman's new position
+    gameState.pacmanRow = newRow;
+    gameState.pacmanCol = newCol;
+    
+    // Update Pacman's new position
+    gameState.pacmanRow = newRow;
+    gameState.pacmanCol = newCol;
+    
+    // If we want to preserve the power pellet, remember it's still there
+    if (preservePowerPellet) {
+        gameState.board[newRow][newCol] = '@';
+        gameState.powerPelletLocations[newRow][newCol] = true;  // Mark that a power pellet is at this location
+    } else {
+        gameState.board[newRow][newCol] = '@';
+    }
+    
+    publishPacmanView();
+    if (wholeBoard) unlockWholeBoard(); else unlockBoardCells(cells);
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+
+void renderMenu(sfRenderWindow* window, sfFont* font) {
+    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
+   
+    sfText* titleText = sfText_create();
+    sfText_setFont(titleText, font);
+    sfText_setString(titleText, "PACMAN");
+    sfText_setCharacterSize(titleText, 72);
+    sfText_setFillColor(titleText, sfYellow);
+   
+    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
+    sfText_setPosition(titleText, (sfVector2f){
+        (WINDOW_WIDTH - titleBounds.width) / 2,
+        WINDOW_HEIGHT * 0.2f
+    });
+   
+    sfRenderWindow_drawText(window, titleText, NULL);
+
+    MUTEX_LOCK(uiState.mutex);
+    char usernameLabel[64];
+    sprintf(usernameLabel, "Player: %s", uiState.username);
+    bool enteringUsername = uiState.enteringUsername;
+    int selectedItem = uiState.selectedMenuItem;
+    MUTEX_UNLOCK(uiState.mutex);
+
+    sfText* usernameText = sfText_create();
+    sfText_setFont(usernameText, font);
+    sfText_setString(usernameText, usernameLabel);
+    sfText_setCharacterSize(usernameText, 28);
+    sfText_setFillColor(usernameText, enteringUsername ? sfYellow : sfWhite);
+   
+    sfFloatRect usernameBounds = sfText_getLocalBounds(usernameText);
+    sfText_setPosition(usernameText, (sfVector2f){
+        (WINDOW_WIDTH - usernameBounds.width) / 2,
+        WINDOW_HEIGHT * 0.35f
+    });
+   
+    sfRenderWindow_drawText(window, usernameText, NULL);
+    sfText_destroy(usernameText);
+
+    for (int i = 0; i < MENU_ITEM_COUNT; i++) {
+        sfText* menuItemText = sfText_create();
+        sfText_setFont(menuItemText, font);
+        sfText_setString(menuItemText, menuItems[i]);
+        sfText_setCharacterSize(menuItemText, 36);
+       
+        if (i == selectedItem) {
+            sfText_setFillColor(menuItemText, sfYellow);
+            char selectedText[50];
+            sprintf(selectedText, "> %s", menuItems[i]);
+            sfText_setString(menuItemText, selectedText);
+        } else {
+            sfText_setFillColor(menuItemText, sfWhite);
+        }
+       
+        sfFloatRect itemBounds = sfText_getLocalBounds(menuItemText);
+        sfText_setPosition(menuItemText, (sfVector2f){
+            (WINDOW_WIDTH - itemBounds.width) / 2,
+            WINDOW_HEIGHT * 0.4f + i * 60
+        });
+       
+        sfRenderWindow_drawText(window, menuItemText, NULL);
+        sfText_destroy(menuItemText);
+    }
+   
+    sfText* instructionsText = sfText_create();
+    sfText_setFont(instructionsText, font);
+    sfText_setString(instructionsText,
+        "Press U to set username | UP/DOWN to navigate | ENTER to select");
+    sfText_setCharacterSize(instructionsText, 20);
+    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
+   
+    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
+    sfText_setPosition(instructionsText, (sfVector2f){
+        (WINDOW_WIDTH - instrBounds.width) / 2,
+        WINDOW_HEIGHT * 0.85f
+    });
+   
+    sfRenderWindow_drawText(window, instructionsText, NULL);
+   
+    sfText_destroy(titleText);
+    sfText_destroy(instructionsText);
+    sfRenderWindow_display(window);
+}
+
+void renderScoreboard(sfRenderWindow* window, sfFont* font) {
+    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
+   
+    sfText* titleText = sfText_create();
+    sfText_setFont(titleText, font);
+    sfText_setString(titleText, "SCOREBOARD");
+    sfText_setCharacterSize(titleText, 48);
+    sfText_setFillColor(titleText, sfYellow);
+   
+    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
+    sfText_setPosition(titleText, (sfVector2f){
+        (WINDOW_WIDTH - titleBounds.width) / 2,
+        WINDOW_HEIGHT * 0.2f
+    });
+   
+    sfRenderWindow_drawText(window, titleText, NULL);
+   
+    for (int i = 0; i < scoreCount; i++) {
+        char scoreLine[64];
+        sprintf(scoreLine, "%d. %s - %d", i + 1, scoreBoard[i].username, scoreBoard[i].score);
+       
+        sfText* scoreText = sfText_create();
+        sfText_setFont(scoreText, font);
+        sfText_setString(scoreText, scoreLine);
+        sfText_setCharacterSize(scoreText, 24);
+        sfText_setFillColor(scoreText, sfWhite);
+       
+        sfFloatRect scoreBounds = sfText_getLocalBounds(scoreText);
+        sfText_setPosition(scoreText, (sfVector2f){
+            (WINDOW_WIDTH - scoreBounds.width) / 2,
+            WINDOW_HEIGHT * 0.3f + i * 30
+        });
+       
+        sfRenderWindow_drawText(window, scoreText, NULL);
+        sfText_destroy(scoreText);
+    }
+   
+    sfText* instructionsText = sfText_create();
+    sfText_setFont(instructionsText, font);
+    sfText_setString(instructionsText, "Press ESC to return to menu");
+    sfText_setCharacterSize(instructionsText, 20);
+    sfText_setFillColor(instructionsText, sfColor_fromRGB(180, 180, 180));
+   
+    sfFloatRect instrBounds = sfText_getLocalBounds(instructionsText);
+    sfText_setPosition(instructionsText, (sfVector2f){
+        (WINDOW_WIDTH - instrBounds.width) / 2,
+        WINDOW_HEIGHT * 0.85f
+    });
+   
+    sfRenderWindow_drawText(window, instructionsText, NULL);
+   
+    sfText_destroy(titleText);
+    sfText_destroy(instructionsText);
+    sfRenderWindow_display(window);
+}
+
+void renderInstructions(sfRenderWindow* window, sfFont* font) {
+    sfRenderWindow_clear(window, sfColor_fromRGB(0, 0, 60));
+   
+    sfText* titleText = sfText_create();
+    sfText_setFont(titleText, font);
+    sfText_setString(titleText, "INSTRUCTIONS");
+    sfText_setCharacterSize(titleText, 48);
+    sfText_setFillColor(titleText, sfYellow);
+   
+    sfFloatRect titleBounds = sfText_getLocalBounds(titleText);
+    sfText_setPosition(titleText, (sfVector2f){
+        (WINDOW_WIDTH - titleBounds.width) / 2,
+        WINDOW_HEIGHT * 0.1f
+    });
+   
+    sfRenderWindow_drawText(window, titleText, NULL);
+   
+    const char* instructionsLines[] = {
+        "Use the WASD keys to control Pacman:",
+        "W - Move Up",
+        "A - Move Left",
+        "S - Move Down",
+        "D - Move Right",
+        "",
+        "Collect dots for 10 points each",
+        "Power pellets (large dots) worth 50 points",
+        "Eat ghosts for 200 points when powered up",
+        "",
+        "Press ESC to return to menu during gameplay"
+    };
+   
+    for (int i = 0; i < 11; i++) {
+        sfText* lineText = sfText_create();
+        sfText_setFont(lineText, font);
+        sfText_setString(lineText, instructionsLines[i]);
+        sfText_setCharacterSize(lineText, 24);
+        sfText_setFillColor(lineText, sfWhite);
+       
+        sfText_setPosition(lineText, (sfVector2f){
+            WINDOW_WIDTH * 0.15f,
+            WINDOW_HEIGHT * 0.25f + i * 35
+        });
+       
+        sfRenderWindow_drawText(window, lineText, NULL);
+        sfText_destroy(lineText);
+    }
+   
+    sfText* backText = sfText_create();
+    sfText_setFont(backText, font);
+    sfText_setString(backText, "Press ESC to return to menu");
+    sfText_setCharacterSize(backText, 20);
+    sfText_setFillColor(backText, sfColor_fromRGB(180, 180, 180));
+   
+    sfFloatRect backBounds = sfText_getLocalBounds(backText);
+    sfText_setPosition(backText, (sfVector2f){
+        (WINDOW_WIDTH - backBounds.width) / 2,
+        WINDOW_HEIGHT * 0.9f
+    });
+   
+    sfRenderWindow_drawText(window, backText, NULL);
+   
+    sfText_destroy(titleText);
+    sfText_destroy(backText);
+    sfRenderWindow_display(window);
+}
+
+void renderGame(sfRenderWindow* window, sfRectangleShape* wall, sfCircleShape* dot,
+               sfCircleShape* powerPellet, sfSprite* pacmanSprite, sfSprite* ghost1Sprite,
+               sfSprite* ghost2Sprite, sfSprite* ghost3Sprite, sfSprite* ghost4Sprite,
+               sfSprite* ghost5Sprite, sfText* scoreText, sfText* livesText,
+               sfSprite* lifeSprite)
+{
+    sfRenderWindow_clear(window, sfBlack);
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+   
+    for (int i = 0; i < ROWS; i++) {
+        for (int j = 0; j < COLS; j++) {
+            float x = j * CELL_SIZE;
+            float y = i * CELL_SIZE;
+           
+            switch(gameState.board[i][j]) {
+                case '=':
+                    sfRectangleShape_setPosition(wall, (sfVector2f){x, y});
+                    sfRenderWindow_drawRectangleShape(window, wall, NULL);
+                    break;
+                case '.':
+                    sfCircleShape_setPosition(dot, (sfVector2f){x + CELL_SIZE/2 - 3, y + CELL_SIZE/2 - 3});
+                    sfRenderWindow_drawCircleShape(window, dot, NULL);
+                    break;
+                case '0':
+                    if (pelletVisible) {
+                        sfCircleShape_setPosition(powerPellet, (sfVector2f){x + CELL_SIZE/2 - 13, y + CELL_SIZE/2 - 13});
+                        sfRenderWindow_drawCircleShape(window, powerPellet, NULL);
+                    }
+                    break;
+                case '@':
+                    sfSprite_setPosition(pacmanSprite, (sfVector2f){x + CELL_SIZE/2, y + CELL_SIZE/2});
+                    sfSprite_setRotation(pacmanSprite, gameState.pacmanRotation);
+                    sfRenderWindow_drawSprite(window, pacmanSprite, NULL);
+                    break;
+                case '#':
+                    for (int g = 0; g < MAX_GHOSTS; g++) {
+                        if (ghosts[g].row == i && ghosts[g].col == j) {
+                            sfSprite* currentGhostSprite;
+                           
+                            if (ghosts[g].isVulnerable) {
+                                currentGhostSprite = ghost5Sprite;
+                            } else {
+                                switch (ghosts[g].ghostType) {
+                                    case 1: currentGhostSprite = ghost1Sprite; break;
+                                    case 2: currentGhostSprite = ghost2Sprite; break;
+                                    case 3: currentGhostSprite = ghost3Sprite; break;
+                                    case 4: currentGhostSprite = ghost4Sprite; break;
+                                    default: currentGhostSprite = ghost1Sprite;
+                                }
+                            }
+                           
+                            sfSprite_setPosition(currentGhostSprite, (sfVector2f){x + CELL_SIZE/2, y + CELL_SIZE/2});
+                            sfRenderWindow_drawSprite(window, currentGhostSprite, NULL);
+                            break;
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+    unlockWholeBoard();
+   
+    char scoreStr[50];
+    sprintf(scoreStr, "Score: %d  Level %d", gameState.score, gameState.level);
+    sfText_setString(scoreText, scoreStr);
+    sfText_setPosition(scoreText, (sfVector2f){10 * CELL_SIZE + CELL_SIZE / 4.0, 19 * CELL_SIZE + CELL_SIZE / 4.0f});
+    sfRenderWindow_drawText(window, scoreText, NULL);
+   
+    float lifeY = 19 * CELL_SIZE + CELL_SIZE / 4.0f;
+    float lifeX = 7 * CELL_SIZE + CELL_SIZE / 4.0f;
+    for (int i = 0; i < gameState.lives; i++) {
+        sfSprite_setPosition(lifeSprite, (sfVector2f){lifeX - i * (CELL_SIZE / 2), lifeY});
+        sfRenderWindow_drawSprite(window, lifeSprite, NULL);
+    }
+   
+    MUTEX_UNLOCK(gameState.mutex);
+    sfRenderWindow_display(window);
+}
+
+void processInput(sfRenderWindow* window) {
+    sfEvent event;
+    while (sfRenderWindow_pollEvent(window, &event)) {
+        if (event.type == sfEvtClosed) {
+            MUTEX_LOCK(gameState.mutex);
+            gameState.gameRunning = false;
+            publishPacmanView();
+            MUTEX_UNLOCK(gameState.mutex);
+            sfRenderWindow_close(window);
+        }
+        else if (event.type == sfEvtKeyPressed) {
+            MUTEX_LOCK(uiState.mutex);
+            GameScreen currentScreen = uiState.currentScreen;
+            bool enteringUsername = uiState.enteringUsername;
+            MUTEX_UNLOCK(uiState.mutex);
+           
+            if (currentScreen == SCREEN_MENU) {
+                if (enteringUsername) {
+                    if (event.key.code == sfKeyEnter || event.key.code == sfKeyEscape) {
+                        MUTEX_LOCK(uiState.mutex);
+                        uiState.enteringUsername = false;
+                        uiState.needsRedraw = true;
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                    else if (event.key.code == sfKeyBackspace) {
+                        MUTEX_LOCK(uiState.mutex);
+                        if (uiState.usernameCursorPos > 0) {
+                            uiState.username[--uiState.usernameCursorPos] = '\0';
+                            uiState.needsRedraw = true;
+                        }
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                }
+                else {
+                    if (event.key.code == sfKeyU) {
+                        MUTEX_LOCK(uiState.mutex);
+                        uiState.enteringUsername = true;
+                        uiState.username[0] = '\0';
+                        uiState.usernameCursorPos = 0;
+                        uiState.needsRedraw = true;
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                    else if (event.key.code == sfKeyUp) {
+                        MUTEX_LOCK(uiState.mutex);
+                        uiState.selectedMenuItem = (uiState.selectedMenuItem - 1 + MENU_ITEM_COUNT) % MENU_ITEM_COUNT;
+                        uiState.needsRedraw = true;
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                    else if (event.key.code == sfKeyDown) {
+                        MUTEX_LOCK(uiState.mutex);
+                        uiState.selectedMenuItem = (uiState.selectedMenuItem + 1) % MENU_ITEM_COUNT;
+                        uiState.needsRedraw = true;
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                    else if (event.key.code == sfKeyReturn) {
+                        MUTEX_LOCK(uiState.mutex);
+                        uiState.needsRedraw = true;
+                       
+                        switch (uiState.selectedMenuItem) {
+                            case 0:
+                                uiState.currentScreen = SCREEN_PLAY;
+                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_PLAY);
+                                break;
+                            case 1:
+                                uiState.currentScreen = SCREEN_SCOREBOARD;
+                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_SCOREBOARD);
+                                break;
+                            case 2:
+                                uiState.currentScreen = SCREEN_INSTRUCTIONS;
+                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_INSTRUCTIONS);
+                                break;
+                            case 3:
+                                uiState.currentScreen = SCREEN_QUIT;
+                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_QUIT);
+                                gameState.gameRunning = false;
+                                // uiState.mutex is held here, so clear the bit
+                                // directly rather than take gameState.mutex
+                                atomic_fetch_and(&gameState.pacmanView, ~PACMAN_VIEW_RUNNING);
+                                break;
+                        }
+                        MUTEX_UNLOCK(uiState.mutex);
+                    }
+                }
+            }
+            else if (currentScreen == SCREEN_PLAY) {
+                if (event.key.code == sfKeyEscape) {
+                    MUTEX_LOCK(uiState.mutex);
+                    uiState.currentScreen = SCREEN_MENU;
+                    uiState.needsRedraw = true;
+                    MUTEX_UNLOCK(uiState.mutex);
+                    addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_MENU);
+                }
+                else if (event.key.code == sfKeyW || event.key.code == sfKeyUp) {
+                    MUTEX_LOCK(gameState.mutex);
+                    gameState.currentDirection = DIR_UP;
+                    gameState.pacmanRotation = 90.0f;
+                    publishPacmanView();
+                    MUTEX_UNLOCK(gameState.mutex);
+                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_UP);
+                }
+                else if (event.key.code == sfKeyS || event.key.code == sfKeyDown) {
+                    MUTEX_LOCK(gameState.mutex);
+                    gameState.currentDirection = DIR_DOWN;
+                    gameState.pacmanRotation = 270.0f;
+                    publishPacmanView();
+                    MUTEX_UNLOCK(gameState.mutex);
+                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_DOWN);
+                }
+                else if (event.key.code == sfKeyA || event.key.code == sfKeyLeft) {
+                    MUTEX_LOCK(gameState.mutex);
+                    gameState.currentDirection = DIR_LEFT;
+                    gameState.pacmanRotation = 0.0f;
+                    publishPacmanView();
+                    MUTEX_UNLOCK(gameState.mutex);
+                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_LEFT);
+                }
+                else if (event.key.code == sfKeyD || event.key.code == sfKeyRight) {
+                    MUTEX_LOCK(gameState.mutex);
+                    gameState.currentDirection = DIR_RIGHT;
+                    gameState.pacmanRotation = 180.0f;
+                    publishPacmanView();
+                    MUTEX_UNLOCK(gameState.mutex);
+                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_RIGHT);
+                }
+                else if (event.key.code == sfKeyP) {
+                    MUTEX_LOCK(gameState.mutex);
+                    gameState.gamePaused = !gameState.gamePaused;
+                    publishPacmanView();
+                    MUTEX_UNLOCK(gameState.mutex);
+                }
+                else if (event.key.code == sfKeyLBracket || event.key.code == sfKeyRBracket) {
+                    // Rewind one tick back or forward; the engine ignores it unless paused
+                    addInputEvent(EVENT_REWIND_STEP, event.key.code == sfKeyLBracket ? 1 : -1);
+                }
+                else if (event.key.code == sfKeyF5) {
+                    saveGame(saveFilePath);
+                }
+                else if (event.key.code == sfKeyF9) {
+                    loadGame(saveFilePath);
+                }
+                else if (event.key.code == sfKeyT) {
+                    // Dump the trace collected so far without stopping
+                    if (atomic_load(&tracingEnabled)) {
+                        traceDump(traceOutputPath);
+                    }
+                }
+            }
+            else if (currentScreen == SCREEN_SCOREBOARD || currentScreen == SCREEN_INSTRUCTIONS || currentScreen == SCREEN_GAME_OVER) {
+                if (event.key.code == sfKeyEscape) {
+                    MUTEX_LOCK(uiState.mutex);
+                    uiState.currentScreen = SCREEN_MENU;
+                    uiState.needsRedraw = true;
+                    MUTEX_UNLOCK(uiState.mutex);
+                    addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_MENU);
+                }
+            }
+        }
+        else if (event.type == sfEvtTextEntered) {
+            MUTEX_LOCK(uiState.mutex);
+            bool enteringUsername = uiState.enteringUsername;
+            MUTEX_UNLOCK(uiState.mutex);
+           
+            if (enteringUsername && event.text.unicode < 128 && event.text.unicode != '\r' && event.text.unicode != '\n') {
+                MUTEX_LOCK(uiState.mutex);
+                if (event.text.unicode == '\b') {
+                }
+                else if (uiState.usernameCursorPos < sizeof(uiState.username) - 1) {
+                    uiState.username[uiState.usernameCursorPos++] = (char)event.text.unicode;
+                    uiState.username[uiState.usernameCursorPos] = '\0';
+                    uiState.needsRedraw = true;
+                }
+                MUTEX_UNLOCK(uiState.mutex);
+            }
+        }
+    }
+}
+
+// Creates the engine's timerfd, eventfds and epoll set. Called before the
+// engine thread starts so input and cancellation can be signalled at once.
+bool initEngineEvents() {
+    engineEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    engineTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    engineInputFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    engineControlFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (engineEpollFd < 0 || engineTimerFd < 0 || engineInputFd < 0 || engineControlFd < 0) {
+        LOG_ERROR("Could not create engine event descriptors: %s", strerror(errno));
+        closeEngineEvents();
+        return false;
+    }
+   
+    int fds[] = { engineTimerFd, engineInputFd, engineControlFd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fds[i];
+        if (epoll_ctl(engineEpollFd, EPOLL_CTL_ADD, fds[i], &ev) != 0) {
+            LOG_ERROR("Could not add engine descriptor to epoll: %s", strerror(errno));
+            closeEngineEvents();
+            return false;
+        }
+    }
+    return true;
+}
+
+void closeEngineEvents() {
+    int* fds[] = { &engineEpollFd, &engineTimerFd, &engineInputFd, &engineControlFd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
+
+// Reads and resets an eventfd or timerfd counter; 0 if nothing was pending
+static uint64_t drainEngineFd(int fd) {
+    uint64_t count = 0;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+// Applies every queued input event. Runs as soon as the input eventfd fires,
+// so direction changes no longer wait for the next tick.
+static void processEngineInput() {
+    InputEvent event;
+    while (getNextInputEvent(&event)) {
+        if (event.eventType == EVENT_DIRECTION_CHANGE) {
+            // Update Pacman's direction and rotation
+            MUTEX_LOCK(gameState.mutex);
+            gameState.currentDirection = event.data;
+            switch(event.data) {
+                case DIR_UP: gameState.pacmanRotation = 270.0f; break;
+                case DIR_DOWN: gameState.pacmanRotation = 90.0f; break;
+                case DIR_LEFT: gameState.pacmanRotation = 180.0f; break;
+                case DIR_RIGHT: gameState.pacmanRotation = 0.0f; break;
+                default: break;
+            }
+            publishPacmanView();
+            MUTEX_UNLOCK(gameState.mutex);
+        }
+        else if (event.eventType == EVENT_SCREEN_CHANGE) {
+            // The keyboard has already switched the screen; other input
+            // sources only post the event, so it is applied here
+            MUTEX_LOCK(uiState.mutex);
+            uiState.currentScreen = event.data;
+            uiState.needsRedraw = true;
+            MUTEX_UNLOCK(uiState.mutex);
+            // Start a fresh session when entering play screen
+            if (event.data == SCREEN_PLAY) {
+                resetSession();
+            }
+        }
+        else if (event.eventType == EVENT_REWIND_STEP) {
+            rewindStep(event.data);
+        }
+    }
+}
+
+           
+void* gameEngineThreadFunc(void* arg) {
+    setThreadName("engine");
+
+    // Set up frame synchronization primitives
+    pthread_mutex_t frameMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t frameCond = PTHREAD_COND_INITIALIZER;
+
+    // The tick is a periodic timerfd owned by this thread; gameTickTimer only
+    // holds its interval and the lateness stats for the latency report
+    snprintf(gameTickTimer.name, sizeof(gameTickTimer.name), "engine tick");
+    gameTickTimer.semaphore = NULL;
+    gameTickTimer.cpu = realtimeConfig.engineCpu;
+    gameTickTimer.fifoPriority = realtimeConfig.tickPriority;
+    atomic_store(&gameTickTimer.intervalMs, 200);   // 200ms per game tick (5 ticks per second)
+    atomic_store(&gameTickTimer.isRunning, true);
+    applyThreadPlacement("engine", realtimeConfig.engineCpu, realtimeConfig.tickPriority);
+    int intervalMs = atomic_load(&gameTickTimer.intervalMs);
+    heartbeatRegister("engine", intervalMs);
+
+    // Absolute expiries, so the deadline of every tick is known for the stats
+    struct timespec nextTick;
+    clock_gettime(CLOCK_MONOTONIC, &nextTick);
+    timespecAddMs(&nextTick, intervalMs);
+    struct itimerspec tickSpec;
+    memset(&tickSpec, 0, sizeof(tickSpec));
+    tickSpec.it_value = nextTick;
+    tickSpec.it_interval.tv_sec = intervalMs / 1000;
+    tickSpec.it_interval.tv_nsec = (long)(intervalMs % 1000) * 1000000;
+    if (timerfd_settime(engineTimerFd, TFD_TIMER_ABSTIME, &tickSpec, NULL) != 0) {
+        LOG_ERROR("Could not arm the engine tick timer: %s", strerror(errno));
+    }
+
+    // Main game loop
+    while (!simulationCancelled()) {
+        struct epoll_event ready[4];
+        int readyCount = epoll_wait(engineEpollFd, ready, 4, -1);
+        if (readyCount < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Engine epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        heartbeat();
+       
+        bool stop = false;
+        bool inputPending = false;
+        uint64_t expirations = 0;
+        for (int i = 0; i < readyCount; i++) {
+            int fd = ready[i].data.fd;
+            if (fd == engineControlFd) {
+                drainEngineFd(fd);
+                stop = true;
+            } else if (fd == engineInputFd) {
+                drainEngineFd(fd);
+                inputPending = true;
+            } else if (fd == engineTimerFd) {
+                expirations = drainEngineFd(fd);
+            }
+        }
+        if (stop || simulationCancelled()) {
+            break;
+        }
+       
+        // Input first, so a key pressed just before a tick moves Pacman on it
+        if (inputPending) {
+            processEngineInput();
+        }
+        if (expirations == 0) {
+            continue;
+        }
+       
+        // Overrun ticks are dropped rather than replayed in a burst; lateness
+        // is measured against the most recent expiry
+        timespecAddMs(&nextTick, (int)(expirations - 1) * intervalMs);
+        timerRecordLateness(&gameTickTimer, &nextTick);
+        timespecAddMs(&nextTick, intervalMs);
+       
+        // Get current game state (safely)
+        MUTEX_LOCK(gameState.mutex);
+        bool gameRunning = gameState.gameRunning;
+        bool gamePaused = gameState.gamePaused;
+        float deltaTime = 0.2f;  // 200ms in seconds
+        MUTEX_UNLOCK(gameState.mutex);
+       
+        // Exit if game is no longer running
+        if (!gameRunning) {
+            break;
+        }
+       
+        // Check if we're in the play screen
+        MUTEX_LOCK(uiState.mutex);
+        bool isPlayScreen = (uiState.currentScreen == SCREEN_PLAY);
+        MUTEX_UNLOCK(uiState.mutex);
+       
+        // Update game logic if we're playing and not paused
+        if (isPlayScreen && !gamePaused) {
+            // Move Pacman according to current direction
+            TraceSpan moveSpan = traceBegin("movePacman");
+            movePacman();
+            traceEnd(moveSpan);
+
+            MUTEX_LOCK(gameState.mutex);
+            bool levelCleared = gameState.pelletsLeft <= 0 && gameState.powerPelletsLeft <= 0;
+            MUTEX_UNLOCK(gameState.mutex);
+            if (levelCleared) {
+                loadNextLevel();
+            }
+           
+            // Signal that a frame has been processed
+            pthread_mutex_lock(&frameMutex);
+            pthread_cond_broadcast(&frameCond);
+            pthread_mutex_unlock(&frameMutex);
+           
+            boostSchedulerTick();
+           
+            // Update power pellet and ghost vulnerability timers
+            MUTEX_LOCK(gameState.mutex);
+           
+            // Handle power pellet timeout
+            if (gameState.powerPelletActive) {
+                gameState.powerPelletDuration += deltaTime;
+                if (gameState.powerPelletDuration >= POWER_PELLET_MS / 1000.0f) {
+                    gameState.powerPelletActive = false;
+                    gameState.ghostVulnerable = false;
+                }
+            }
+           
+            // Handle ghost vulnerability timeout
+            if (gameState.ghostVulnerable) {
+                gameState.ghostVulnerableDuration += deltaTime;
+               
+                if (gameState.ghostVulnerableDuration >= GHOST_VULNERABLE_MS / 1000.0f) {
+                    gameState.ghostVulnerable = false;
+                }
+            }
+           
+            publishPacmanView();
+            MUTEX_UNLOCK(gameState.mutex);
+        }
+       
+        // Spectators get every tick, menus and pauses included; the rewind
+        // buffer only the ones that were played
+        GameSnapshot snapshot;
+        bool captured = false;
+        if (rewindBuffer.enabled && isPlayScreen && !gamePaused) {
+            rewindCapture(&snapshot);
+            captured = true;
+        }
+        if (spectatorRing != NULL) {
+            if (!captured) {
+                captureGameSnapshot(&snapshot);
+            }
+            spectatorPublish(&snapshot);
+        }
+    }
+
+    // Disarm the tick; the descriptors are closed by main after the join
+    struct itimerspec disarm;
+    memset(&disarm, 0, sizeof(disarm));
+    timerfd_settime(engineTimerFd, 0, &disarm, NULL);
+    atomic_store(&gameTickTimer.isRunning, false);
+
+    pthread_mutex_destroy(&frameMutex);
+    pthread_cond_destroy(&frameCond);
+
+    heartbeatUnregister();
+    return NULL;
+}
+
+double monotonicMs() {
+    return monotonicNs() / 1e6;
+}
+
+static void* imageDecodeThread(void* arg) {
+    ImageDecodeJob* job = (ImageDecodeJob*)arg;
+    job->image = sfImage_createFromFile(job->path);
+    return NULL;
+}
+
+// Decodes every image on its own thread. sfImage is plain CPU memory, so this
+// is safe off the main thread; only the texture upload needs the GL context.
+bool decodeImagesParallel(ImageDecodeJob* jobs, int count) {
+    pthread_t threads[ASSET_COUNT];
+    bool started[ASSET_COUNT] = {false};
+    for (int i = 0; i < count; i++) {
+        jobs[i].image = NULL;
+        started[i] = (pthread_create(&threads[i], NULL, imageDecodeThread, &jobs[i]) == 0);
+        if (!started[i]) {
+            imageDecodeThread(&jobs[i]);
+        }
+    }
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+        if (jobs[i].image == NULL) {
+            printf("Error decoding %s\n", jobs[i].path);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Stats assetFiles and FONT_FILE in header order. False if any is missing,
+// in which case a bundle cannot be checked against them.
+static bool statAssetSources(AssetSourceStat sources[ASSET_COUNT + 1]) {
+    for (int i = 0; i <= ASSET_COUNT; i++) {
+        struct stat st;
+        if (stat(i < ASSET_COUNT ? assetFiles[i] : FONT_FILE, &st) != 0) {
+            return false;
+        }
+        sources[i].size = (uint64_t)st.st_size;
+        sources[i].mtimeNs = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    return true;
+}
+
+// Offline packer: decodes all sprites into a single RGBA strip atlas and
+// appends the font, producing a bundle the game can map at startup. The
+// bundle is written next to path and renamed over it, so a failed pack
+// leaves the old one in place.
+int packAssetBundle(const char* path) {
+    AssetBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    // Stat before reading, so a source edited mid-pack makes the bundle stale
+    if (!statAssetSources(header.sources)) {
+        printf("Error: missing sprite or font file\n");
+        return -1;
+    }
+
+    ImageDecodeJob jobs[ASSET_COUNT];
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        jobs[i].path = assetFiles[i];
+    }
+    if (!decodeImagesParallel(jobs, ASSET_COUNT)) {
+        for (int i = 0; i < ASSET_COUNT; i++) {
+            if (jobs[i].image) sfImage_destroy(jobs[i].image);
+        }
+        return -1;
+    }
+
+    AssetRect rects[ASSET_COUNT];
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        sfVector2u size = sfImage_getSize(jobs[i].image);
+        rects[i].x = header.atlasWidth;
+        rects[i].y = 0;
+        rects[i].width = size.x;
+        rects[i].height = size.y;
+        header.atlasWidth += size.x;
+        if (size.y > header.atlasHeight) {
+            header.atlasHeight = size.y;
+        }
+    }
+
+    size_t pixelsSize = (size_t)header.atlasWidth * header.atlasHeight * 4;
+    unsigned char* pixels = calloc(1, pixelsSize);
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        const unsigned char* src = sfImage_getPixelsPtr(jobs[i].image);
+        for (uint32_t row = 0; pixels != NULL && row < rects[i].height; row++) {
+            memcpy(pixels + ((size_t)row * header.atlasWidth + rects[i].x) * 4,
+                   src + (size_t)row * rects[i].width * 4,
+                   (size_t)rects[i].width * 4);
+        }
+        sfImage_destroy(jobs[i].image);
+    }
+    if (pixels == NULL) {
+        printf("Error: no memory for a %ux%u atlas\n", header.atlasWidth, header.atlasHeight);
+        return -1;
+    }
+
+    FILE* fontFile = fopen(FONT_FILE, "rb");
+    if (fontFile == NULL) {
+        printf("Error loading font\n");
+        free(pixels);
+        return -1;
+    }
+    long fontSize = -1;
+    if (fseek(fontFile, 0, SEEK_END) == 0) {
+        fontSize = ftell(fontFile);
+    }
+    unsigned char* fontData = fontSize >= 0 ? malloc(fontSize > 0 ? fontSize : 1) : NULL;
+    if (fontData == NULL || fseek(fontFile, 0, SEEK_SET) != 0 ||
+        fread(fontData, 1, fontSize, fontFile) != (size_t)fontSize) {
+        printf("Error reading %s\n", FONT_FILE);
+        fclose(fontFile);
+        free(fontData);
+        free(pixels);
+        return -1;
+    }
+    fclose(fontFile);
+
+    header.magic = ASSET_BUNDLE_MAGIC;
+    header.version = ASSET_BUNDLE_VERSION;
+    header.spriteCount = ASSET_COUNT;
+    header.pixelsOffset = (sizeof(header) + sizeof(rects) + 15) & ~(uint64_t)15;
+    header.fontOffset = header.pixelsOffset + pixelsSize;
+    header.fontSize = fontSize;
+
+    char tempPath[512];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE* out = fopen(tempPath, "wb");
+    if (out == NULL) {
+        printf("Error opening %s for writing\n", tempPath);
+        free(fontData);
+        free(pixels);
+        return -1;
+    }
+    static const unsigned char padding[16] = {0};
+    size_t paddingSize = header.pixelsOffset - sizeof(header) - sizeof(rects);
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   fwrite(rects, sizeof(rects), 1, out) == 1 &&
+                   fwrite(padding, 1, paddingSize, out) == paddingSize &&
+                   fwrite(pixels, 1, pixelsSize, out) == pixelsSize &&
+                   fwrite(fontData, 1, fontSize, out) == (size_t)fontSize;
+    written = fclose(out) == 0 && written;
+    free(fontData);
+    free(pixels);
+    if (!written || rename(tempPath, path) != 0) {
+        printf("Error writing %s: %s\n", path, strerror(errno));
+        unlink(tempPath);
+        return -1;
+    }
+
+    printf("Packed %d sprites (%ux%u atlas) and %s into %s\n", ASSET_COUNT,
+           header.atlasWidth, header.atlasHeight, FONT_FILE, path);
+    return 0;
+}
+
+bool loadAssetBundle(const char* path, GameAssets* assets) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AssetBundleHeader)) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const AssetBundleHeader* header = (const AssetBundleHeader*)map;
+    const AssetRect* rects = (const AssetRect*)((const char*)map + sizeof(AssetBundleHeader));
+    uint64_t fileSize = (uint64_t)st.st_size;
+    uint64_t pixelsSize = (uint64_t)header->atlasWidth * header->atlasHeight * 4;
+    bool valid = header->magic == ASSET_BUNDLE_MAGIC && header->version == ASSET_BUNDLE_VERSION &&
+                 header->spriteCount == ASSET_COUNT &&
+                 header->pixelsOffset >= sizeof(AssetBundleHeader) + ASSET_COUNT * sizeof(AssetRect) &&
+                 header->pixelsOffset <= fileSize && pixelsSize <= fileSize - header->pixelsOffset &&
+                 header->fontOffset >= header->pixelsOffset + pixelsSize &&
+                 header->fontOffset <= fileSize && header->fontSize <= fileSize - header->fontOffset;
+    for (int i = 0; valid && i < ASSET_COUNT; i++) {
+        valid = (uint64_t)rects[i].x + rects[i].width <= header->atlasWidth &&
+                (uint64_t)rects[i].y + rects[i].height <= header->atlasHeight;
+    }
+    if (!valid) {
+        printf("Asset bundle %s is corrupt, falling back to loose files\n", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+    // Without the loose files there is nothing to be stale against
+    AssetSourceStat sources[ASSET_COUNT + 1];
+    if (statAssetSources(sources) && memcmp(sources, header->sources, sizeof(sources)) != 0) {
+        printf("Asset bundle %s is older than its sources, falling back to loose files "
+               "(run --pack-assets)\n", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    const unsigned char* pixels = (const unsigned char*)map + header->pixelsOffset;
+
+    // One texture, one upload
+    sfTexture* atlas = sfTexture_create(header->atlasWidth, header->atlasHeight);
+    sfFont* font = sfFont_createFromMemory((const char*)map + header->fontOffset, header->fontSize);
+    if (atlas == NULL || font == NULL) {
+        if (atlas) sfTexture_destroy(atlas);
+        if (font) sfFont_destroy(font);
+        munmap(map, st.st_size);
+        return false;
+    }
+    sfTexture_updateFromPixels(atlas, pixels, header->atlasWidth, header->atlasHeight, 0, 0);
+
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        assets->textures[i] = atlas;
+        assets->rects[i] = (sfIntRect){ rects[i].x, rects[i].y, rects[i].width, rects[i].height };
+    }
+    assets->font = font;
+    assets->fromBundle = true;
+    assets->bundleMap = map;
+    assets->bundleSize = st.st_size;
+    return true;
+}
+
+bool loadAssetFiles(GameAssets* assets) {
+    assets->font = sfFont_createFromFile(FONT_FILE);
+    bool ok = (assets->font != NULL);
+
+    ImageDecodeJob jobs[ASSET_COUNT];
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        jobs[i].path = assetFiles[i];
+    }
+    // A failed decode is reported there; the others are still uploaded
+    ok = decodeImagesParallel(jobs, ASSET_COUNT) && ok;
+    for (int i = 0; i < ASSET_COUNT; i++) {
+        assets->textures[i] = NULL;
+        if (jobs[i].image == NULL) {
+            continue;
+        }
+        sfVector2u size = sfImage_getSize(jobs[i].image);
+        assets->textures[i] = sfTexture_createFromImage(jobs[i].image, NULL);
+        assets->rects[i] = (sfIntRect){ 0, 0, size.x, size.y };
+        sfImage_destroy(jobs[i].image);
+    }
+    assets->fromBundle = false;
+    assets->bundleMap = NULL;
+    assets->bundleSize = 0;
+    return ok;
+}
+
+void destroyAssets(GameAssets* assets) {
+    if (assets->fromBundle) {
+        sfTexture_destroy(assets->textures[0]);
+    } else {
+        for (int i = 0; i < ASSET_COUNT; i++) {
+            if (assets->textures[i]) sfTexture_destroy(assets->textures[i]);
+        }
+    }
+    if (assets->font) {
+        sfFont_destroy(assets->font);
+    }
+    if (assets->bundleMap) {
+        munmap(assets->bundleMap, assets->bundleSize);
+    }
+    memset(assets, 0, sizeof(*assets));
+}
+
+// ---------------------------------------------------------------------------
+// Spectator stream: with PACMAN_SPECTATE=1 (or =/shm-name) the engine copies
+// a GameSnapshot of every tick into a POSIX shared-memory ring. Readers map
+// it read-only and poll; each slot is a sequence lock, so a reader that was
+// overwritten mid-copy just retries and the engine never waits for anyone.
+// ./game --watch [/shm-name] is the reference viewer.
+// ---------------------------------------------------------------------------
+bool spectatorRingOpen(const char* name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        LOG_WARN("Could not create spectator stream %s: %s", name, strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, sizeof(SpectatorRing)) != 0) {
+        LOG_WARN("Could not size spectator stream %s: %s", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void* mapped = mmap(NULL, sizeof(SpectatorRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        LOG_WARN("Could not map spectator stream %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+
+    SpectatorRing* ring = (SpectatorRing*)mapped;
+    memset(ring, 0, sizeof(*ring));
+    ring->magic = SPECTATOR_MAGIC;
+    ring->version = SPECTATOR_VERSION;
+    ring->slotCount = SPECTATOR_RING_SLOTS;
+    ring->snapshotSize = sizeof(GameSnapshot);
+    atomic_store(&ring->writerAlive, 1);
+    snprintf(spectatorShmName, sizeof(spectatorShmName), "%s", name);
+    spectatorRing = ring;
+    LOG_INFO("Spectator stream on %s (%zu bytes)", name, sizeof(SpectatorRing));
+    return true;
+}
+
+// Call once the engine is joined. Attached viewers see writerAlive drop and
+// stop; the name is unlinked so the next game starts a fresh ring.
+void spectatorRingClose() {
+    if (spectatorRing == NULL) {
+        return;
+    }
+    atomic_store(&spectatorRing->writerAlive, 0);
+    munmap(spectatorRing, sizeof(SpectatorRing));
+    shm_unlink(spectatorShmName);
+    spectatorRing = NULL;
+}
+
+// Consistent copy of the game: board, pacman and ghosts as of one instant
+void captureGameSnapshot(GameSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    snapshot->generation = atomic_load(&gameState.generation);
+    snapshot->score = gameState.score;
+    snapshot->lives = gameState.lives;
+    snapshot->running = gameState.gameRunning;
+    snapshot->paused = gameState.gamePaused;
+    snapshot->ghostVulnerable = gameState.ghostVulnerable;
+    snapshot->pacmanRow = (int8_t)gameState.pacmanRow;
+    snapshot->pacmanCol = (int8_t)gameState.pacmanCol;
+    snapshot->pacmanDirection = (int8_t)gameState.currentDirection;
+    memcpy(snapshot->board, gameState.board, sizeof(snapshot->board));
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        snapshot->ghostRow[i] = (int8_t)ghosts[i].row;
+        snapshot->ghostCol[i] = (int8_t)ghosts[i].col;
+        snapshot->ghostFlags[i] = (ghosts[i].isVulnerable ? SNAPSHOT_GHOST_VULNERABLE : 0) |
+                                  (ghosts[i].inGhostHouse ? SNAPSHOT_GHOST_IN_HOUSE : 0) |
+                                  (ghosts[i].needsRespawn ? SNAPSHOT_GHOST_RESPAWNING : 0);
+        snapshot->ghostCell[i] = ghosts[i].cellContent;
+    }
+    unlockWholeBoard();
+    MUTEX_LOCK(uiState.mutex);
+    snapshot->screen = (uint8_t)uiState.currentScreen;
+    MUTEX_UNLOCK(uiState.mutex);
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+// Called by the engine once per tick with that tick's snapshot, so no game
+// lock is held while readers see the slot in flux
+void spectatorPublish(const GameSnapshot* captured) {
+    if (spectatorRing == NULL) {
+        return;
+    }
+    GameSnapshot snapshot = *captured;
+    uint64_t tick = atomic_load_explicit(&spectatorRing->published, memory_order_relaxed);
+    snapshot.tick = tick;
+
+    SpectatorSlot* slot = &spectatorRing->slots[tick & (SPECTATOR_RING_SLOTS - 1)];
+    atomic_store_explicit(&slot->seq, 2 * tick + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->snapshot = snapshot;
+    atomic_store_explicit(&slot->seq, 2 * tick + 2, memory_order_release);
+    atomic_store_explicit(&spectatorRing->published, tick + 1, memory_order_release);
+}
+
+// Copies tick out of the ring. False if it is not there (yet or any more)
+// or the engine overwrote it while it was being copied.
+static bool spectatorRead(SpectatorRing* ring, uint64_t tick, GameSnapshot* out) {
+    SpectatorSlot* slot = &ring->slots[tick & (SPECTATOR_RING_SLOTS - 1)];
+    uint64_t before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (before != 2 * tick + 2) {
+        return false;
+    }
+    memcpy(out, &slot->snapshot, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->seq, memory_order_relaxed) == before;
+}
+
+int runSpectatorViewer(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        printf("No spectator stream at %s (start the game with PACMAN_SPECTATE=1): %s\n",
+               name, strerror(errno));
+        return 1;
+    }
+    void* mapped = mmap(NULL, sizeof(SpectatorRing), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        printf("Could not map %s: %s\n", name, strerror(errno));
+        return 1;
+    }
+    SpectatorRing* ring = (SpectatorRing*)mapped;
+    if (ring->magic != SPECTATOR_MAGIC || ring->version != SPECTATOR_VERSION ||
+        ring->slotCount != SPECTATOR_RING_SLOTS || ring->snapshotSize != sizeof(GameSnapshot)) {
+        printf("%s is not a spectator stream this build understands\n", name);
+        munmap(mapped, sizeof(SpectatorRing));
+        return 1;
+    }
+
+    static const char* screenNames[] = { "menu", "play", "scoreboard", "instructions", "quit", "game over" };
+    static const char* directionNames[] = { "-", "up", "down", "left", "right" };
+    uint64_t shown = 0;
+    uint64_t missed = 0;
+    uint64_t lastTick = 0;
+    struct timespec pollInterval = { 0, SPECTATOR_POLL_MS * 1000000L };
+    while (atomic_load(&ring->writerAlive)) {
+        uint64_t published = atomic_load_explicit(&ring->published, memory_order_acquire);
+        GameSnapshot snapshot;
+        if (published == 0 || (shown > 0 && published - 1 == lastTick) ||
+            !spectatorRead(ring, published - 1, &snapshot)) {
+            nanosleep(&pollInterval, NULL);
+            continue;
+        }
+        // Only the newest tick is drawn; anything in between was skipped
+        if (shown > 0) {
+            missed += snapshot.tick - lastTick - 1;
+        }
+        lastTick = snapshot.tick;
+        shown++;
+
+        printf("\033[H\033[2J");
+        printf("tick %llu  session %u  %s%s  score %d  lives %d  heading %s%s\n",
+               (unsigned long long)snapshot.tick, snapshot.generation,
+               snapshot.screen < sizeof(screenNames) / sizeof(screenNames[0]) ? screenNames[snapshot.screen] : "?",
+               snapshot.paused ? " (paused)" : "", snapshot.score, snapshot.lives,
+               snapshot.pacmanDirection >= 0 && snapshot.pacmanDirection <= DIR_RIGHT
+                   ? directionNames[(int)snapshot.pacmanDirection] : "?",
+               snapshot.ghostVulnerable ? "  ghosts vulnerable" : "");
+        for (int row = 0; row < ROWS; row++) {
+            printf("%.*s\n", COLS, snapshot.board[row]);
+        }
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            printf("ghost %d at [%d,%d]%s%s%s\n", i, snapshot.ghostRow[i], snapshot.ghostCol[i],
+                   snapshot.ghostFlags[i] & SNAPSHOT_GHOST_IN_HOUSE ? " in house" : "",
+                   snapshot.ghostFlags[i] & SNAPSHOT_GHOST_VULNERABLE ? " vulnerable" : "",
+                   snapshot.ghostFlags[i] & SNAPSHOT_GHOST_RESPAWNING ? " respawning" : "");
+        }
+        printf("shown %llu ticks, skipped %llu\n", (unsigned long long)shown, (unsigned long long)missed);
+        fflush(stdout);
+        nanosleep(&pollInterval, NULL);
+    }
+    printf("Game closed after %llu ticks\n", (unsigned long long)atomic_load(&ring->published));
+    munmap(mapped, sizeof(SpectatorRing));
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Session server: ./game --serve [pacman.sock] hosts many independent games
+// in one process. Each GameSession carries its own board, ghosts and ghost
+// house; a fixed pool of workers (one per core by default) steps them on
+// deadlines instead of one engine thread and eight timer/ghost threads per
+// game. The rules are the windowed game's, sharing its ghost AI and house
+// ticket logic. ./game --bench-sessions [count] [seconds] measures capacity.
+// ---------------------------------------------------------------------------
+// Next deadline after due; more than a period behind resyncs instead of bursting
+static inline uint64_t sessionNextDue(uint64_t due, int ms, uint64_t now) {
+    due += (uint64_t)ms * 1000000ull;
+    return due > now ? due : now + (uint64_t)ms * 1000000ull;
+}
+
+// Starts a new game in the session. Caller holds session->mutex, or the
+// session is not yet visible to any worker.
+void sessionReset(GameSession* session) {
+    memcpy(session->board, sessionTemplate.board, sizeof(session->board));
+    memcpy(session->powerPelletLocations, sessionTemplate.powerPelletLocations,
+           sizeof(session->powerPelletLocations));
+    session->score = 0;
+    session->lives = 3;
+    session->pacmanRow = sessionTemplate.pacmanStartRow;
+    session->pacmanCol = sessionTemplate.pacmanStartCol;
+    session->currentDirection = DIR_NONE;
+    session->gameRunning = true;
+    session->powerPelletActive = false;
+    session->powerPelletDuration = 0.0f;
+    session->ghostVulnerable = false;
+    session->ghostVulnerableDuration = 0.0f;
+
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        GhostHouse* house = &session->houses[h];
+        ledgerInit(&house->keys, "key", GHOST_HOUSE_KEYS);
+        ledgerInit(&house->permits, "exit permit", GHOST_HOUSE_PERMITS);
+        house->queueHead = 0;
+        house->queueLength = 0;
+    }
+    resetGhostSlots(session->ghosts, session->board);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &session->ghosts[i];
+        ghost->rngSeed = rand_r(&session->seed);
+        ghost->baseIntervalMs = session->rules.ghostIntervalMs + i * session->rules.ghostIntervalStepMs;
+        ghost->hasSpeedBoost = false;
+    }
+
+    uint64_t now = monotonicNs();
+    session->boostTokens = BOOST_BUCKET_CAPACITY;
+    session->boostRefillNs = now;
+    session->boostNextGhost = 0;
+    session->tickDueNs = now + SESSION_TICK_MS * 1000000ull;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        session->ghostDueNs[i] = now + session->ghosts[i].baseIntervalMs * 1000000ull;
+    }
+    session->gamesPlayed++;
+}
+
+// The parts of a Ghost a session plays with. Its thread, timer and
+// semaphore belong to the windowed game and are never copied.
+static void sessionCopyGhost(Ghost* dst, const Ghost* src) {
+    dst->row = src->row;
+    dst->col = src->col;
+    dst->id = src->id;
+    dst->direction = src->direction;
+    dst->isVulnerable = src->isVulnerable;
+    dst->isActive = src->isActive;
+    dst->needsRespawn = src->needsRespawn;
+    dst->respawnRow = src->respawnRow;
+    dst->respawnCol = src->respawnCol;
+    dst->ghostType = src->ghostType;
+    dst->hasSpeedBoost = src->hasSpeedBoost;
+    dst->speedBoostDuration = src->speedBoostDuration;
+    dst->hasKey = src->hasKey;
+    dst->hasExitPermit = src->hasExitPermit;
+    dst->inGhostHouse = src->inGhostHouse;
+    dst->cellContent = src->cellContent;
+    dst->houseId = src->houseId;
+    dst->queuedForHouse = src->queuedForHouse;
+    dst->houseRequestNs = src->houseRequestNs;
+    dst->houseGrants = src->houseGrants;
+    dst->houseWaitNsTotal = src->houseWaitNsTotal;
+    dst->houseWaitNsMax = src->houseWaitNsMax;
+    dst->baseIntervalMs = src->baseIntervalMs;
+    dst->boostStartNs = src->boostStartNs;
+    dst->boostEndNs = src->boostEndNs;
+    dst->rngSeed = src->rngSeed;
+}
+
+// Copies src's game (board, pacman, ghosts, houses, rules and clocks) into
+// dst, so any number of games can branch off one state without allocating.
+// dst's mutex, id, worker and list link are its own and left alone. Caller
+// holds src->mutex or src is private, and owns dst.
+void sessionClone(GameSession* dst, const GameSession* src) {
+    memcpy(dst->board, src->board, sizeof(dst->board));
+    memcpy(dst->powerPelletLocations, src->powerPelletLocations, sizeof(dst->powerPelletLocations));
+    dst->score = src->score;
+    dst->lives = src->lives;
+    dst->pacmanRow = src->pacmanRow;
+    dst->pacmanCol = src->pacmanCol;
+    dst->currentDirection = src->currentDirection;
+    dst->gameRunning = src->gameRunning;
+    dst->powerPelletActive = src->powerPelletActive;
+    dst->powerPelletDuration = src->powerPelletDuration;
+    dst->ghostVulnerable = src->ghostVulnerable;
+    dst->ghostVulnerableDuration = src->ghostVulnerableDuration;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        sessionCopyGhost(&dst->ghosts[i], &src->ghosts[i]);
+    }
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        dst->houses[h].keys = src->houses[h].keys;
+        dst->houses[h].permits = src->houses[h].permits;
+        memcpy(dst->houses[h].queue, src->houses[h].queue, sizeof(dst->houses[h].queue));
+        dst->houses[h].queueHead = src->houses[h].queueHead;
+        dst->houses[h].queueLength = src->houses[h].queueLength;
+    }
+    dst->rules = src->rules;
+    dst->boostTokens = src->boostTokens;
+    dst->boostRefillNs = src->boostRefillNs;
+    dst->boostNextGhost = src->boostNextGhost;
+    dst->tickDueNs = src->tickDueNs;
+    memcpy(dst->ghostDueNs, src->ghostDueNs, sizeof(dst->ghostDueNs));
+    dst->ticks = src->ticks;
+    dst->gamesPlayed = src->gamesPlayed;
+    dst->autopilot = src->autopilot;
+    dst->seed = src->seed;
+}
+
+static Ghost* sessionGhostAt(GameSession* session, int row, int col) {
+    for (int g = 0; g < MAX_GHOSTS; g++) {
+        if (session->ghosts[g].row == row && session->ghosts[g].col == col) {
+            return &session->ghosts[g];
+        }
+    }
+    return NULL;
+}
+
+// A life lost: pacman goes back to his start, the game ends on the last one
+static void sessionPacmanDies(GameSession* session) {
+    session->lives--;
+    session->currentDirection = DIR_NONE;
+    if (session->lives <= 0) {
+        session->gameRunning = false;
+    }
+    int row = session->pacmanRow;
+    int col = session->pacmanCol;
+    session->board[row][col] = session->powerPelletLocations[row][col] ? '0' : ' ';
+    session->pacmanRow = sessionTemplate.pacmanStartRow;
+    session->pacmanCol = sessionTemplate.pacmanStartCol;
+    session->board[session->pacmanRow][session->pacmanCol] = '@';
+}
+
+// movePacman() for one session
+static void sessionMovePacman(GameSession* session) {
+    int oldRow = session->pacmanRow;
+    int oldCol = session->pacmanCol;
+    int next = cellNeighbor(sessionTemplate.neighbors, oldRow, oldCol, session->currentDirection);
+    if (next < 0) {
+        return;
+    }
+    int newRow = next / COLS;
+    int newCol = next % COLS;
+    if (session->board[newRow][newCol] == '=' || isInGhostHouse(newRow, newCol)) {
+        return;
+    }
+    char cellContent = session->board[newRow][newCol];
+    bool preservePowerPellet = false;
+    if (cellContent == '.') {
+        session->score += 10;
+    } else if (cellContent == '0') {
+        if (session->ghostVulnerable) {
+            preservePowerPellet = true;
+        } else {
+            session->score += 50;
+            session->powerPelletActive = true;
+            session->ghostVulnerable = true;
+            session->powerPelletDuration = 0.0f;
+            session->ghostVulnerableDuration = 0.0f;
+        }
+    } else if (cellContent == '#') {
+        Ghost* ghost = sessionGhostAt(session, newRow, newCol);
+        if (ghostMeetsPacman(ghost) == MEET_GHOST_EATEN) {
+            session->score += 200;
+        } else {
+            sessionPacmanDies(session);
+            return;
+        }
+    }
+
+    session->board[oldRow][oldCol] = session->powerPelletLocations[oldRow][oldCol] ? '0' : ' ';
+    session->pacmanRow = newRow;
+    session->pacmanCol = newCol;
+    session->board[newRow][newCol] = '@';
+    if (preservePowerPellet) {
+        session->powerPelletLocations[newRow][newCol] = true;
+    }
+}
+
+// moveGhost() for one session
+static void sessionMoveGhost(GameSession* session, Ghost* ghost, Direction direction) {
+    int oldRow = ghost->row;
+    int oldCol = ghost->col;
+    int next = cellNeighbor(sessionTemplate.neighbors, oldRow, oldCol, direction);
+    if (next < 0) {
+        return;
+    }
+    int newRow = next / COLS;
+    int newCol = next % COLS;
+
+    bool leavingHouse = ghost->inGhostHouse && !isInGhostHouse(newRow, newCol);
+    if (!isValidGhostMove(session->board, newRow, newCol) ||
+        (leavingHouse && !(ghost->hasKey && ghost->hasExitPermit))) {
+        return;
+    }
+
+    // Same meeting rule as moveGhost(); the ghost stays put this turn
+    GhostHouse* house = &session->houses[ghost->houseId];
+    if (newRow == session->pacmanRow && newCol == session->pacmanCol) {
+        if (ghostMeetsPacman(ghost) == MEET_GHOST_EATEN) {
+            ghost->needsRespawn = true;
+            session->board[oldRow][oldCol] = ghost->cellContent;
+            ghostHouseRelease(house, session->ghosts, ghost);
+        } else {
+            sessionPacmanDies(session);
+        }
+        return;
+    }
+
+    if (session->board[oldRow][oldCol] == '#') {
+        session->board[oldRow][oldCol] = ghost->cellContent;
+    }
+    ghost->row = newRow;
+    ghost->col = newCol;
+    char newCellContent = session->board[newRow][newCol];
+    if (newCellContent != '@' && newCellContent != '#') {
+        ghost->cellContent = newCellContent;
+    }
+    session->board[newRow][newCol] = '#';
+    ghost->direction = direction;
+
+    if (leavingHouse) {
+        ghost->inGhostHouse = false;
+        ghostHouseRelease(house, session->ghosts, ghost);
+    }
+}
+
+// boostSchedulerTick() for one session, on the session's clock
+static void sessionBoostTick(GameSession* session, uint64_t now) {
+    const SessionRules* rules = &session->rules;
+    session->boostTokens += (now - session->boostRefillNs) / 1e9 * rules->boostTokensPerSec;
+    session->boostRefillNs = now;
+    if (session->boostTokens > BOOST_BUCKET_CAPACITY) {
+        session->boostTokens = BOOST_BUCKET_CAPACITY;
+    }
+
+    int boosted = 0;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &session->ghosts[i];
+        if (ghost->hasSpeedBoost && now >= ghost->boostEndNs) {
+            ghost->hasSpeedBoost = false;
+        }
+        boosted += ghost->hasSpeedBoost;
+    }
+    if (rules->boostDurationMs <= 0) {
+        return;
+    }
+    for (int n = 0; n < MAX_GHOSTS && boosted < rules->boostSlots && session->boostTokens >= 1.0; n++) {
+        Ghost* ghost = &session->ghosts[(session->boostNextGhost + n) % MAX_GHOSTS];
+        if (!isBoostEligible(ghost)) continue;
+        session->boostTokens -= 1.0;
+        ghost->hasSpeedBoost = true;
+        ghost->boostEndNs = now + (uint64_t)rules->boostDurationMs * 1000000ull;
+        session->boostNextGhost = (ghost->id + 1) % MAX_GHOSTS;
+        boosted++;
+    }
+}
+
+// A boosted ghost moves twice as often, as its timer thread does
+static inline int sessionGhostInterval(const Ghost* ghost) {
+    return ghost->hasSpeedBoost ? ghost->baseIntervalMs / 2 : ghost->baseIntervalMs;
+}
+
+// One turn of ghostThreadFunc() for one session. Returns the delay in ms
+// until the ghost's next turn.
+static int sessionGhostTurn(GameSession* session, Ghost* ghost) {
+    GhostHouse* house = &session->houses[ghost->houseId];
+    if (ghost->needsRespawn) {
+        ghost->row = ghost->respawnRow;
+        ghost->col = ghost->respawnCol;
+        ghost->isVulnerable = false;
+        ghost->needsRespawn = false;
+        ghost->inGhostHouse = true;
+        ghost->cellContent = session->board[ghost->row][ghost->col];
+        session->board[ghost->row][ghost->col] = '#';
+        ghost->hasSpeedBoost = false;
+        ghostHouseRelease(house, session->ghosts, ghost);
+        return SESSION_RESPAWN_DELAY_MS + ghost->baseIntervalMs;
+    }
+
+    if (ghost->inGhostHouse && !ghost->hasKey && !ghost->hasExitPermit &&
+        !ghostHouseTryAcquire(house, session->ghosts, ghost)) {
+        return ghost->baseIntervalMs; // still queued
+    }
+
+    ghost->isVulnerable = session->ghostVulnerable;
+    DirectionWeights weights = calculateDirectionWeights(ghost, session->pacmanRow, session->pacmanCol,
+                                                         session->currentDirection);
+    bool validMoves[4];
+    int validCount = ghostOpenMoves(session->board, sessionTemplate.neighbors, ghost, validMoves);
+    Direction newDirection = chooseGhostDirection(validMoves, validCount, ghost, weights);
+    if (newDirection != DIR_NONE) {
+        sessionMoveGhost(session, ghost, newDirection);
+    }
+    return sessionGhostInterval(ghost);
+}
+
+// Benchmark sessions are steered by the same bot as PACMAN_INPUT=bot
+static void sessionAutopilot(GameSession* session) {
+    BotView view;
+    view.board = session->board;
+    view.neighbors = sessionTemplate.neighbors;
+    view.pacmanRow = session->pacmanRow;
+    view.pacmanCol = session->pacmanCol;
+    view.direction = session->currentDirection;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &session->ghosts[i];
+        view.ghostRow[i] = ghost->row;
+        view.ghostCol[i] = ghost->col;
+        view.ghostDangerous[i] = !ghost->needsRespawn && !ghost->isVulnerable;
+        view.ghostPrey[i] = !ghost->needsRespawn && ghost->isVulnerable;
+    }
+    bool fled;
+    session->currentDirection = botChooseDirection(&view, &fled);
+}
+
+// Runs whatever is due in one session; returns its next deadline
+static uint64_t sessionStep(SessionWorker* worker, GameSession* session, uint64_t now) {
+    pthread_mutex_lock(&session->mutex);
+    if (!session->gameRunning && session->autopilot) {
+        sessionReset(session);
+    }
+    if (!session->gameRunning) {
+        pthread_mutex_unlock(&session->mutex);
+        return now + SESSION_IDLE_WAIT_MS * 1000000ull;
+    }
+
+    if (now >= session->tickDueNs) {
+        uint64_t lateNs = now - session->tickDueNs;
+        worker->lateNsTotal += lateNs;
+        if (lateNs > worker->lateNsMax) {
+            worker->lateNsMax = lateNs;
+        }
+        if (session->autopilot) {
+            sessionAutopilot(session);
+        }
+        sessionMovePacman(session);
+        sessionBoostTick(session, now);
+
+        // Power pellet and vulnerability timers, as in the engine tick
+        float deltaTime = SESSION_TICK_MS / 1000.0f;
+        if (session->powerPelletActive) {
+            session->powerPelletDuration += deltaTime;
+            if (session->powerPelletDuration >= session->rules.powerPelletMs / 1000.0f) {
+                session->powerPelletActive = false;
+                session->ghostVulnerable = false;
+            }
+        }
+        if (session->ghostVulnerable) {
+            session->ghostVulnerableDuration += deltaTime;
+            if (session->ghostVulnerableDuration >= session->rules.vulnerableMs / 1000.0f) {
+                session->ghostVulnerable = false;
+            }
+        }
+        session->ticks++;
+        worker->pacmanTicks++;
+        session->tickDueNs = sessionNextDue(session->tickDueNs, SESSION_TICK_MS, now);
+    }
+
+    uint64_t nextDue = session->tickDueNs;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (now >= session->ghostDueNs[i]) {
+            int delayMs = sessionGhostTurn(session, &session->ghosts[i]);
+            session->ghostDueNs[i] = sessionNextDue(session->ghostDueNs[i], delayMs, now);
+            worker->ghostMoves++;
+        }
+        if (session->ghostDueNs[i] < nextDue) {
+            nextDue = session->ghostDueNs[i];
+        }
+    }
+    pthread_mutex_unlock(&session->mutex);
+    return nextDue;
+}
+
+static void* sessionWorkerThread(void* arg) {
+    SessionWorker* worker = (SessionWorker*)arg;
+    char name[24];
+    snprintf(name, sizeof(name), "session worker %d", worker->id);
+    setThreadName(name);
+    applyThreadPlacement(name, worker->cpu, 0);
+
+    while (!simulationCancelled()) {
+        uint64_t now = monotonicNs();
+        uint64_t wakeNs = now + SESSION_IDLE_WAIT_MS * 1000000ull;
+        pthread_mutex_lock(&worker->mutex);
+        for (GameSession* session = worker->sessions; session != NULL; session = session->next) {
+            uint64_t due = sessionStep(worker, session, now);
+            if (due < wakeNs) {
+                wakeNs = due;
+            }
+        }
+        worker->passes++;
+        worker->busyNs += monotonicNs() - now;
+        pthread_mutex_unlock(&worker->mutex);
+
+        struct timespec deadline = { (time_t)(wakeNs / 1000000000ull), (long)(wakeNs % 1000000000ull) };
+        cancellableSleepUntil(&deadline, NULL);
+    }
+    return NULL;
+}
+
+// Starts the pool; workerCount <= 0 means one worker per online CPU, each
+// pinned to its own core
+bool sessionManagerStart(int workerCount) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    if (workerCount <= 0) workerCount = (int)cpus;
+    if (workerCount > SESSION_MAX_WORKERS) workerCount = SESSION_MAX_WORKERS;
+
+    memset(&sessionManager, 0, sizeof(sessionManager));
+    atomic_init(&sessionManager.nextSessionId, 1);
+    sessionManager.workerCount = workerCount;
+    sessionManager.coreCount = workerCount < cpus ? workerCount : (int)cpus;
+    uint64_t now = monotonicNs();
+    for (int w = 0; w < workerCount; w++) {
+        SessionWorker* worker = &sessionManager.workers[w];
+        worker->id = w;
+        worker->cpu = w % cpus;
+        worker->startNs = now;
+        pthread_mutex_init(&worker->mutex, NULL);
+        worker->started = (pthread_create(&worker->thread, NULL, sessionWorkerThread, worker) == 0);
+        if (!worker->started) {
+            LOG_ERROR("Could not start session worker %d", w);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Cancels and joins the workers, then frees every session still hosted
+void sessionManagerStop() {
+    cancelSimulation();
+    for (int w = 0; w < sessionManager.workerCount; w++) {
+        SessionWorker* worker = &sessionManager.workers[w];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+            worker->started = false;
+        }
+        while (worker->sessions != NULL) {
+            GameSession* session = worker->sessions;
+            worker->sessions = session->next;
+            pthread_mutex_destroy(&session->mutex);
+            free(session);
+        }
+        worker->sessionCount = 0;
+        pthread_mutex_destroy(&worker->mutex);
+    }
+}
+
+// Creates a session and hands it to the least loaded worker
+GameSession* sessionCreate(bool autopilot) {
+    GameSession* session = calloc(1, sizeof(GameSession));
+    if (session == NULL) {
+        return NULL;
+    }
+    session->id = atomic_fetch_add(&sessionManager.nextSessionId, 1);
+    session->autopilot = autopilot;
+    session->rules = sessionDefaultRules;
+    session->seed = 7919u * session->id;
+    pthread_mutex_init(&session->mutex, NULL);
+    sessionReset(session);
+
+    SessionWorker* target = &sessionManager.workers[0];
+    for (int w = 1; w < sessionManager.workerCount; w++) {
+        if (sessionManager.workers[w].sessionCount < target->sessionCount) {
+            target = &sessionManager.workers[w];
+        }
+    }
+    pthread_mutex_lock(&target->mutex);
+    session->worker = target->id;
+    session->next = target->sessions;
+    target->sessions = session;
+    target->sessionCount++;
+    pthread_mutex_unlock(&target->mutex);
+    return session;
+}
+
+void sessionDestroy(GameSession* session) {
+    SessionWorker* worker = &sessionManager.workers[session->worker];
+    pthread_mutex_lock(&worker->mutex);
+    for (GameSession** link = &worker->sessions; *link != NULL; link = &(*link)->next) {
+        if (*link == session) {
+            *link = session->next;
+            worker->sessionCount--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    pthread_mutex_destroy(&session->mutex);
+    free(session);
+}
+
+// Per-worker load. A worker's capacity is its sessions divided by the share
+// of its core it kept busy, i.e. how many sessions one core could hold.
+static int sessionFormatReport(char* out, size_t outSize) {
+    int written = 0;
+    int totalSessions = 0;
+    double totalCapacity = 0.0;
+    uint64_t now = monotonicNs();
+    written += snprintf(out + written, outSize - written, "%-7s %4s %8s %12s %12s %7s %9s %9s %10s\n",
+                        "worker", "cpu", "sessions", "pacman t/s", "ghost mv/s", "busy %",
+                        "late avg", "late max", "cap/core");
+    for (int w = 0; w < sessionManager.workerCount && written < (int)outSize; w++) {
+        SessionWorker* worker = &sessionManager.workers[w];
+        pthread_mutex_lock(&worker->mutex);
+        double elapsed = (now - worker->startNs) / 1e9;
+        double busy = elapsed > 0 ? worker->busyNs / 1e9 / elapsed : 0.0;
+        double capacity = busy > 0 ? worker->sessionCount / busy : 0.0;
+        written += snprintf(out + written, outSize - written,
+                            "%-7d %4d %8d %12.0f %12.0f %6.2f%% %7.2fms %7.2fms %10.0f\n",
+                            worker->id, worker->cpu, worker->sessionCount,
+                            elapsed > 0 ? worker->pacmanTicks / elapsed : 0.0,
+                            elapsed > 0 ? worker->ghostMoves / elapsed : 0.0,
+                            busy * 100.0,
+                            worker->pacmanTicks ? worker->lateNsTotal / 1e6 / worker->pacmanTicks : 0.0,
+                            worker->lateNsMax / 1e6, capacity);
+        totalSessions += worker->sessionCount;
+        totalCapacity += capacity;
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    if (written < (int)outSize) {
+        written += snprintf(out + written, outSize - written,
+                            "%d sessions on %d workers over %d cores: %.1f sessions per core, capacity ~%.0f per core\n",
+                            totalSessions, sessionManager.workerCount, sessionManager.coreCount,
+                            (double)totalSessions / sessionManager.coreCount,
+                            sessionManager.workerCount ? totalCapacity / sessionManager.workerCount : 0.0);
+    }
+    return written < (int)outSize ? written : (int)outSize - 1;
+}
+
+void printSessionReport() {
+    char report[SESSION_REPORT_BYTES];
+    sessionFormatReport(report, sizeof(report));
+    printf("\n=== Session workers ===\n%s", report);
+    printf("resource accounting violations: %llu\n",
+           (unsigned long long)atomic_load(&resourceViolations));
+}
+
+static bool sessionClientSend(SessionClient* client, const char* text, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(client->fd, text, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false; // a client that cannot keep up with replies is dropped
+        }
+        text += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// One line of the text protocol:
+//   NEW                 start (or restart) this connection's game -> OK <id>
+//   DIR U|D|L|R         steer pacman
+//   STATE               STATE <id> <score> <lives> <row> <col> running|over <ticks>
+//   BOARD               the board, ROWS lines, then END
+//   STATS               the per-worker report, then END
+//   QUIT                close the connection (and its session)
+// Returns false when the connection should be closed.
+static bool sessionClientCommand(SessionClient* client, char* line) {
+    char reply[SESSION_REPORT_BYTES + ROWS * (COLS + 1) + 256];
+    int length = 0;
+    if (strcmp(line, "NEW") == 0) {
+        if (client->session != NULL) {
+            pthread_mutex_lock(&client->session->mutex);
+            sessionReset(client->session);
+            pthread_mutex_unlock(&client->session->mutex);
+        } else {
+            client->session = sessionCreate(false);
+        }
+        length = client->session != NULL
+            ? snprintf(reply, sizeof(reply), "OK %d\n", client->session->id)
+            : snprintf(reply, sizeof(reply), "ERR out of memory\n");
+    } else if (strcmp(line, "QUIT") == 0) {
+        return false;
+    } else if (strcmp(line, "STATS") == 0) {
+        // A clipped report still ends in END, so the client never waits for it
+        static const char end[] = "END\n";
+        length = sessionFormatReport(reply, sizeof(reply) - (sizeof(end) - 1));
+        memcpy(reply + length, end, sizeof(end) - 1);
+        length += sizeof(end) - 1;
+    } else if (client->session == NULL) {
+        length = snprintf(reply, sizeof(reply), "ERR no session, send NEW first\n");
+    } else if (strncmp(line, "DIR ", 4) == 0) {
+        Direction direction = DIR_NONE;
+        switch (line[4]) {
+            case 'U': direction = DIR_UP; break;
+            case 'D': direction = DIR_DOWN; break;
+            case 'L': direction = DIR_LEFT; break;
+            case 'R': direction = DIR_RIGHT; break;
+            default: break;
+        }
+        if (direction == DIR_NONE) {
+            length = snprintf(reply, sizeof(reply), "ERR direction must be U, D, L or R\n");
+        } else {
+            pthread_mutex_lock(&client->session->mutex);
+            client->session->currentDirection = direction;
+            pthread_mutex_unlock(&client->session->mutex);
+            length = snprintf(reply, sizeof(reply), "OK\n");
+        }
+    } else if (strcmp(line, "STATE") == 0) {
+        GameSession* session = client->session;
+        pthread_mutex_lock(&session->mutex);
+        length = snprintf(reply, sizeof(reply), "STATE %d %d %d %d %d %s %llu\n", session->id,
+                          session->score, session->lives, session->pacmanRow, session->pacmanCol,
+                          session->gameRunning ? "running" : "over", (unsigned long long)session->ticks);
+        pthread_mutex_unlock(&session->mutex);
+    } else if (strcmp(line, "BOARD") == 0) {
+        pthread_mutex_lock(&client->session->mutex);
+        for (int row = 0; row < ROWS; row++) {
+            memcpy(reply + length, client->session->board[row], COLS);
+            length += COLS;
+            reply[length++] = '\n';
+        }
+        pthread_mutex_unlock(&client->session->mutex);
+        length += snprintf(reply + length, sizeof(reply) - length, "END\n");
+    } else {
+        length = snprintf(reply, sizeof(reply), "ERR unknown command\n");
+    }
+    if (length > (int)sizeof(reply) - 1) {
+        length = (int)sizeof(reply) - 1;
+    }
+    return sessionClientSend(client, reply, length);
+}
+
+static void sessionClientClose(int epollFd, SessionClient* client) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    if (client->session != NULL) {
+        sessionDestroy(client->session);
+    }
+    free(client);
+}
+
+// Reads what the client sent and runs every complete line. Returns false
+// when the connection is finished.
+static bool sessionClientRead(SessionClient* client) {
+    while (true) {
+        ssize_t received = recv(client->fd, client->buffer + client->length,
+                                sizeof(client->buffer) - 1 - client->length, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        client->length += received;
+        client->buffer[client->length] = '\0';
+
+        char* line = client->buffer;
+        char* end;
+        while ((end = strchr(line, '\n')) != NULL) {
+            *end = '\0';
+            if (end > line && end[-1] == '\r') {
+                end[-1] = '\0';
+            }
+            if (!sessionClientCommand(client, line)) {
+                return false;
+            }
+            line = end + 1;
+        }
+        client->length -= (int)(line - client->buffer);
+        memmove(client->buffer, line, client->length);
+        if (client->length >= (int)sizeof(client->buffer) - 1) {
+            return false; // a line longer than the buffer is not a valid command
+        }
+    }
+}
+
+// Serves local clients until SIGINT or SIGTERM. The listener, the signals
+// and every connection share one epoll loop on the calling thread; the games
+// themselves run on the worker pool.
+int runSessionServer(const char* socketPath) {
+    // Block the shutdown signals before any thread exists, so every thread
+    // inherits the mask and they arrive only through the signalfd
+    sigset_t shutdownSignals;
+    sigemptyset(&shutdownSignals);
+    sigaddset(&shutdownSignals, SIGINT);
+    sigaddset(&shutdownSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdownSignals, NULL);
+
+    logInit();
+    setThreadName("session server");
+    buildSessionTemplate();
+    initSimulationCancel();
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+    unlink(socketPath);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listenFd, 64) != 0) {
+        printf("Could not listen on %s: %s\n", socketPath, strerror(errno));
+        if (listenFd >= 0) close(listenFd);
+        logShutdown();
+        return 1;
+    }
+    int signalFd = signalfd(-1, &shutdownSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    static int listenTag, signalTag; // epoll data for the two fixed descriptors
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listenTag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.ptr = &signalTag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &ev);
+
+    const char* workersEnv = getenv("PACMAN_SESSION_WORKERS");
+    if (!sessionManagerStart(workersEnv != NULL ? atoi(workersEnv) : 0)) {
+        sessionManagerStop();
+        close(epollFd);
+        close(signalFd);
+        close(listenFd);
+        logShutdown();
+        return 1;
+    }
+    LOG_INFO("Serving sessions on %s with %d workers", socketPath, sessionManager.workerCount);
+
+    int clientCount = 0;
+    int clientCapacity = 0;
+    SessionClient** clients = NULL;
+    bool serving = true;
+    while (serving) {
+        struct epoll_event ready[32];
+        int readyCount = epoll_wait(epollFd, ready, 32, -1);
+        if (readyCount < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("Session server epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < readyCount; i++) {
+            if (ready[i].data.ptr == &signalTag) {
+                serving = false;
+            } else if (ready[i].data.ptr == &listenTag) {
+                int fd;
+                while ((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    if (clientCount == clientCapacity) {
+                        int grown = clientCapacity * 2 + 16;
+                        SessionClient** larger = realloc(clients, sizeof(SessionClient*) * grown);
+                        if (larger == NULL) {
+                            close(fd);
+                            continue;
+                        }
+                        clients = larger;
+                        clientCapacity = grown;
+                    }
+                    SessionClient* client = calloc(1, sizeof(SessionClient));
+                    if (client == NULL) {
+                        close(fd);
+                        continue;
+                    }
+                    client->fd = fd;
+                    ev.events = EPOLLIN | EPOLLRDHUP;
+                    ev.data.ptr = client;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+                    clients[clientCount++] = client;
+                }
+            } else {
+                SessionClient* client = (SessionClient*)ready[i].data.ptr;
+                if (!sessionClientRead(client)) {
+                    for (int c = 0; c < clientCount; c++) {
+                        if (clients[c] == client) {
+                            clients[c] = clients[--clientCount];
+                            break;
+                        }
+                    }
+                    sessionClientClose(epollFd, client);
+                }
+            }
+        }
+    }
+
+    LOG_INFO("Shutting down, %d clients connected", clientCount);
+    printSessionReport();
+    for (int c = 0; c < clientCount; c++) {
+        clients[c]->session = NULL; // freed with the worker lists below
+        sessionClientClose(epollFd, clients[c]);
+    }
+    free(clients);
+    sessionManagerStop();
+    close(epollFd);
+    close(signalFd);
+    close(listenFd);
+    unlink(socketPath);
+    logShutdown();
+    pthread_mutex_destroy(&simulationCancel.mutex);
+    pthread_cond_destroy(&simulationCancel.cond);
+    return 0;
+}
+
+// Hosts sessionCount self-driving sessions for a while and reports what the
+// pool sustained
+int runSessionBenchmark(int sessionCount, int seconds) {
+    logInit();
+    buildSessionTemplate();
+    initSimulationCancel();
+    const char* workersEnv = getenv("PACMAN_SESSION_WORKERS");
+    if (!sessionManagerStart(workersEnv != NULL ? atoi(workersEnv) : 0)) {
+        sessionManagerStop();
+        logShutdown();
+        return 1;
+    }
+
+    printf("=== Session server: %d sessions for %d s ===\n", sessionCount, seconds);
+    int created = 0;
+    for (int i = 0; i < sessionCount; i++) {
+        if (sessionCreate(true) != NULL) {
+            created++;
+        }
+    }
+    cancellableSleepMs(seconds * 1000, NULL);
+
+    uint64_t games = 0;
+    for (int w = 0; w < sessionManager.workerCount; w++) {
+        SessionWorker* worker = &sessionManager.workers[w];
+        pthread_mutex_lock(&worker->mutex);
+        for (GameSession* session = worker->sessions; session != NULL; session = session->next) {
+            games += session->gamesPlayed;
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    printSessionReport();
+    printf("%d sessions created, %llu games played\n", created, (unsigned long long)games);
+    sessionManagerStop();
+    logShutdown();
+    pthread_mutex_destroy(&simulationCancel.mutex);
+    pthread_cond_destroy(&simulationCancel.cond);
+    return created == sessionCount && atomic_load(&resourceViolations) == 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Snapshot codec: a stream of GameSnapshots becomes keyframes plus per-tick
+// deltas for replays and spectator streams. A keyframe carries the whole
+// snapshot; a delta carries a bit mask of what changed, score and lives as
+// signed differences, entity moves as one-byte steps and the changed board
+// cells as gap-coded indices. Integers are LEB128 varints, so a typical tick
+// is a couple of dozen bytes. ./game --bench-codec measures it.
+// ---------------------------------------------------------------------------
+#define SNAPSHOT_CHANGED_SCORE 0x01
+#define SNAPSHOT_CHANGED_LIVES 0x02
+#define SNAPSHOT_CHANGED_SCREEN 0x04
+#define SNAPSHOT_CHANGED_STATUS 0x08
+#define SNAPSHOT_CHANGED_PACMAN 0x10
+#define SNAPSHOT_CHANGED_GHOST0 0x20 // one bit per ghost from here
+#define SNAPSHOT_CHANGED_GHOST_CELLS (SNAPSHOT_CHANGED_GHOST0 << MAX_GHOSTS)
+#define SNAPSHOT_STEP_JUMP 9        // step code for a move of more than one cell
+#define SNAPSHOT_STEP_EXTRA 0x10    // the entity's heading or flags byte follows
+
+static inline void bytePut(ByteWriter* writer, uint8_t value) {
+    if (writer->length < writer->capacity) {
+        writer->data[writer->length] = value;
+    } else {
+        writer->overflow = true;
+    }
+    writer->length++;
+}
+
+static inline void bytePutVarint(ByteWriter* writer, uint64_t value) {
+    while (value >= 0x80) {
+        bytePut(writer, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    bytePut(writer, (uint8_t)value);
+}
+
+// Zigzag, so small negative differences stay one byte
+static inline void bytePutSigned(ByteWriter* writer, int64_t value) {
+    bytePutVarint(writer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static inline uint8_t byteGet(ByteReader* reader) {
+    if (reader->offset >= reader->length) {
+        reader->error = true;
+        return 0;
+    }
+    return reader->data[reader->offset++];
+}
+
+static inline uint64_t byteGetVarint(ByteReader* reader) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = byteGet(reader);
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    reader->error = true;
+    return 0;
+}
+
+static inline int64_t byteGetSigned(ByteReader* reader) {
+    uint64_t value = byteGetVarint(reader);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// An entity that moved at most one cell each way is one byte: the step
+// (dRow + 1) * 3 + (dCol + 1) in the low nibble. Anything further (a death
+// or respawn) is SNAPSHOT_STEP_JUMP followed by the new row and column.
+static void snapshotPutEntity(ByteWriter* writer, int8_t oldRow, int8_t oldCol, uint8_t oldExtra,
+                              int8_t row, int8_t col, uint8_t extra) {
+    int rowStep = row - oldRow;
+    int colStep = col - oldCol;
+    bool step = rowStep >= -1 && rowStep <= 1 && colStep >= -1 && colStep <= 1;
+    uint8_t code = step ? (uint8_t)((rowStep + 1) * 3 + (colStep + 1)) : SNAPSHOT_STEP_JUMP;
+    if (extra != oldExtra) {
+        code |= SNAPSHOT_STEP_EXTRA;
+    }
+    bytePut(writer, code);
+    if (!step) {
+        bytePut(writer, (uint8_t)row);
+        bytePut(writer, (uint8_t)col);
+    }
+    if (extra != oldExtra) {
+        bytePut(writer, extra);
+    }
+}
+
+static void snapshotGetEntity(ByteReader* reader, int8_t* row, int8_t* col, uint8_t* extra) {
+    uint8_t code = byteGet(reader);
+    uint8_t move = code & 0x0F;
+    if (move == SNAPSHOT_STEP_JUMP) {
+        *row = (int8_t)byteGet(reader);
+        *col = (int8_t)byteGet(reader);
+    } else if (move < SNAPSHOT_STEP_JUMP) {
+        *row += move / 3 - 1;
+        *col += move % 3 - 1;
+    } else {
+        reader->error = true;
+    }
+    if (code & SNAPSHOT_STEP_EXTRA) {
+        *extra = byteGet(reader);
+    }
+}
+
+static inline uint8_t snapshotStatusBits(const GameSnapshot* snapshot) {
+    return (snapshot->running ? 1 : 0) | (snapshot->paused ? 2 : 0) | (snapshot->ghostVulnerable ? 4 : 0);
+}
+
+// keyframeInterval is in ticks; 0 or 1 makes every frame a keyframe
+void snapshotEncoderInit(SnapshotEncoder* encoder, int keyframeInterval) {
+    memset(encoder, 0, sizeof(*encoder));
+    encoder->keyframeInterval = keyframeInterval;
+}
+
+static void snapshotEncodeKeyframe(ByteWriter* writer, const GameSnapshot* snapshot) {
+    bytePut(writer, SNAPSHOT_FRAME_KEY);
+    bytePutVarint(writer, snapshot->tick);
+    bytePutVarint(writer, snapshot->generation);
+    bytePutSigned(writer, snapshot->score);
+    bytePutSigned(writer, snapshot->lives);
+    bytePut(writer, snapshot->screen);
+    bytePut(writer, snapshotStatusBits(snapshot));
+    bytePut(writer, (uint8_t)snapshot->pacmanRow);
+    bytePut(writer, (uint8_t)snapshot->pacmanCol);
+    bytePut(writer, (uint8_t)snapshot->pacmanDirection);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        bytePut(writer, (uint8_t)snapshot->ghostRow[i]);
+        bytePut(writer, (uint8_t)snapshot->ghostCol[i]);
+        bytePut(writer, snapshot->ghostFlags[i]);
+        bytePut(writer, (uint8_t)snapshot->ghostCell[i]);
+    }
+    for (int cell = 0; cell < ROWS * COLS; cell++) {
+        bytePut(writer, (uint8_t)snapshot->board[cell / COLS][cell % COLS]);
+    }
+}
+
+// Writes one frame for snapshot into out. Returns its length, or 0 if out is
+// smaller than SNAPSHOT_FRAME_MAX would need (nothing is remembered then).
+size_t snapshotEncode(SnapshotEncoder* encoder, const GameSnapshot* snapshot, uint8_t* out, size_t outSize) {
+    ByteWriter writer = { out, 0, outSize, false };
+    const GameSnapshot* previous = &encoder->previous;
+
+    // Deltas only make sense against a close predecessor in the same session
+    int changedCells = 0;
+    bool keyframe = !encoder->havePrevious || encoder->keyframeInterval <= 1 ||
+                    encoder->sinceKeyframe + 1 >= (uint64_t)encoder->keyframeInterval ||
+                    snapshot->tick <= previous->tick || snapshot->generation != previous->generation;
+    bool rowChanged[ROWS];
+    if (!keyframe) {
+        // Most rows are untouched from one tick to the next
+        for (int row = 0; row < ROWS; row++) {
+            rowChanged[row] = memcmp(snapshot->board[row], previous->board[row], COLS) != 0;
+            for (int col = 0; rowChanged[row] && col < COLS; col++) {
+                changedCells += snapshot->board[row][col] != previous->board[row][col];
+            }
+        }
+        keyframe = changedCells > SNAPSHOT_MAX_DELTA_CELLS;
+    }
+
+    if (keyframe) {
+        snapshotEncodeKeyframe(&writer, snapshot);
+    } else {
+        uint32_t changed = 0;
+        if (snapshot->score != previous->score) changed |= SNAPSHOT_CHANGED_SCORE;
+        if (snapshot->lives != previous->lives) changed |= SNAPSHOT_CHANGED_LIVES;
+        if (snapshot->screen != previous->screen) changed |= SNAPSHOT_CHANGED_SCREEN;
+        if (snapshotStatusBits(snapshot) != snapshotStatusBits(previous)) changed |= SNAPSHOT_CHANGED_STATUS;
+        if (snapshot->pacmanRow != previous->pacmanRow || snapshot->pacmanCol != previous->pacmanCol ||
+            snapshot->pacmanDirection != previous->pacmanDirection) {
+            changed |= SNAPSHOT_CHANGED_PACMAN;
+        }
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            if (snapshot->ghostRow[i] != previous->ghostRow[i] || snapshot->ghostCol[i] != previous->ghostCol[i] ||
+                snapshot->ghostFlags[i] != previous->ghostFlags[i]) {
+                changed |= SNAPSHOT_CHANGED_GHOST0 << i;
+            }
+        }
+        if (memcmp(snapshot->ghostCell, previous->ghostCell, sizeof(snapshot->ghostCell)) != 0) {
+            changed |= SNAPSHOT_CHANGED_GHOST_CELLS;
+        }
+
+        bytePut(&writer, SNAPSHOT_FRAME_DELTA);
+        bytePutVarint(&writer, snapshot->tick - previous->tick);
+        bytePutVarint(&writer, changed);
+        if (changed & SNAPSHOT_CHANGED_SCORE) bytePutSigned(&writer, (int64_t)snapshot->score - previous->score);
+        if (changed & SNAPSHOT_CHANGED_LIVES) bytePutSigned(&writer, (int64_t)snapshot->lives - previous->lives);
+        if (changed & SNAPSHOT_CHANGED_SCREEN) bytePut(&writer, snapshot->screen);
+        if (changed & SNAPSHOT_CHANGED_STATUS) bytePut(&writer, snapshotStatusBits(snapshot));
+        if (changed & SNAPSHOT_CHANGED_PACMAN) {
+            snapshotPutEntity(&writer, previous->pacmanRow, previous->pacmanCol, (uint8_t)previous->pacmanDirection,
+                              snapshot->pacmanRow, snapshot->pacmanCol, (uint8_t)snapshot->pacmanDirection);
+        }
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            if (changed & (SNAPSHOT_CHANGED_GHOST0 << i)) {
+                snapshotPutEntity(&writer, previous->ghostRow[i], previous->ghostCol[i], previous->ghostFlags[i],
+                                  snapshot->ghostRow[i], snapshot->ghostCol[i], snapshot->ghostFlags[i]);
+            }
+        }
+        for (int i = 0; (changed & SNAPSHOT_CHANGED_GHOST_CELLS) && i < MAX_GHOSTS; i++) {
+            bytePut(&writer, (uint8_t)snapshot->ghostCell[i]);
+        }
+        bytePutVarint(&writer, changedCells);
+        int lastCell = -1;
+        for (int row = 0; row < ROWS; row++) {
+            for (int col = 0; rowChanged[row] && col < COLS; col++) {
+                if (snapshot->board[row][col] != previous->board[row][col]) {
+                    int cell = row * COLS + col;
+                    bytePutVarint(&writer, cell - lastCell - 1);
+                    bytePut(&writer, (uint8_t)snapshot->board[row][col]);
+                    lastCell = cell;
+                }
+            }
+        }
+    }
+
+    if (writer.overflow) {
+        return 0;
+    }
+    encoder->previous = *snapshot;
+    encoder->havePrevious = true;
+    encoder->sinceKeyframe = keyframe ? 0 : encoder->sinceKeyframe + 1;
+    encoder->frames++;
+    encoder->keyframes += keyframe ? 1 : 0;
+    encoder->bytes += writer.length;
+    return writer.length;
+}
+
+void snapshotDecoderInit(SnapshotDecoder* decoder) {
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+// Applies one frame and copies the resulting snapshot to out. False for a
+// malformed frame or a delta with no keyframe before it; the decoder then
+// waits for the next keyframe.
+bool snapshotDecode(SnapshotDecoder* decoder, const uint8_t* frame, size_t length, GameSnapshot* out) {
+    ByteReader reader = { frame, length, 0, false };
+    GameSnapshot next = decoder->current;
+    uint8_t type = byteGet(&reader);
+
+    if (type == SNAPSHOT_FRAME_KEY) {
+        next.tick = byteGetVarint(&reader);
+        next.generation = (uint32_t)byteGetVarint(&reader);
+        next.score = (int32_t)byteGetSigned(&reader);
+        next.lives = (int32_t)byteGetSigned(&reader);
+        next.screen = byteGet(&reader);
+        uint8_t status = byteGet(&reader);
+        next.running = status & 1;
+        next.paused = (status >> 1) & 1;
+        next.ghostVulnerable = (status >> 2) & 1;
+        next.pacmanRow = (int8_t)byteGet(&reader);
+        next.pacmanCol = (int8_t)byteGet(&reader);
+        next.pacmanDirection = (int8_t)byteGet(&reader);
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            next.ghostRow[i] = (int8_t)byteGet(&reader);
+            next.ghostCol[i] = (int8_t)byteGet(&reader);
+            next.ghostFlags[i] = byteGet(&reader);
+            next.ghostCell[i] = (char)byteGet(&reader);
+        }
+        for (int cell = 0; cell < ROWS * COLS; cell++) {
+            next.board[cell / COLS][cell % COLS] = (char)byteGet(&reader);
+        }
+    } else if (type == SNAPSHOT_FRAME_DELTA && decoder->haveKeyframe) {
+        next.tick += byteGetVarint(&reader);
+        uint64_t changed = byteGetVarint(&reader);
+        if (changed & SNAPSHOT_CHANGED_SCORE) next.score += (int32_t)byteGetSigned(&reader);
+        if (changed & SNAPSHOT_CHANGED_LIVES) next.lives += (int32_t)byteGetSigned(&reader);
+        if (changed & SNAPSHOT_CHANGED_SCREEN) next.screen = byteGet(&reader);
+        if (changed & SNAPSHOT_CHANGED_STATUS) {
+            uint8_t status = byteGet(&reader);
+            next.running = status & 1;
+            next.paused = (status >> 1) & 1;
+            next.ghostVulnerable = (status >> 2) & 1;
+        }
+        if (changed & SNAPSHOT_CHANGED_PACMAN) {
+            uint8_t direction = (uint8_t)next.pacmanDirection;
+            snapshotGetEntity(&reader, &next.pacmanRow, &next.pacmanCol, &direction);
+            next.pacmanDirection = (int8_t)direction;
+        }
+        for (int i = 0; i < MAX_GHOSTS; i++) {
+            if (changed & (SNAPSHOT_CHANGED_GHOST0 << i)) {
+                snapshotGetEntity(&reader, &next.ghostRow[i], &next.ghostCol[i], &next.ghostFlags[i]);
+            }
+        }
+        for (int i = 0; (changed & SNAPSHOT_CHANGED_GHOST_CELLS) && i < MAX_GHOSTS; i++) {
+            next.ghostCell[i] = (char)byteGet(&reader);
+        }
+        uint64_t changedCells = byteGetVarint(&reader);
+        int64_t cell = -1;
+        for (uint64_t i = 0; i < changedCells && !reader.error; i++) {
+            // The gap comes off the wire, so it is bounded before any arithmetic
+            uint64_t gap = byteGetVarint(&reader);
+            char value = (char)byteGet(&reader);
+            if (gap >= ROWS * COLS) {
+                reader.error = true;
+                break;
+            }
+            cell += (int64_t)gap + 1;
+            if (cell < 0 || cell >= ROWS * COLS) {
+                reader.error = true;
+                break;
+            }
+            next.board[cell / COLS][cell % COLS] = value;
+        }
+    } else {
+        reader.error = true;
+    }
+
+    if (reader.error || reader.offset != length) {
+        decoder->haveKeyframe = false;
+        return false;
+    }
+    decoder->current = next;
+    decoder->haveKeyframe = true;
+    *out = next;
+    return true;
+}
+
+// What the session server would stream for one of its games
+static void sessionCaptureSnapshot(GameSession* session, GameSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->tick = session->ticks;
+    snapshot->generation = (uint32_t)session->gamesPlayed;
+    snapshot->score = session->score;
+    snapshot->lives = session->lives;
+    snapshot->screen = session->gameRunning ? SCREEN_PLAY : SCREEN_GAME_OVER;
+    snapshot->running = session->gameRunning;
+    snapshot->ghostVulnerable = session->ghostVulnerable;
+    snapshot->pacmanRow = (int8_t)session->pacmanRow;
+    snapshot->pacmanCol = (int8_t)session->pacmanCol;
+    snapshot->pacmanDirection = (int8_t)session->currentDirection;
+    memcpy(snapshot->board, session->board, sizeof(snapshot->board));
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &session->ghosts[i];
+        snapshot->ghostRow[i] = (int8_t)ghost->row;
+        snapshot->ghostCol[i] = (int8_t)ghost->col;
+        snapshot->ghostFlags[i] = (ghost->isVulnerable ? SNAPSHOT_GHOST_VULNERABLE : 0) |
+                                  (ghost->inGhostHouse ? SNAPSHOT_GHOST_IN_HOUSE : 0) |
+                                  (ghost->needsRespawn ? SNAPSHOT_GHOST_RESPAWNING : 0);
+        snapshot->ghostCell[i] = ghost->cellContent;
+    }
+}
+
+// Plays a self-driving session on a simulated clock and records one
+// snapshot per pacman tick, so the codec is measured on real game traffic
+static GameSnapshot* codecBenchRecord(int tickCount) {
+    GameSnapshot* snapshots = malloc(sizeof(GameSnapshot) * tickCount);
+    GameSession* session = calloc(1, sizeof(GameSession));
+    if (snapshots == NULL || session == NULL) {
+        free(snapshots);
+        free(session);
+        return NULL;
+    }
+    SessionWorker worker;
+    memset(&worker, 0, sizeof(worker));
+    session->autopilot = true;
+    session->rules = sessionDefaultRules;
+    session->seed = 2024;
+    pthread_mutex_init(&session->mutex, NULL);
+    sessionReset(session);
+
+    uint64_t now = session->tickDueNs;
+    int recorded = 0;
+    while (recorded < tickCount) {
+        uint64_t ticksBefore = session->ticks;
+        sessionStep(&worker, session, now);
+        if (session->ticks != ticksBefore) {
+            sessionCaptureSnapshot(session, &snapshots[recorded++]);
+        }
+        now += SESSION_IDLE_WAIT_MS * 1000000ull;
+    }
+    pthread_mutex_destroy(&session->mutex);
+    free(session);
+    return snapshots;
+}
+
+// Truncated, padded and out-of-range frames must all be refused, whatever
+// state the decoder is in
+static bool codecRejectsMalformed(const GameSnapshot* snapshot) {
+    uint8_t key[SNAPSHOT_FRAME_MAX];
+    SnapshotEncoder encoder;
+    snapshotEncoderInit(&encoder, 1);
+    size_t keyLength = snapshotEncode(&encoder, snapshot, key, sizeof(key) - 1);
+    key[keyLength] = 0;
+
+    // A delta changing one cell whose gap is 2^64 - 2, i.e. -1 once added
+    uint8_t delta[32];
+    ByteWriter writer = { .data = delta, .length = 0, .capacity = sizeof(delta), .overflow = false };
+    bytePut(&writer, SNAPSHOT_FRAME_DELTA);
+    bytePutVarint(&writer, 1);
+    bytePutVarint(&writer, 0);
+    bytePutVarint(&writer, 1);
+    bytePutVarint(&writer, UINT64_MAX - 1);
+    bytePut(&writer, '=');
+
+    SnapshotDecoder decoder;
+    GameSnapshot decoded;
+    snapshotDecoderInit(&decoder);
+    bool rejected = !snapshotDecode(&decoder, key, keyLength - 1, &decoded) &&
+                    !snapshotDecode(&decoder, key, keyLength + 1, &decoded) &&
+                    snapshotDecode(&decoder, key, keyLength, &decoded) &&
+                    !snapshotDecode(&decoder, delta, writer.length, &decoded);
+    // The refused delta dropped the keyframe; the board it would have hit is intact
+    return rejected && !decoder.haveKeyframe &&
+           memcmp(decoder.current.board, snapshot->board, sizeof(snapshot->board)) == 0;
+}
+
+int runCodecBenchmark(int minutes) {
+    int ticksPerMinute = 60 * 1000 / SESSION_TICK_MS;
+    int tickCount = minutes * ticksPerMinute;
+    buildSessionTemplate();
+    GameSnapshot* snapshots = codecBenchRecord(tickCount);
+    uint8_t* frames = malloc((size_t)tickCount * SNAPSHOT_FRAME_MAX);
+    size_t* frameLengths = malloc(sizeof(size_t) * tickCount);
+    if (snapshots == NULL || frames == NULL || frameLengths == NULL) {
+        free(snapshots);
+        free(frames);
+        free(frameLengths);
+        return 1;
+    }
+
+    static const int keyframeIntervals[] = { 1, 25, 150, 1500 };
+    printf("=== Snapshot codec: %d minutes of play, %d ticks ===\n", minutes, tickCount);
+    printf("raw GameSnapshot %zu B (GameState %zu B), %zu KB per minute uncompressed\n",
+           sizeof(GameSnapshot), sizeof(GameState), sizeof(GameSnapshot) * ticksPerMinute / 1024);
+    printf("%8s %9s %9s %10s %9s %12s %12s %9s\n", "key every", "avg B", "delta B", "KB/min",
+           "ratio", "encode Mf/s", "decode Mf/s", "verified");
+    bool ok = true;
+    for (size_t k = 0; k < sizeof(keyframeIntervals) / sizeof(keyframeIntervals[0]); k++) {
+        SnapshotEncoder encoder;
+        size_t totalBytes = 0;
+        int encodeRounds = 0;
+        double begin = monotonicMs();
+        do {
+            snapshotEncoderInit(&encoder, keyframeIntervals[k]);
+            totalBytes = 0;
+            for (int t = 0; t < tickCount; t++) {
+                frameLengths[t] = snapshotEncode(&encoder, &snapshots[t], frames + (size_t)t * SNAPSHOT_FRAME_MAX,
+                                                 SNAPSHOT_FRAME_MAX);
+                totalBytes += frameLengths[t];
+            }
+            encodeRounds++;
+        } while (monotonicMs() - begin < 250.0);
+        double encodeMs = monotonicMs() - begin;
+
+        SnapshotDecoder decoder;
+        GameSnapshot decoded;
+        bool verified = true;
+        int decodeRounds = 0;
+        begin = monotonicMs();
+        do {
+            snapshotDecoderInit(&decoder);
+            for (int t = 0; t < tickCount; t++) {
+                bool good = snapshotDecode(&decoder, frames + (size_t)t * SNAPSHOT_FRAME_MAX, frameLengths[t], &decoded);
+                if (decodeRounds == 0 && (!good || memcmp(&decoded, &snapshots[t], sizeof(decoded)) != 0)) {
+                    verified = false;
+                }
+            }
+            decodeRounds++;
+        } while (monotonicMs() - begin < 250.0);
+        double decodeMs = monotonicMs() - begin;
+
+        uint64_t deltaFrames = encoder.frames - encoder.keyframes;
+        // Past interval 1 a stream of nothing but keyframes means the
+        // recording was not a game (an empty board resets every tick)
+        if (keyframeIntervals[k] > 1 && deltaFrames == 0) {
+            verified = false;
+        }
+        size_t keyBytes = 0;
+        for (int t = 0; t < tickCount; t++) {
+            if (frames[(size_t)t * SNAPSHOT_FRAME_MAX] == SNAPSHOT_FRAME_KEY) {
+                keyBytes += frameLengths[t];
+            }
+        }
+        double perMinute = (double)totalBytes / minutes;
+        printf("%8d %9.1f %9.1f %10.1f %8.1fx %12.2f %12.2f %9s\n", keyframeIntervals[k],
+               (double)totalBytes / tickCount,
+               deltaFrames ? (double)(totalBytes - keyBytes) / deltaFrames : 0.0,
+               perMinute / 1024, (double)sizeof(GameSnapshot) * tickCount / totalBytes,
+               (double)tickCount * encodeRounds / encodeMs / 1000.0,
+               (double)tickCount * decodeRounds / decodeMs / 1000.0,
+               verified ? "yes" : "NO");
+        ok = ok && verified;
+    }
+    bool rejected = codecRejectsMalformed(&snapshots[0]);
+    printf("malformed frames rejected: %s\n", rejected ? "yes" : "NO");
+    ok = ok && rejected;
+    free(snapshots);
+    free(frames);
+    free(frameLengths);
+    return ok ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Rewind: with PACMAN_REWIND=1 the engine keeps the last REWIND_SECONDS of
+// play as codec frames. While paused, [ and ] step one tick back or forward
+// and the game is put in that tick; resuming plays on from there and the
+// frames after it are dropped.
+// ---------------------------------------------------------------------------
+bool rewindInit(int seconds, int kilobytes) {
+    RewindBuffer* rewind = &rewindBuffer;
+    memset(rewind, 0, sizeof(*rewind));
+    rewind->windowTicks = seconds * 1000 / SESSION_TICK_MS;
+    // Room for two worst-case frames, so the newest group always fits
+    rewind->byteCapacity = (size_t)kilobytes * 1024;
+    if (rewind->byteCapacity < 2 * SNAPSHOT_FRAME_MAX) {
+        rewind->byteCapacity = 2 * SNAPSHOT_FRAME_MAX;
+    }
+    rewind->frameCapacity = rewind->windowTicks + REWIND_KEYFRAME_TICKS + 1;
+    rewind->bytes = malloc(rewind->byteCapacity);
+    rewind->frames = malloc(sizeof(RewindFrame) * rewind->frameCapacity);
+    if (rewind->bytes == NULL || rewind->frames == NULL) {
+        LOG_WARN("Could not allocate the rewind buffer");
+        rewindDestroy();
+        return false;
+    }
+    snapshotEncoderInit(&rewind->encoder, REWIND_KEYFRAME_TICKS);
+    rewind->enabled = true;
+    LOG_INFO("Rewind buffer: %d s, %zu KB of frames", seconds, rewind->byteCapacity / 1024);
+    return true;
+}
+
+void rewindDestroy() {
+    free(rewindBuffer.bytes);
+    free(rewindBuffer.frames);
+    rewindBuffer.bytes = NULL;
+    rewindBuffer.frames = NULL;
+    rewindBuffer.enabled = false;
+}
+
+static inline RewindFrame* rewindFrameAt(RewindBuffer* rewind, int index) {
+    return &rewind->frames[(rewind->first + index) % rewind->frameCapacity];
+}
+
+// Frames in the oldest group: its keyframe and the deltas that need it
+static int rewindGroupLength(RewindBuffer* rewind) {
+    int length = 1;
+    while (length < rewind->count && !rewindFrameAt(rewind, length)->keyframe) {
+        length++;
+    }
+    return length;
+}
+
+static void rewindEvictGroup(RewindBuffer* rewind) {
+    int length = rewindGroupLength(rewind);
+    rewind->first = (rewind->first + length) % rewind->frameCapacity;
+    rewind->count -= length;
+    rewind->evictedFrames += length;
+    if (rewind->count == 0) {
+        rewind->byteHead = 0;
+        rewind->byteTail = 0;
+    } else {
+        rewind->byteTail = rewindFrameAt(rewind, 0)->offset;
+    }
+}
+
+// Evicts whatever the frame for tick needs gone and returns where it goes.
+// Space is reserved for a worst-case frame, so it is known before encoding
+// whether the delta's base survived.
+static size_t rewindReserve(RewindBuffer* rewind, uint64_t tick) {
+    // Older groups go once the rest still reaches back the whole window
+    while (rewind->count > 0) {
+        int length = rewindGroupLength(rewind);
+        if (length == rewind->count || tick - rewindFrameAt(rewind, length)->tick < (uint64_t)rewind->windowTicks) {
+            break;
+        }
+        rewindEvictGroup(rewind);
+    }
+    while (rewind->count == rewind->frameCapacity) {
+        rewindEvictGroup(rewind);
+    }
+
+    // Frames never straddle the end; the gap left there is skipped
+    while (rewind->count > 0) {
+        if (rewind->byteHead > rewind->byteTail) {
+            if (rewind->byteHead + SNAPSHOT_FRAME_MAX <= rewind->byteCapacity) {
+                return rewind->byteHead;
+            }
+            if (SNAPSHOT_FRAME_MAX <= rewind->byteTail) {
+                return 0;
+            }
+        } else if (rewind->byteHead + SNAPSHOT_FRAME_MAX <= rewind->byteTail) {
+            return rewind->byteHead;
+        }
+        rewindEvictGroup(rewind);
+    }
+    return 0;
+}
+
+// Forgets the newest frames after play resumes from a rewound tick
+static void rewindTruncate(RewindBuffer* rewind, int dropCount) {
+    rewind->count -= dropCount;
+    rewind->evictedFrames += dropCount;
+    RewindFrame* newest = rewindFrameAt(rewind, rewind->count - 1);
+    rewind->byteHead = newest->offset + newest->length;
+    rewind->nextTick = newest->tick + 1;
+    // The encoder's previous frame was one of the dropped ones
+    snapshotEncoderInit(&rewind->encoder, REWIND_KEYFRAME_TICKS);
+    rewind->cursor = 0;
+}
+
+// Called by the engine at the end of every played tick. Fills snapshot so
+// the spectator stream can reuse it.
+void rewindCapture(GameSnapshot* snapshot) {
+    RewindBuffer* rewind = &rewindBuffer;
+    uint64_t startNs = monotonicNs();
+    captureGameSnapshot(snapshot);
+    if (rewind->cursor > 0) {
+        rewindTruncate(rewind, rewind->cursor);
+    }
+    rewind->cursor = 0;
+    snapshot->tick = rewind->nextTick++;
+
+    size_t offset = rewindReserve(rewind, snapshot->tick);
+    if (rewind->count == 0) {
+        snapshotEncoderInit(&rewind->encoder, REWIND_KEYFRAME_TICKS);
+    }
+    size_t length = snapshotEncode(&rewind->encoder, snapshot, rewind->bytes + offset, SNAPSHOT_FRAME_MAX);
+    if (length == 0) {
+        // Nothing was stored, so the next frame cannot be a delta on this one
+        snapshotEncoderInit(&rewind->encoder, REWIND_KEYFRAME_TICKS);
+        rewind->dropped++;
+    } else {
+        RewindFrame* frame = rewindFrameAt(rewind, rewind->count);
+        frame->tick = snapshot->tick;
+        frame->offset = (uint32_t)offset;
+        frame->length = (uint32_t)length;
+        frame->keyframe = rewind->bytes[offset] == SNAPSHOT_FRAME_KEY;
+        if (rewind->count == 0) {
+            rewind->byteTail = offset;
+        }
+        rewind->count++;
+        rewind->byteHead = offset + length;
+    }
+
+    uint64_t elapsedNs = monotonicNs() - startNs;
+    rewind->captures++;
+    rewind->captureNsTotal += elapsedNs;
+    if (elapsedNs > rewind->captureNsMax) {
+        rewind->captureNsMax = elapsedNs;
+    }
+    rewind->captureHistogram[latencyBucket(elapsedNs)]++;
+}
+
+// Decodes the tick ticksBack before the newest into out, starting from the
+// closest keyframe at or before it. False if the buffer does not reach back
+// that far.
+bool rewindSeek(RewindBuffer* rewind, int ticksBack, GameSnapshot* out) {
+    if (ticksBack < 0 || ticksBack >= rewind->count) {
+        return false;
+    }
+    int target = rewind->count - 1 - ticksBack;
+    int start = target;
+    while (start > 0 && !rewindFrameAt(rewind, start)->keyframe) {
+        start--;
+    }
+    SnapshotDecoder decoder;
+    snapshotDecoderInit(&decoder);
+    for (int i = start; i <= target; i++) {
+        RewindFrame* frame = rewindFrameAt(rewind, i);
+        if (!snapshotDecode(&decoder, rewind->bytes + frame->offset, frame->length, out)) {
+            return false;
+        }
+    }
+    rewind->seeks++;
+    return true;
+}
+
+// Puts the game into a rewound tick the way resetSession() starts a new one:
+// house resources and boosts are handed back first, then everything changes
+// under gameState.mutex and the whole board with a generation bump, so a
+// ghost move planned before the rewind is dropped
+void rewindRestore(const GameSnapshot* snapshot) {
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        releaseGhostHouseResources(&ghosts[i]);
+        returnSpeedBoost(&ghosts[i]);
+    }
+
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    memcpy(gameState.board, snapshot->board, sizeof(gameState.board));
+    gameState.score = snapshot->score;
+    gameState.lives = snapshot->lives;
+    gameState.pacmanRow = snapshot->pacmanRow;
+    gameState.pacmanCol = snapshot->pacmanCol;
+    gameState.currentDirection = (Direction)snapshot->pacmanDirection;
+    switch (gameState.currentDirection) {
+        case DIR_UP: gameState.pacmanRotation = 270.0f; break;
+        case DIR_DOWN: gameState.pacmanRotation = 90.0f; break;
+        case DIR_LEFT: gameState.pacmanRotation = 180.0f; break;
+        case DIR_RIGHT: gameState.pacmanRotation = 0.0f; break;
+        default: break;
+    }
+    // Timers are not in the snapshot; a rewound power pellet starts over
+    gameState.ghostVulnerable = snapshot->ghostVulnerable;
+    gameState.powerPelletActive = snapshot->ghostVulnerable;
+    gameState.ghostVulnerableDuration = 0.0f;
+    gameState.powerPelletDuration = 0.0f;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        ghosts[i].row = snapshot->ghostRow[i];
+        ghosts[i].col = snapshot->ghostCol[i];
+        ghosts[i].direction = DIR_NONE;
+        ghosts[i].isVulnerable = (snapshot->ghostFlags[i] & SNAPSHOT_GHOST_VULNERABLE) != 0;
+        ghosts[i].inGhostHouse = (snapshot->ghostFlags[i] & SNAPSHOT_GHOST_IN_HOUSE) != 0;
+        ghosts[i].needsRespawn = (snapshot->ghostFlags[i] & SNAPSHOT_GHOST_RESPAWNING) != 0;
+        ghosts[i].cellContent = snapshot->ghostCell[i];
+    }
+    recountPelletsLocked();
+    atomic_fetch_add_explicit(&gameState.generation, 1, memory_order_release);
+    publishPacmanView();
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+// Engine side of EVENT_REWIND_STEP: moves the cursor ticksBack ticks into
+// the past (negative steps forward again). Only while paused in play.
+void rewindStep(int ticksBack) {
+    RewindBuffer* rewind = &rewindBuffer;
+    if (!rewind->enabled || rewind->count == 0) {
+        return;
+    }
+    MUTEX_LOCK(gameState.mutex);
+    bool paused = gameState.gamePaused;
+    MUTEX_UNLOCK(gameState.mutex);
+    MUTEX_LOCK(uiState.mutex);
+    bool isPlayScreen = (uiState.currentScreen == SCREEN_PLAY);
+    MUTEX_UNLOCK(uiState.mutex);
+    if (!paused || !isPlayScreen) {
+        return;
+    }
+
+    int cursor = rewind->cursor + ticksBack;
+    cursor = cursor < 0 ? 0 : cursor;
+    cursor = cursor > rewind->count - 1 ? rewind->count - 1 : cursor;
+    GameSnapshot snapshot;
+    if (!rewindSeek(rewind, cursor, &snapshot)) {
+        LOG_WARN("Could not decode the rewind frame %d ticks back", cursor);
+        return;
+    }
+    rewind->cursor = cursor;
+    rewindRestore(&snapshot);
+    LOG_DEBUG("Rewound to %d ticks back (%.1f s)", cursor, cursor * SESSION_TICK_MS / 1000.0);
+}
+
+// Call once the engine is joined
+void printRewindReport() {
+    RewindBuffer* rewind = &rewindBuffer;
+    if (!rewind->enabled) {
+        return;
+    }
+    size_t heldBytes = 0;
+    int keyframes = 0;
+    for (int i = 0; i < rewind->count; i++) {
+        heldBytes += rewindFrameAt(rewind, i)->length;
+        keyframes += rewindFrameAt(rewind, i)->keyframe ? 1 : 0;
+    }
+    printf("\n=== Rewind buffer ===\n");
+    printf("window %.0f s (%d ticks), memory %zu KB frames + %zu KB index\n",
+           rewind->windowTicks * SESSION_TICK_MS / 1000.0, rewind->windowTicks,
+           rewind->byteCapacity / 1024, sizeof(RewindFrame) * rewind->frameCapacity / 1024);
+    printf("holding %d ticks (%.1f s) in %.1f KB, %d keyframes; evicted %llu, dropped %llu, seeks %llu\n",
+           rewind->count, rewind->count * SESSION_TICK_MS / 1000.0, heldBytes / 1024.0, keyframes,
+           (unsigned long long)rewind->evictedFrames, (unsigned long long)rewind->dropped,
+           (unsigned long long)rewind->seeks);
+    printf("capture: %llu ticks, avg %.1f us, p50 %llu us, p99 %llu us, max %.1f us\n",
+           (unsigned long long)rewind->captures,
+           rewind->captures ? rewind->captureNsTotal / 1e3 / rewind->captures : 0.0,
+           (unsigned long long)latencyPercentileUs(rewind->captureHistogram, rewind->captures, 0.50),
+           (unsigned long long)latencyPercentileUs(rewind->captureHistogram, rewind->captures, 0.99),
+           rewind->captureNsMax / 1e3);
+}
+
+// ---------------------------------------------------------------------------
+// Save states: F5 writes the running game to PACMAN_SAVE_FILE (savegame.bin)
+// and F9 or ./game --resume [file] puts it back. The file is one SaveState,
+// so saving is a copy under the game locks plus a single write.
+// ---------------------------------------------------------------------------
+// FNV-1a over everything after the header
+static uint32_t saveChecksum(const SaveState* save) {
+    const uint8_t* bytes = (const uint8_t*)save + sizeof(save->header);
+    size_t length = sizeof(*save) - sizeof(save->header);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// The game locks in their usual order, then the house and boost pools, so
+// positions, resources and boosts are all from the same instant
+static void lockWholeGame() {
+    MUTEX_LOCK(gameState.mutex);
+    lockWholeBoard();
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        MUTEX_LOCK(ghostHouses[h].mutex);
+    }
+    MUTEX_LOCK(speedBoostAvailMutex);
+}
+
+static void unlockWholeGame() {
+    MUTEX_UNLOCK(speedBoostAvailMutex);
+    for (int h = MAX_GHOST_HOUSES - 1; h >= 0; h--) {
+        MUTEX_UNLOCK(ghostHouses[h].mutex);
+    }
+    unlockWholeBoard();
+    MUTEX_UNLOCK(gameState.mutex);
+}
+
+void captureSaveState(SaveState* save) {
+    memset(save, 0, sizeof(*save));
+    lockWholeGame();
+    uint64_t now = monotonicNs();
+    memcpy(save->board, gameState.board, sizeof(save->board));
+    memcpy(save->originalBoard, gameState.originalBoard, sizeof(save->originalBoard));
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            save->powerPelletLocations[row][col] = gameState.powerPelletLocations[row][col];
+        }
+    }
+    save->score = gameState.score;
+    save->lives = gameState.lives;
+    save->level = gameState.level;
+    save->pacmanRow = gameState.pacmanRow;
+    save->pacmanCol = gameState.pacmanCol;
+    save->pacmanStartRow = gameState.pacmanStartRow;
+    save->pacmanStartCol = gameState.pacmanStartCol;
+    save->direction = gameState.currentDirection;
+    save->pacmanRotation = gameState.pacmanRotation;
+    save->powerPelletActive = gameState.powerPelletActive;
+    save->ghostVulnerable = gameState.ghostVulnerable;
+    save->powerPelletDuration = gameState.powerPelletDuration;
+    save->ghostVulnerableDuration = gameState.ghostVulnerableDuration;
+
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        SavedGhost* saved = &save->ghosts[i];
+        saved->row = (int8_t)ghost->row;
+        saved->col = (int8_t)ghost->col;
+        saved->respawnRow = (int8_t)ghost->respawnRow;
+        saved->respawnCol = (int8_t)ghost->respawnCol;
+        saved->direction = (int8_t)ghost->direction;
+        saved->cellContent = ghost->cellContent;
+        saved->flags = (ghost->isVulnerable ? SAVE_GHOST_VULNERABLE : 0) |
+                       (ghost->needsRespawn ? SAVE_GHOST_RESPAWNING : 0) |
+                       (ghost->inGhostHouse ? SAVE_GHOST_IN_HOUSE : 0) |
+                       (ghost->hasKey ? SAVE_GHOST_KEY : 0) |
+                       (ghost->hasExitPermit ? SAVE_GHOST_PERMIT : 0) |
+                       (ghost->hasSpeedBoost ? SAVE_GHOST_BOOSTED : 0);
+        saved->houseId = (uint8_t)ghost->houseId;
+        saved->baseIntervalMs = ghost->baseIntervalMs;
+        // Monotonic times mean nothing after a restart; keep what is left
+        saved->boostRemainingNs = ghost->hasSpeedBoost && ghost->boostEndNs > now ? ghost->boostEndNs - now : 0;
+        saved->rngSeed = ghost->rngSeed;
+    }
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        GhostHouse* house = &ghostHouses[h];
+        save->houseQueueLength[h] = (uint8_t)house->queueLength;
+        for (int i = 0; i < house->queueLength; i++) {
+            save->houseQueue[h][i] = (uint8_t)house->queue[(house->queueHead + i) % MAX_GHOSTS];
+        }
+    }
+    save->boostTokens = boostScheduler.tokens;
+    save->boostNextGhost = boostScheduler.nextGhost;
+    unlockWholeGame();
+
+    save->header.magic = SAVE_MAGIC;
+    save->header.version = SAVE_VERSION;
+    save->header.size = sizeof(*save);
+    save->header.checksum = saveChecksum(save);
+}
+
+// Rejects anything that would break the board or the resource accounting
+// before the game is touched. The checksum only catches accidents: anyone
+// editing a save can recompute it, so every index is range-checked here.
+static bool validateSaveState(const SaveState* save, const char** reason) {
+    if (save->header.magic != SAVE_MAGIC || save->header.version != SAVE_VERSION ||
+        save->header.size != sizeof(*save)) {
+        *reason = "not a save from this build";
+        return false;
+    }
+    if (save->header.checksum != saveChecksum(save)) {
+        *reason = "checksum mismatch";
+        return false;
+    }
+    if (save->pacmanRow < 0 || save->pacmanRow >= ROWS || save->pacmanCol < 0 || save->pacmanCol >= COLS ||
+        save->direction < DIR_NONE || save->direction > DIR_RIGHT) {
+        *reason = "pacman out of range";
+        return false;
+    }
+    // A death puts pacman back on his start cell
+    if (save->pacmanStartRow < 0 || save->pacmanStartRow >= ROWS ||
+        save->pacmanStartCol < 0 || save->pacmanStartCol >= COLS) {
+        *reason = "pacman start out of range";
+        return false;
+    }
+    int pacmanCells = 0;
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            pacmanCells += save->board[row][col] == '@';
+        }
+    }
+    if (pacmanCells != 1 || save->board[save->pacmanRow][save->pacmanCol] != '@') {
+        *reason = "pacman is not where the save says";
+        return false;
+    }
+    if (save->lives <= 0) {
+        *reason = "no lives left";
+        return false;
+    }
+    if (save->level < 1 || save->level > LEVEL_MAX) {
+        *reason = "no such level";
+        return false;
+    }
+    int keys[MAX_GHOST_HOUSES] = {0};
+    int permits[MAX_GHOST_HOUSES] = {0};
+    int boosts = 0;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        const SavedGhost* saved = &save->ghosts[i];
+        if (saved->row < 0 || saved->row >= ROWS || saved->col < 0 || saved->col >= COLS ||
+            saved->respawnRow < 0 || saved->respawnRow >= ROWS || saved->respawnCol < 0 ||
+            saved->respawnCol >= COLS || saved->houseId >= MAX_GHOST_HOUSES ||
+            saved->direction < DIR_NONE || saved->direction > DIR_RIGHT || saved->baseIntervalMs <= 0) {
+            *reason = "ghost out of range";
+            return false;
+        }
+        if (save->board[saved->row][saved->col] == '=' ||
+            save->board[saved->respawnRow][saved->respawnCol] == '=' || saved->cellContent == '=') {
+            *reason = "ghost in a wall";
+            return false;
+        }
+        keys[saved->houseId] += (saved->flags & SAVE_GHOST_KEY) ? 1 : 0;
+        permits[saved->houseId] += (saved->flags & SAVE_GHOST_PERMIT) ? 1 : 0;
+        boosts += (saved->flags & SAVE_GHOST_BOOSTED) ? 1 : 0;
+    }
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        if (keys[h] > GHOST_HOUSE_KEYS || permits[h] > GHOST_HOUSE_PERMITS ||
+            save->houseQueueLength[h] > MAX_GHOSTS) {
+            *reason = "house resources over their totals";
+            return false;
+        }
+        bool queued[MAX_GHOSTS] = {false};
+        for (int i = 0; i < save->houseQueueLength[h]; i++) {
+            int id = save->houseQueue[h][i];
+            if (id >= MAX_GHOSTS || queued[id] || save->ghosts[id].houseId != h) {
+                *reason = "corrupt house queue";
+                return false;
+            }
+            queued[id] = true;
+        }
+    }
+    if (boosts > BOOST_SLOTS || save->boostNextGhost < 0 || save->boostNextGhost >= MAX_GHOSTS) {
+        *reason = "boosts over their total";
+        return false;
+    }
+    // Written this way round so a NaN fails too
+    if (!(save->boostTokens >= 0.0 && save->boostTokens <= BOOST_BUCKET_CAPACITY)) {
+        *reason = "boost tokens over the bucket";
+        return false;
+    }
+    return true;
+}
+
+// Puts a validated save into the running game. Ghost threads keep running:
+// everything they hold is handed back and re-granted from the save under all
+// the game locks, and the generation bump drops any move planned before.
+void restoreSaveState(const SaveState* save) {
+    lockWholeGame();
+    uint64_t now = monotonicNs();
+
+    // Return every key, permit, ticket and boost through the ledgers first,
+    // so the counts the save re-grants start from full pools
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        GhostHouse* house = &ghostHouses[ghost->houseId];
+        if (ghost->hasKey) ledgerGive(&house->keys, ghost->id);
+        if (ghost->hasExitPermit) ledgerGive(&house->permits, ghost->id);
+        ghost->hasKey = false;
+        ghost->hasExitPermit = false;
+        ghost->queuedForHouse = false;
+        if (ghost->hasSpeedBoost) {
+            endSpeedBoost(ghost, now);
+        }
+    }
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        ghostHouses[h].queueHead = 0;
+        ghostHouses[h].queueLength = 0;
+    }
+
+    memcpy(gameState.board, save->board, sizeof(gameState.board));
+    memcpy(gameState.originalBoard, save->originalBoard, sizeof(gameState.originalBoard));
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            gameState.powerPelletLocations[row][col] = save->powerPelletLocations[row][col] != 0;
+        }
+    }
+    gameState.score = save->score;
+    gameState.lives = save->lives;
+    gameState.level = save->level;
+    gameState.pacmanRow = save->pacmanRow;
+    gameState.pacmanCol = save->pacmanCol;
+    gameState.pacmanStartRow = save->pacmanStartRow;
+    gameState.pacmanStartCol = save->pacmanStartCol;
+    gameState.currentDirection = (Direction)save->direction;
+    gameState.pacmanRotation = save->pacmanRotation;
+    gameState.powerPelletActive = save->powerPelletActive;
+    gameState.ghostVulnerable = save->ghostVulnerable;
+    gameState.powerPelletDuration = save->powerPelletDuration;
+    gameState.ghostVulnerableDuration = save->ghostVulnerableDuration;
+    gameState.gameRunning = true;
+    // A resumed game waits for P, so nobody dies before they are ready
+    gameState.gamePaused = true;
+
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        Ghost* ghost = &ghosts[i];
+        const SavedGhost* saved = &save->ghosts[i];
+        GhostHouse* house = &ghostHouses[saved->houseId];
+        ghost->row = saved->row;
+        ghost->col = saved->col;
+        ghost->respawnRow = saved->respawnRow;
+        ghost->respawnCol = saved->respawnCol;
+        ghost->direction = (Direction)saved->direction;
+        ghost->cellContent = saved->cellContent;
+        ghost->isVulnerable = (saved->flags & SAVE_GHOST_VULNERABLE) != 0;
+        ghost->needsRespawn = (saved->flags & SAVE_GHOST_RESPAWNING) != 0;
+        ghost->inGhostHouse = (saved->flags & SAVE_GHOST_IN_HOUSE) != 0;
+        ghost->houseId = saved->houseId;
+        ghost->baseIntervalMs = saved->baseIntervalMs;
+        ghost->rngSeed = saved->rngSeed;
+        if (saved->flags & SAVE_GHOST_KEY) {
+            ledgerTake(&house->keys, ghost->id);
+            ghost->hasKey = true;
+        }
+        if (saved->flags & SAVE_GHOST_PERMIT) {
+            ledgerTake(&house->permits, ghost->id);
+            ghost->hasExitPermit = true;
+        }
+        if ((saved->flags & SAVE_GHOST_BOOSTED) && ledgerTake(&boostLedger, ghost->id)) {
+            ghost->hasSpeedBoost = true;
+            ghost->boostStartNs = now;
+            ghost->boostEndNs = now + saved->boostRemainingNs;
+            ghost->speedBoostDuration = saved->boostRemainingNs / 1e9f;
+            atomic_store(&ghost->moveTimer.intervalMs, ghost->baseIntervalMs / 2);
+        } else {
+            atomic_store(&ghost->moveTimer.intervalMs, ghost->baseIntervalMs);
+        }
+    }
+    // Tickets keep their order; wait times restart from now
+    for (int h = 0; h < MAX_GHOST_HOUSES; h++) {
+        GhostHouse* house = &ghostHouses[h];
+        for (int i = 0; i < save->houseQueueLength[h]; i++) {
+            Ghost* ghost = &ghosts[save->houseQueue[h][i]];
+            house->queue[i] = ghost->id;
+            ghost->queuedForHouse = true;
+            ghost->houseRequestNs = now;
+        }
+        house->queueLength = save->houseQueueLength[h];
+        ghostHouseGrantWaiting(house, ghosts);
+    }
+    boostScheduler.tokens = save->boostTokens;
+    boostScheduler.nextGhost = save->boostNextGhost;
+    boostScheduler.lastRefillNs = now;
+    recountPelletsLocked();
+
+    atomic_fetch_add_explicit(&gameState.generation, 1, memory_order_release);
+    publishPacmanView();
+    unlockWholeGame();
+
+    MUTEX_LOCK(uiState.mutex);
+    uiState.currentScreen = SCREEN_PLAY;
+    uiState.needsRedraw = true;
+    MUTEX_UNLOCK(uiState.mutex);
+}
+
+// Written to a temporary name and renamed, so a crash mid-save leaves the
+// previous save intact
+bool saveGame(const char* path) {
+    uint64_t startNs = monotonicNs();
+    SaveState save;
+    captureSaveState(&save);
+    uint64_t capturedNs = monotonicNs();
+
+    char tempPath[512];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    int fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_WARN("Could not save to %s: %s", tempPath, strerror(errno));
+        return false;
+    }
+    bool written = write(fd, &save, sizeof(save)) == (ssize_t)sizeof(save) && fdatasync(fd) == 0;
+    close(fd);
+    if (!written || rename(tempPath, path) != 0) {
+        LOG_WARN("Could not save to %s: %s", path, strerror(errno));
+        unlink(tempPath);
+        return false;
+    }
+    LOG_INFO("Saved game to %s: %zu bytes, captured in %.1f us, written in %.2f ms", path, sizeof(save),
+             (capturedNs - startNs) / 1e3, (monotonicNs() - capturedNs) / 1e6);
+    return true;
+}
+
+bool loadGame(const char* path) {
+    uint64_t startNs = monotonicNs();
+    SaveState save;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        LOG_WARN("Could not open save %s: %s", path, strerror(errno));
+        return false;
+    }
+    ssize_t got = read(fd, &save, sizeof(save));
+    char extra;
+    bool exact = got == (ssize_t)sizeof(save) && read(fd, &extra, 1) == 0;
+    close(fd);
+    const char* reason = "wrong size";
+    if (!exact || !validateSaveState(&save, &reason)) {
+        LOG_WARN("Ignoring save %s: %s", path, reason);
+        return false;
+    }
+    uint64_t readNs = monotonicNs();
+    restoreSaveState(&save);
+    LOG_INFO("Restored %s (score %d, lives %d): read in %.2f ms, restored in %.1f us", path, save.score,
+             save.lives, (readNs - startNs) / 1e6, (monotonicNs() - readNs) / 1e3);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Input sources: PACMAN_INPUT=bot lets a built-in player steer pacman, and
+// ./game --bench-bot [seconds] runs the real engine and ghost threads with
+// it and no window. A source runs on its own thread and steers only through
+// addInputEvent(), as processInput() does for the keyboard.
+// ---------------------------------------------------------------------------
+static bool botPreyAt(const BotView* view, int row, int col) {
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        if (view->ghostPrey[i] && view->ghostRow[i] == row && view->ghostCol[i] == col) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// movePacman() costs a life on any '#' that is not a vulnerable ghost, and
+// the maze itself has '#' blocks, so only prey makes a '#' enterable
+static inline bool botPacmanCanEnter(const BotView* view, int row, int col) {
+    return view->board[row][col] != '=' && !isInGhostHouse(row, col) &&
+           (view->board[row][col] != '#' || botPreyAt(view, row, col));
+}
+
+// Breadth-first search from pacman for the nearest pellet or vulnerable
+// ghost; returns the first step towards it, or DIR_NONE. With safeOnly it
+// walks only cells within BOT_SAFETY_HORIZON that pacman reaches
+// BOT_SAFETY_MARGIN steps ahead of any ghost. order is the neighbour order,
+// current heading first.
+static Direction botPathToTarget(const BotView* view, int16_t ghostDistance[ROWS][COLS],
+                                 const Direction* order, int orderCount, bool safeOnly) {
+    int16_t pacmanDistance[ROWS][COLS];
+    uint8_t firstStep[ROWS][COLS];
+    int queue[ROWS * COLS];
+    int head = 0;
+    int tail = 0;
+    memset(pacmanDistance, 0xFF, sizeof(pacmanDistance));
+    pacmanDistance[view->pacmanRow][view->pacmanCol] = 0;
+    queue[tail++] = view->pacmanRow * COLS + view->pacmanCol;
+    while (head < tail) {
+        int row = queue[head] / COLS;
+        int col = queue[head++] % COLS;
+        for (int i = 0; i < orderCount; i++) {
+            Direction d = order[i];
+            int next = cellNeighbor(view->neighbors, row, col, d);
+            if (next < 0) {
+                continue;
+            }
+            int nextRow = next / COLS;
+            int nextCol = next % COLS;
+            if (!botPacmanCanEnter(view, nextRow, nextCol) || pacmanDistance[nextRow][nextCol] >= 0) {
+                continue;
+            }
+            int distance = pacmanDistance[row][col] + 1;
+            bool safe = distance > BOT_SAFETY_HORIZON ||
+                        ghostDistance[nextRow][nextCol] > distance + BOT_SAFETY_MARGIN;
+            if (safeOnly && !safe) {
+                continue;
+            }
+            pacmanDistance[nextRow][nextCol] = (int16_t)distance;
+            firstStep[nextRow][nextCol] = distance == 1 ? d : firstStep[row][col];
+            char cell = view->board[nextRow][nextCol];
+            if (cell == '.' || cell == '0' || cell == '#') {
+                return (Direction)firstStep[nextRow][nextCol];
+            }
+            queue[tail++] = nextRow * COLS + nextCol;
+        }
+    }
+    return DIR_NONE;
+}
+
+// Greedy pellet seeking with ghost avoidance. A breadth-first search from
+// every dangerous ghost gives how soon a ghost can be on each cell; pacman
+// then heads for the nearest target it can reach safely. With none it steps
+// to the open cell furthest from a ghost (fled is set), and when cornered it
+// goes for the nearest target anyway: ghosts never step onto pacman here, so
+// waiting would be safe for ever and exercise nothing.
+Direction botChooseDirection(const BotView* view, bool* fled) {
+    int16_t ghostDistance[ROWS][COLS];
+    int queue[ROWS * COLS];
+    int head = 0;
+    int tail = 0;
+    *fled = false;
+
+    for (int row = 0; row < ROWS; row++) {
+        for (int col = 0; col < COLS; col++) {
+            ghostDistance[row][col] = INT16_MAX;
+        }
     }
-   
-    sfText* backText = sfText_create();
-    sfText_setFont(backText, font);
-    sfText_setString(backText, "Press ESC to return to menu");
-    sfText_setCharacterSize(backText, 20);
-    sfText_setFillColor(backText, sfColor_fromRGB(180, 180, 180));
-   
-    sfFloatRect backBounds = sfText_getLocalBounds(backText);
-    sfText_setPosition(backText, (sfVector2f){
-        (WINDOW_WIDTH - backBounds.width) / 2,
-        WINDOW_HEIGHT * 0.9f
-    });
-   
-    sfRenderWindow_drawText(window, backText, NULL);
-   
-    sfText_destroy(titleText);
-    sfText_destroy(backText);
-    sfRenderWindow_display(window);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        int row = view->ghostRow[i];
+        int col = view->ghostCol[i];
+        if (view->ghostDangerous[i] && row >= 0 && row < ROWS && col >= 0 && col < COLS &&
+            ghostDistance[row][col] != 0) {
+            ghostDistance[row][col] = 0;
+            queue[tail++] = row * COLS + col;
+        }
+    }
+    while (head < tail) {
+        int row = queue[head] / COLS;
+        int col = queue[head++] % COLS;
+        for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+            int next = cellNeighbor(view->neighbors, row, col, (Direction)d);
+            if (next < 0) {
+                continue;
+            }
+            int nextRow = next / COLS;
+            int nextCol = next % COLS;
+            if (view->board[nextRow][nextCol] == '=' || ghostDistance[nextRow][nextCol] != INT16_MAX) {
+                continue;
+            }
+            ghostDistance[nextRow][nextCol] = ghostDistance[row][col] + 1;
+            queue[tail++] = nextRow * COLS + nextCol;
+        }
+    }
+
+    // Neighbours are tried in the current heading first, so ties keep going
+    // the same way instead of dithering
+    Direction order[4];
+    int orderCount = 0;
+    if (view->direction != DIR_NONE) {
+        order[orderCount++] = view->direction;
+    }
+    for (int d = DIR_UP; d <= DIR_RIGHT; d++) {
+        if (d != (int)view->direction) {
+            order[orderCount++] = (Direction)d;
+        }
+    }
+
+    Direction direction = botPathToTarget(view, ghostDistance, order, orderCount, true);
+    if (direction != DIR_NONE) {
+        return direction;
+    }
+    *fled = true;
+    int bestDistance = ghostDistance[view->pacmanRow][view->pacmanCol];
+    for (int i = 0; i < orderCount; i++) {
+        int next = cellNeighbor(view->neighbors, view->pacmanRow, view->pacmanCol, order[i]);
+        if (next < 0) {
+            continue;
+        }
+        int nextRow = next / COLS;
+        int nextCol = next % COLS;
+        if (botPacmanCanEnter(view, nextRow, nextCol) && ghostDistance[nextRow][nextCol] > bestDistance) {
+            direction = order[i];
+            bestDistance = ghostDistance[nextRow][nextCol];
+        }
+    }
+    if (direction != DIR_NONE) {
+        return direction;
+    }
+    return botPathToTarget(view, ghostDistance, order, orderCount, false);
 }
 
-void renderGame(sfRenderWindow* window, sfRectangleShape* wall, sfCircleShape* dot,
-               sfCircleShape* powerPellet, sfSprite* pacmanSprite, sfSprite* ghost1Sprite,
-               sfSprite* ghost2Sprite, sfSprite* ghost3Sprite, sfSprite* ghost4Sprite,
-               sfSprite* ghost5Sprite, sfText* scoreText, sfText* livesText,
-               sfSprite* lifeSprite)
-{
-    sfRenderWindow_clear(window, sfBlack);
-    pthread_mutex_lock(&gameState.mutex);
-   
-    for (int i = 0; i < ROWS; i++) {
-        for (int j = 0; j < COLS; j++) {
-            float x = j * CELL_SIZE;
-            float y = i * CELL_SIZE;
-           
-            switch(gameState.board[i][j]) {
-                case '=':
-                    sfRectangleShape_setPosition(wall, (sfVector2f){x, y});
-                    sfRenderWindow_drawRectangleShape(window, wall, NULL);
-                    break;
-                case '.':
-                    sfCircleShape_setPosition(dot, (sfVector2f){x + CELL_SIZE/2 - 3, y + CELL_SIZE/2 - 3});
-                    sfRenderWindow_drawCircleShape(window, dot, NULL);
-                    break;
-                case '0':
-                    if (pelletVisible) {
-                        sfCircleShape_setPosition(powerPellet, (sfVector2f){x + CELL_SIZE/2 - 13, y + CELL_SIZE/2 - 13});
-                        sfRenderWindow_drawCircleShape(window, powerPellet, NULL);
-                    }
-                    break;
-                case '@':
-                    sfSprite_setPosition(pacmanSprite, (sfVector2f){x + CELL_SIZE/2, y + CELL_SIZE/2});
-                    sfSprite_setRotation(pacmanSprite, gameState.pacmanRotation);
-                    sfRenderWindow_drawSprite(window, pacmanSprite, NULL);
-                    break;
-                case '#':
-                    for (int g = 0; g < MAX_GHOSTS; g++) {
-                        if (ghosts[g].row == i && ghosts[g].col == j) {
-                            sfSprite* currentGhostSprite;
-                           
-                            if (ghosts[g].isVulnerable) {
-                                currentGhostSprite = ghost5Sprite;
-                            } else {
-                                switch (ghosts[g].ghostType) {
-                                    case 1: currentGhostSprite = ghost1Sprite; break;
-                                    case 2: currentGhostSprite = ghost2Sprite; break;
-                                    case 3: currentGhostSprite = ghost3Sprite; break;
-                                    case 4: currentGhostSprite = ghost4Sprite; break;
-                                    default: currentGhostSprite = ghost1Sprite;
-                                }
-                            }
-                           
-                            sfSprite_setPosition(currentGhostSprite, (sfVector2f){x + CELL_SIZE/2, y + CELL_SIZE/2});
-                            sfRenderWindow_drawSprite(window, currentGhostSprite, NULL);
-                            break;
-                        }
-                    }
-                    break;
+static void botPoll(InputSource* source) {
+    BotState* bot = (BotState*)source->state;
+    GameSnapshot snapshot;
+    captureGameSnapshot(&snapshot);
+    bot->polls++;
+
+    // A new session or level may be a different maze
+    if (snapshot.generation != bot->generation) {
+        bot->generation = snapshot.generation;
+        bot->lives = snapshot.lives;
+        bot->restartPosted = false;
+        buildNeighborTable(bot->neighbors, snapshot.board);
+    }
+    if (snapshot.lives < bot->lives) {
+        bot->deaths += bot->lives - snapshot.lives;
+    }
+    bot->lives = snapshot.lives;
+
+    // A game over goes straight into the next game. The engine applies the
+    // request on its next tick, so it is posted once per finished game.
+    if (snapshot.screen == SCREEN_GAME_OVER) {
+        if (!bot->restartPosted) {
+            bot->games++;
+            bot->scoreTotal += snapshot.score;
+            if (snapshot.score > bot->bestScore) {
+                bot->bestScore = snapshot.score;
             }
+            addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_PLAY);
+            bot->restartPosted = true;
         }
+        return;
     }
-   
-    char scoreStr[50];
-    sprintf(scoreStr, "Score: %d", gameState.score);
-    sfText_setString(scoreText, scoreStr);
-    sfText_setPosition(scoreText, (sfVector2f){10 * CELL_SIZE + CELL_SIZE / 4.0, 19 * CELL_SIZE + CELL_SIZE / 4.0f});
-    sfRenderWindow_drawText(window, scoreText, NULL);
-   
-    float lifeY = 19 * CELL_SIZE + CELL_SIZE / 4.0f;
-    float lifeX = 7 * CELL_SIZE + CELL_SIZE / 4.0f;
-    for (int i = 0; i < gameState.lives; i++) {
-        sfSprite_setPosition(lifeSprite, (sfVector2f){lifeX - i * (CELL_SIZE / 2), lifeY});
-        sfRenderWindow_drawSprite(window, lifeSprite, NULL);
+    if (snapshot.screen != SCREEN_PLAY || snapshot.paused) {
+        return;
+    }
+
+    BotView view;
+    view.board = snapshot.board;
+    view.neighbors = bot->neighbors;
+    view.pacmanRow = snapshot.pacmanRow;
+    view.pacmanCol = snapshot.pacmanCol;
+    view.direction = (Direction)snapshot.pacmanDirection;
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        view.ghostRow[i] = snapshot.ghostRow[i];
+        view.ghostCol[i] = snapshot.ghostCol[i];
+        bool active = !(snapshot.ghostFlags[i] & SNAPSHOT_GHOST_RESPAWNING);
+        bool vulnerable = (snapshot.ghostFlags[i] & SNAPSHOT_GHOST_VULNERABLE) != 0;
+        view.ghostDangerous[i] = active && !vulnerable;
+        view.ghostPrey[i] = active && vulnerable;
+    }
+
+    uint64_t startNs = monotonicNs();
+    bool fled = false;
+    Direction direction = botChooseDirection(&view, &fled);
+    uint64_t planNs = monotonicNs() - startNs;
+    bot->planNsTotal += planNs;
+    if (planNs > bot->planNsMax) {
+        bot->planNsMax = planNs;
+    }
+    bot->flees += fled ? 1 : 0;
+    if (direction != view.direction) {
+        bot->turns++;
+        addInputEvent(EVENT_DIRECTION_CHANGE, direction);
     }
-   
-    pthread_mutex_unlock(&gameState.mutex);
-    sfRenderWindow_display(window);
 }
 
-void processInput(sfRenderWindow* window) {
-    sfEvent event;
-    while (sfRenderWindow_pollEvent(window, &event)) {
-        if (event.type == sfEvtClosed) {
-            pthread_mutex_lock(&gameState.mutex);
-            gameState.gameRunning = false;
-            pthread_mutex_unlock(&gameState.mutex);
-            sfRenderWindow_close(window);
+static void botReport(InputSource* source) {
+    BotState* bot = (BotState*)source->state;
+    printf("\n=== Bot input ===\n");
+    printf("polls %llu, turns %llu, fled %llu times, plan avg %.1f us max %.1f us\n",
+           (unsigned long long)bot->polls, (unsigned long long)bot->turns, (unsigned long long)bot->flees,
+           bot->polls ? bot->planNsTotal / 1e3 / bot->polls : 0.0, bot->planNsMax / 1e3);
+    printf("games finished %llu, lives lost %llu, best score %d, average final score %.0f\n",
+           (unsigned long long)bot->games, (unsigned long long)bot->deaths, bot->bestScore,
+           bot->games ? (double)bot->scoreTotal / bot->games : 0.0);
+}
+
+static BotState botState;
+InputSource botInputSource = {
+    .name = "bot",
+    .pollMs = BOT_POLL_MS,
+    .poll = botPoll,
+    .report = botReport,
+    .state = &botState,
+};
+InputSource* inputSources[] = { &botInputSource };
+
+InputSource* findInputSource(const char* name) {
+    for (size_t i = 0; i < sizeof(inputSources) / sizeof(inputSources[0]); i++) {
+        if (strcmp(inputSources[i]->name, name) == 0) {
+            return inputSources[i];
         }
-        else if (event.type == sfEvtKeyPressed) {
-            pthread_mutex_lock(&uiState.mutex);
-            GameScreen currentScreen = uiState.currentScreen;
-            bool enteringUsername = uiState.enteringUsername;
-            pthread_mutex_unlock(&uiState.mutex);
-           
-            if (currentScreen == SCREEN_MENU) {
-                if (enteringUsername) {
-                    if (event.key.code == sfKeyEnter || event.key.code == sfKeyEscape) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        uiState.enteringUsername = false;
-                        uiState.needsRedraw = true;
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                    else if (event.key.code == sfKeyBackspace) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        if (uiState.usernameCursorPos > 0) {
-                            uiState.username[--uiState.usernameCursorPos] = '\0';
-                            uiState.needsRedraw = true;
-                        }
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                }
-                else {
-                    if (event.key.code == sfKeyU) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        uiState.enteringUsername = true;
-                        uiState.username[0] = '\0';
-                        uiState.usernameCursorPos = 0;
-                        uiState.needsRedraw = true;
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                    else if (event.key.code == sfKeyUp) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        uiState.selectedMenuItem = (uiState.selectedMenuItem - 1 + MENU_ITEM_COUNT) % MENU_ITEM_COUNT;
-                        uiState.needsRedraw = true;
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                    else if (event.key.code == sfKeyDown) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        uiState.selectedMenuItem = (uiState.selectedMenuItem + 1) % MENU_ITEM_COUNT;
-                        uiState.needsRedraw = true;
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                    else if (event.key.code == sfKeyReturn) {
-                        pthread_mutex_lock(&uiState.mutex);
-                        uiState.needsRedraw = true;
-                       
-                        switch (uiState.selectedMenuItem) {
-                            case 0:
-                                uiState.currentScreen = SCREEN_PLAY;
-                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_PLAY);
-                                break;
-                            case 1:
-                                uiState.currentScreen = SCREEN_SCOREBOARD;
-                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_SCOREBOARD);
-                                break;
-                            case 2:
-                                uiState.currentScreen = SCREEN_INSTRUCTIONS;
-                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_INSTRUCTIONS);
-                                break;
-                            case 3:
-                                uiState.currentScreen = SCREEN_QUIT;
-                                addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_QUIT);
-                                gameState.gameRunning = false;
-                                break;
-                        }
-                        pthread_mutex_unlock(&uiState.mutex);
-                    }
-                }
+    }
+    return NULL;
+}
+
+static void* inputSourceThread(void* arg) {
+    InputSource* source = (InputSource*)arg;
+    char threadName[24];
+    snprintf(threadName, sizeof(threadName), "input %s", source->name);
+    setThreadName(threadName);
+    heartbeatRegister(threadName, source->pollMs);
+    while (!simulationCancelled() && atomic_load(&source->running)) {
+        heartbeat();
+        source->poll(source);
+        cancellableSleepMs(source->pollMs, &source->running);
+    }
+    heartbeatUnregister();
+    return NULL;
+}
+
+bool inputSourceStart(InputSource* source) {
+    atomic_store(&source->running, true);
+    source->threadStarted = (pthread_create(&source->thread, NULL, inputSourceThread, source) == 0);
+    if (!source->threadStarted) {
+        LOG_ERROR("Could not start the %s input source", source->name);
+        return false;
+    }
+    LOG_INFO("Pacman is steered by the %s input source", source->name);
+    return true;
+}
+
+void inputSourceStop(InputSource* source) {
+    if (!source->threadStarted) {
+        return;
+    }
+    atomic_store(&source->running, false);
+    wakeSimulationSleepers();
+    pthread_join(source->thread, NULL);
+    source->threadStarted = false;
+}
+
+// The windowed game's engine and ghost threads with the bot at the controls
+// and no window, for benchmarks and soak tests
+int runBotBenchmark(int seconds) {
+    logInit();
+    setThreadName("main");
+    initBoardLocks();
+    loadRealtimeConfig();
+    initUIState();
+    initGameState();
+    initSimulationCancel();
+    if (!initEngineEvents()) {
+        printf("Error creating game engine event loop\n");
+        return 1;
+    }
+    MUTEX_LOCK(uiState.mutex);
+    uiState.currentScreen = SCREEN_PLAY;
+    MUTEX_UNLOCK(uiState.mutex);
+
+    pthread_t gameEngineThread;
+    if (pthread_create(&gameEngineThread, NULL, gameEngineThreadFunc, NULL) != 0) {
+        printf("Error creating game engine thread\n");
+        return 1;
+    }
+    startGhostThreads();
+    inputSourceStart(&botInputSource);
+    printf("Bot playing for %d s...\n", seconds);
+    cancellableSleepMs(seconds * 1000, NULL);
+
+    MUTEX_LOCK(gameState.mutex);
+    gameState.gameRunning = false;
+    int finalScore = gameState.score;
+    publishPacmanView();
+    MUTEX_UNLOCK(gameState.mutex);
+    cancelSimulation();
+    pthread_join(gameEngineThread, NULL);
+    stopGhostThreads();
+    inputSourceStop(&botInputSource);
+    closeEngineEvents();
+
+    printf("\n=== Bot run: %d s, %u sessions, score in the last one %d ===\n", seconds,
+           atomic_load(&gameState.generation), finalScore);
+    botInputSource.report(&botInputSource);
+    verifyGhostHouseState();
+    printGhostHouseReport();
+    printBoostReport();
+    printSchedLatencyReport();
+    logShutdown();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Rollouts: ./game --rollouts [games] [workers] plays games of every
+// parameter set in rolloutPresets with the bot, on every core, for tuning
+// ghost speed, boosts and the power pellet windows. Each game is a clone of
+// its set's start session on a simulated clock that jumps from one deadline
+// to the next, so minutes of play take milliseconds. Game i of every set
+// uses the same ghost seeds, so sets differ only by their rules. Workers
+// claim games from one counter and write preallocated result slots; the
+// game loop takes no shared lock and allocates nothing.
+// ---------------------------------------------------------------------------
+static const RolloutPreset rolloutPresets[] = {
+    { "default",      { GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+                        BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS } },
+    { "fast ghosts",  { 150, 40, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+                        BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS } },
+    { "slow ghosts",  { 260, 60, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+                        BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS } },
+    { "short fright", { GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, 3000, 5000,
+                        BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS } },
+    { "long fright",  { GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, 9000, 12000,
+                        BOOST_DURATION_MS, BOOST_TOKENS_PER_SEC, BOOST_SLOTS } },
+    { "long boosts",  { GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+                        8000, 0.4, BOOST_SLOTS } },
+    { "no boosts",    { GHOST_INTERVAL_MS, GHOST_INTERVAL_STEP_MS, GHOST_VULNERABLE_MS, POWER_PELLET_MS,
+                        0, 0.0, BOOST_SLOTS } },
+};
+
+// Plays game index of a set from its start state to game over or the
+// ROLLOUT_MAX_SECONDS cap
+static void rolloutPlay(GameSession* game, const GameSession* start, int index, RolloutResult* result) {
+    SessionWorker counters;
+    memset(&counters, 0, sizeof(counters));
+    sessionClone(game, start);
+    game->seed = 7919u * (index + 1);
+    for (int i = 0; i < MAX_GHOSTS; i++) {
+        game->ghosts[i].rngSeed = rand_r(&game->seed);
+    }
+
+    uint64_t now = game->tickDueNs;
+    uint64_t endNs = now + ROLLOUT_MAX_SECONDS * 1000000000ull;
+    while (game->gameRunning && now < endNs) {
+        now = sessionStep(&counters, game, now);
+    }
+    result->score = game->score;
+    result->ticks = (uint32_t)game->ticks;
+    result->livesLost = (uint8_t)(start->lives - game->lives);
+    result->survived = game->gameRunning;
+}
+
+static void* rolloutWorkerThread(void* arg) {
+    RolloutWorker* worker = (RolloutWorker*)arg;
+    char name[24];
+    snprintf(name, sizeof(name), "rollout worker %d", worker->id);
+    setThreadName(name);
+    applyThreadPlacement(name, worker->cpu, 0);
+
+    RolloutBatch* batch = &rolloutBatch;
+    int total = batch->presetCount * batch->gamesPerSet;
+    // Only the game fields are cloned into this each time; it is never
+    // shared, so its mutex is never taken
+    GameSession game;
+    memset(&game, 0, sizeof(game));
+    pthread_mutex_init(&game.mutex, NULL);
+    for (;;) {
+        int first = atomic_fetch_add(&batch->nextGame, ROLLOUT_CHUNK);
+        if (first >= total) {
+            break;
+        }
+        int last = first + ROLLOUT_CHUNK < total ? first + ROLLOUT_CHUNK : total;
+        for (int g = first; g < last; g++) {
+            rolloutPlay(&game, &batch->starts[g / batch->gamesPerSet], g % batch->gamesPerSet,
+                        &batch->results[g]);
+            worker->games++;
+            worker->ticks += batch->results[g].ticks;
+        }
+    }
+    pthread_mutex_destroy(&game.mutex);
+    struct timespec cpuTime;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime);
+    worker->cpuNs = timespecNs(&cpuTime);
+    return NULL;
+}
+
+static int compareInts(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Score percentiles, lives lost and the share of games still alive after
+// 1, 2 and 5 minutes and at the cap, per parameter set
+static void printRolloutReport(int* scratch) {
+    RolloutBatch* batch = &rolloutBatch;
+    static const int aliveMinutes[] = { 1, 2, 5 };
+    printf("%-13s %6s %7s %6s %6s %6s %6s %7s %7s %7s %7s\n", "set", "games", "mean", "p10", "p50", "p90",
+           "lost", "1 min", "2 min", "5 min", "to cap");
+    for (int p = 0; p < batch->presetCount; p++) {
+        RolloutResult* results = &batch->results[p * batch->gamesPerSet];
+        int games = batch->gamesPerSet;
+        double scoreTotal = 0.0;
+        int livesLost = 0;
+        int alive[3] = { 0, 0, 0 };
+        int survived = 0;
+        for (int i = 0; i < games; i++) {
+            scratch[i] = results[i].score;
+            scoreTotal += results[i].score;
+            livesLost += results[i].livesLost;
+            uint64_t playedMs = (uint64_t)results[i].ticks * SESSION_TICK_MS;
+            for (int m = 0; m < 3; m++) {
+                alive[m] += results[i].survived || playedMs >= aliveMinutes[m] * 60000ull;
+            }
+            survived += results[i].survived;
+        }
+        qsort(scratch, games, sizeof(scratch[0]), compareInts);
+        printf("%-13s %6d %7.0f %6d %6d %6d %6.2f %6.1f%% %6.1f%% %6.1f%% %6.1f%%\n",
+               batch->presets[p].name, games, scoreTotal / games, scratch[games / 10], scratch[games / 2],
+               scratch[games * 9 / 10], (double)livesLost / games, 100.0 * alive[0] / games,
+               100.0 * alive[1] / games, 100.0 * alive[2] / games, 100.0 * survived / games);
+    }
+}
+
+int runRollouts(int gamesPerSet, int workerCount) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    if (gamesPerSet <= 0) gamesPerSet = ROLLOUT_GAMES;
+    if (workerCount <= 0) workerCount = (int)cpus;
+    if (workerCount > SESSION_MAX_WORKERS) workerCount = SESSION_MAX_WORKERS;
+    logInit();
+    buildSessionTemplate();
+
+    RolloutBatch* batch = &rolloutBatch;
+    memset(batch, 0, sizeof(*batch));
+    batch->presets = rolloutPresets;
+    batch->presetCount = sizeof(rolloutPresets) / sizeof(rolloutPresets[0]);
+    batch->gamesPerSet = gamesPerSet;
+    batch->workerCount = workerCount;
+    atomic_init(&batch->nextGame, 0);
+    batch->starts = calloc(batch->presetCount, sizeof(GameSession));
+    batch->results = calloc((size_t)batch->presetCount * gamesPerSet, sizeof(RolloutResult));
+    int* scratch = malloc(sizeof(int) * gamesPerSet);
+    if (batch->starts == NULL || batch->results == NULL || scratch == NULL) {
+        free(batch->starts);
+        free(batch->results);
+        free(scratch);
+        logShutdown();
+        return 1;
+    }
+    for (int p = 0; p < batch->presetCount; p++) {
+        GameSession* start = &batch->starts[p];
+        start->id = p;
+        start->rules = batch->presets[p].rules;
+        start->autopilot = true;
+        pthread_mutex_init(&start->mutex, NULL);
+        sessionReset(start);
+    }
+
+    printf("=== Rollouts: %d sets x %d games on %d workers, up to %d simulated minutes each ===\n",
+           batch->presetCount, gamesPerSet, workerCount, ROLLOUT_MAX_SECONDS / 60);
+    double begin = monotonicMs();
+    for (int w = 0; w < workerCount; w++) {
+        RolloutWorker* worker = &batch->workers[w];
+        worker->id = w;
+        worker->cpu = w % cpus;
+        worker->started = (pthread_create(&worker->thread, NULL, rolloutWorkerThread, worker) == 0);
+        if (!worker->started) {
+            LOG_ERROR("Could not start rollout worker %d", w);
+        }
+    }
+    uint64_t games = 0;
+    uint64_t ticks = 0;
+    uint64_t cpuNs = 0;
+    for (int w = 0; w < workerCount; w++) {
+        RolloutWorker* worker = &batch->workers[w];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+        games += worker->games;
+        ticks += worker->ticks;
+        cpuNs += worker->cpuNs;
+    }
+    double wallSeconds = (monotonicMs() - begin) / 1000.0;
+
+    printRolloutReport(scratch);
+    printf("\n=== Rollout workers ===\n");
+    printf("worker   cpu    games  games/s   cpu s\n");
+    for (int w = 0; w < workerCount; w++) {
+        RolloutWorker* worker = &batch->workers[w];
+        printf("%-6d %5d %8llu %8.0f %7.2f\n", w, worker->cpu, (unsigned long long)worker->games,
+               worker->games / wallSeconds, worker->cpuNs / 1e9);
+    }
+    double simulatedSeconds = ticks * (SESSION_TICK_MS / 1000.0);
+    printf("%llu games in %.2f s: %.0f games/s, %.0f games/s per worker, %.0fx real time, "
+           "parallel efficiency %.0f%%\n",
+           (unsigned long long)games, wallSeconds, games / wallSeconds, games / wallSeconds / workerCount,
+           simulatedSeconds / wallSeconds, 100.0 * (cpuNs / 1e9) / (wallSeconds * workerCount));
+    printf("resource accounting violations: %llu\n", (unsigned long long)atomic_load(&resourceViolations));
+
+    bool complete = games == (uint64_t)batch->presetCount * gamesPerSet;
+    for (int p = 0; p < batch->presetCount; p++) {
+        pthread_mutex_destroy(&batch->starts[p].mutex);
+    }
+    free(batch->starts);
+    free(batch->results);
+    free(scratch);
+    logShutdown();
+    return complete && atomic_load(&resourceViolations) == 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------------
+// Move benchmark: ./game --bench-moves [maxGhosts]. Ghost threads hammer a
+// generated maze sized to the ghost count under each locking scheme, so the
+// cost of the single board mutex can be compared with tile locks and CAS
+// claims.
+// ---------------------------------------------------------------------------
+#define MOVE_BENCH_WALL (-2)
+#define MOVE_BENCH_EMPTY (-1)
+
+static bool moveBenchBoardInit(MoveBenchBoard* board, const GeneratedMaze* maze, BoardLockMode mode) {
+    board->rows = maze->rows;
+    board->cols = maze->cols;
+    board->mode = mode;
+    board->cells = malloc(sizeof(_Atomic int) * maze->rows * maze->cols);
+    if (board->cells == NULL || !tileGridInit(&board->tiles, maze->rows, maze->cols, BOARD_TILE_SIZE)) {
+        free(board->cells);
+        return false;
+    }
+    pthread_mutex_init(&board->globalLock, NULL);
+    atomic_init(&board->running, false);
+    for (int cell = 0; cell < maze->rows * maze->cols; cell++) {
+        atomic_init(&board->cells[cell], maze->cells[cell] == '=' ? MOVE_BENCH_WALL : MOVE_BENCH_EMPTY);
+    }
+    return true;
+}
+
+static void moveBenchBoardDestroy(MoveBenchBoard* board) {
+    tileGridDestroy(&board->tiles);
+    pthread_mutex_destroy(&board->globalLock);
+    free(board->cells);
+}
+
+// One attempted step for one ghost; false when the target was taken
+static bool moveBenchStep(MoveBenchBoard* board, int id, int* row, int* col, int newRow, int newCol) {
+    _Atomic int* from = &board->cells[*row * board->cols + *col];
+    _Atomic int* to = &board->cells[newRow * board->cols + newCol];
+    bool moved = false;
+   
+    if (board->mode == BOARD_LOCK_CAS) {
+        // Claim the target first; the source is ours alone, so a plain store frees it
+        int expected = MOVE_BENCH_EMPTY;
+        moved = atomic_compare_exchange_strong_explicit(to, &expected, id,
+                                                        memory_order_acq_rel, memory_order_relaxed);
+        if (moved) {
+            atomic_store_explicit(from, MOVE_BENCH_EMPTY, memory_order_release);
+        }
+    } else {
+        int held[2];
+        int count = 0;
+        if (board->mode == BOARD_LOCK_GLOBAL) {
+            pthread_mutex_lock(&board->globalLock);
+        } else {
+            count = tileGridLockCells(&board->tiles, *row, *col, newRow, newCol, held);
+        }
+        if (atomic_load_explicit(to, memory_order_relaxed) == MOVE_BENCH_EMPTY) {
+            atomic_store_explicit(to, id, memory_order_relaxed);
+            atomic_store_explicit(from, MOVE_BENCH_EMPTY, memory_order_relaxed);
+            moved = true;
+        }
+        if (board->mode == BOARD_LOCK_GLOBAL) {
+            pthread_mutex_unlock(&board->globalLock);
+        } else {
+            tileGridUnlock(&board->tiles, held, count);
+        }
+    }
+   
+    if (moved) {
+        *row = newRow;
+        *col = newCol;
+    }
+    return moved;
+}
+
+static void* moveBenchWorker(void* arg) {
+    MoveBenchWorker* worker = (MoveBenchWorker*)arg;
+    MoveBenchBoard* board = worker->board;
+    while (!atomic_load_explicit(&board->running, memory_order_acquire)) {
+        sched_yield();
+    }
+    while (atomic_load_explicit(&board->running, memory_order_relaxed)) {
+        for (int i = 0; i < worker->ghostCount; i++) {
+            int id = worker->firstGhost + i;
+            int* row = &worker->ghostRow[id];
+            int* col = &worker->ghostCol[id];
+            int newRow = *row;
+            int newCol = *col;
+            switch (rand_r(&worker->seed) % 4) {
+                case 0: newRow--; break;
+                case 1: newRow++; break;
+                case 2: newCol--; break;
+                default: newCol++; break;
             }
-            else if (currentScreen == SCREEN_PLAY) {
-                if (event.key.code == sfKeyEscape) {
-                    pthread_mutex_lock(&uiState.mutex);
-                    uiState.currentScreen = SCREEN_MENU;
-                    uiState.needsRedraw = true;
-                    pthread_mutex_unlock(&uiState.mutex);
-                    addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_MENU);
-                }
-                else if (event.key.code == sfKeyW || event.key.code == sfKeyUp) {
-                    pthread_mutex_lock(&gameState.mutex);
-                    gameState.currentDirection = DIR_UP;
-                    gameState.pacmanRotation = 90.0f;
-                    pthread_mutex_unlock(&gameState.mutex);
-                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_UP);
-                }
-                else if (event.key.code == sfKeyS || event.key.code == sfKeyDown) {
-                    pthread_mutex_lock(&gameState.mutex);
-                    gameState.currentDirection = DIR_DOWN;
-                    gameState.pacmanRotation = 270.0f;
-                    pthread_mutex_unlock(&gameState.mutex);
-                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_DOWN);
-                }
-                else if (event.key.code == sfKeyA || event.key.code == sfKeyLeft) {
-                    pthread_mutex_lock(&gameState.mutex);
-                    gameState.currentDirection = DIR_LEFT;
-                    gameState.pacmanRotation = 0.0f;
-                    pthread_mutex_unlock(&gameState.mutex);
-                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_LEFT);
-                }
-                else if (event.key.code == sfKeyD || event.key.code == sfKeyRight) {
-                    pthread_mutex_lock(&gameState.mutex);
-                    gameState.currentDirection = DIR_RIGHT;
-                    gameState.pacmanRotation = 180.0f;
-                    pthread_mutex_unlock(&gameState.mutex);
-                    addInputEvent(EVENT_DIRECTION_CHANGE, DIR_RIGHT);
-                }
-                else if (event.key.code == sfKeyP) {
-                    pthread_mutex_lock(&gameState.mutex);
-                    gameState.gamePaused = !gameState.gamePaused;
-                    pthread_mutex_unlock(&gameState.mutex);
-                }
+            // Walls never change, so they can be skipped without a lock
+            if (atomic_load_explicit(&board->cells[newRow * board->cols + newCol],
+                                     memory_order_relaxed) == MOVE_BENCH_WALL) {
+                continue;
             }
-            else if (currentScreen == SCREEN_SCOREBOARD || currentScreen == SCREEN_INSTRUCTIONS || currentScreen == SCREEN_GAME_OVER) {
-                if (event.key.code == sfKeyEscape) {
-                    pthread_mutex_lock(&uiState.mutex);
-                    uiState.currentScreen = SCREEN_MENU;
-                    uiState.needsRedraw = true;
-                    pthread_mutex_unlock(&uiState.mutex);
-                    addInputEvent(EVENT_SCREEN_CHANGE, SCREEN_MENU);
-                }
+            if (moveBenchStep(board, id, row, col, newRow, newCol)) {
+                worker->moves++;
+            } else {
+                worker->blocked++;
             }
         }
-        else if (event.type == sfEvtTextEntered) {
-            pthread_mutex_lock(&uiState.mutex);
-            bool enteringUsername = uiState.enteringUsername;
-            pthread_mutex_unlock(&uiState.mutex);
-           
-            if (enteringUsername && event.text.unicode < 128 && event.text.unicode != '\r' && event.text.unicode != '\n') {
-                pthread_mutex_lock(&uiState.mutex);
-                if (event.text.unicode == '\b') {
-                }
-                else if (uiState.usernameCursorPos < sizeof(uiState.username) - 1) {
-                    uiState.username[uiState.usernameCursorPos++] = (char)event.text.unicode;
-                    uiState.username[uiState.usernameCursorPos] = '\0';
-                    uiState.needsRedraw = true;
-                }
-                pthread_mutex_unlock(&uiState.mutex);
-            }
+    }
+    return NULL;
+}
+
+// Every ghost must still be exactly where it thinks it is, and nowhere else
+static bool moveBenchVerify(MoveBenchBoard* board, int ghostCount, const int* ghostRow, const int* ghostCol) {
+    int seen = 0;
+    for (int cell = 0; cell < board->rows * board->cols; cell++) {
+        if (atomic_load(&board->cells[cell]) >= 0) {
+            seen++;
+        }
+    }
+    for (int id = 0; id < ghostCount; id++) {
+        if (atomic_load(&board->cells[ghostRow[id] * board->cols + ghostCol[id]]) != id) {
+            return false;
         }
     }
+    return seen == ghostCount;
 }
 
-void* gameTickTimerThread(void* arg) {
-    TimerThreadArgs* args = (TimerThreadArgs*)arg;
+// Returns moves per second, or -1 if the board was corrupted or setup failed
+static double moveBenchRun(const GeneratedMaze* maze, int ghostCount, BoardLockMode mode, int workerCount) {
+    MoveBenchBoard board;
+    if (!moveBenchBoardInit(&board, maze, mode)) {
+        return -1.0;
+    }
+    int* ghostRow = malloc(sizeof(int) * ghostCount);
+    int* ghostCol = malloc(sizeof(int) * ghostCount);
+    MoveBenchWorker* workers = calloc(workerCount, sizeof(MoveBenchWorker));
+    if (ghostRow == NULL || ghostCol == NULL || workers == NULL) {
+        free(ghostRow);
+        free(ghostCol);
+        free(workers);
+        moveBenchBoardDestroy(&board);
+        return -1.0;
+    }
+   
+    // Same seeded placement for every mode, so runs are comparable
+    unsigned int seed = 12345;
+    for (int id = 0; id < ghostCount; id++) {
+        int cell;
+        do {
+            cell = rand_r(&seed) % (board.rows * board.cols);
+        } while (atomic_load(&board.cells[cell]) != MOVE_BENCH_EMPTY);
+        atomic_store(&board.cells[cell], id);
+        ghostRow[id] = cell / board.cols;
+        ghostCol[id] = cell % board.cols;
+    }
+   
+    int perWorker = ghostCount / workerCount;
+    int extra = ghostCount % workerCount;
+    int next = 0;
+    for (int w = 0; w < workerCount; w++) {
+        workers[w].board = &board;
+        workers[w].ghostRow = ghostRow;
+        workers[w].ghostCol = ghostCol;
+        workers[w].firstGhost = next;
+        workers[w].ghostCount = perWorker + (w < extra ? 1 : 0);
+        workers[w].seed = 1000u + w;
+        next += workers[w].ghostCount;
+        pthread_create(&workers[w].thread, NULL, moveBenchWorker, &workers[w]);
+    }
+   
+    double begin = monotonicMs();
+    atomic_store_explicit(&board.running, true, memory_order_release);
+    struct timespec runTime = { (time_t)MOVE_BENCH_SECONDS,
+                                (long)((MOVE_BENCH_SECONDS - (time_t)MOVE_BENCH_SECONDS) * 1e9) };
+    nanosleep(&runTime, NULL);
+    atomic_store(&board.running, false);
+   
+    uint64_t moves = 0;
+    for (int w = 0; w < workerCount; w++) {
+        pthread_join(workers[w].thread, NULL);
+        moves += workers[w].moves;
+    }
+    double elapsedMs = monotonicMs() - begin;
+   
+    bool intact = moveBenchVerify(&board, ghostCount, ghostRow, ghostCol);
+    free(ghostRow);
+    free(ghostCol);
+    free(workers);
+    moveBenchBoardDestroy(&board);
+    return intact ? moves / (elapsedMs / 1000.0) : -1.0;
+}
 
-    pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t timerCond = PTHREAD_COND_INITIALIZER;
+int runMoveBenchmark(int maxGhosts) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    if (cpus > MOVE_BENCH_MAX_WORKERS) cpus = MOVE_BENCH_MAX_WORKERS;
+   
+    printf("=== Ghost move throughput (%.1f s per run, up to %ld threads) ===\n",
+           MOVE_BENCH_SECONDS, cpus);
+    printf("%7s %7s %7s %14s %14s %14s\n", "ghosts", "board", "threads",
+           "global Mmv/s", "tiles Mmv/s", "cas Mmv/s");
+    bool ok = true;
+    for (int ghostCount = 4; ghostCount <= maxGhosts; ghostCount *= 4) {
+        int workerCount = ghostCount < cpus ? ghostCount : (int)cpus;
 
-    struct timespec ts;
+        // Grow the maze until it has MOVE_BENCH_CELLS_PER_GHOST open cells per ghost
+        int side = (int)ceil(sqrt((double)ghostCount * MOVE_BENCH_CELLS_PER_GHOST));
+        if (side < ROWS) side = ROWS;
+        GeneratedMaze maze;
+        if (!mazeGenerate(&maze, side, side, MAZE_OPENNESS, 12345)) {
+            return 1;
+        }
+        while (maze.openCount < ghostCount * MOVE_BENCH_CELLS_PER_GHOST) {
+            mazeFree(&maze);
+            side += side / 8 + 1;
+            if (!mazeGenerate(&maze, side, side, MAZE_OPENNESS, 12345)) {
+                return 1;
+            }
+        }
 
-    while (args->isRunning) {
-        // Get current time
-        clock_gettime(CLOCK_REALTIME, &ts);
-       
-        // Add interval to current time
-        ts.tv_nsec += (args->intervalMs % 1000) * 1000000;
-        ts.tv_sec += args->intervalMs / 1000 + (ts.tv_nsec / 1000000000);
-        ts.tv_nsec %= 1000000000;
-       
-        // Wait until the specified time or until signaled
-        pthread_mutex_lock(&timerMutex);
-        // Use shorter timeout to periodically check isRunning
-        int waitResult = pthread_cond_timedwait(&timerCond, &timerMutex, &ts);
-        pthread_mutex_unlock(&timerMutex);
-       
-        // Check if we should continue running before signaling
-        if (!args->isRunning) {
-            break;
+        double rate[BOARD_LOCK_MODE_COUNT];
+        for (int mode = 0; mode < BOARD_LOCK_MODE_COUNT; mode++) {
+            rate[mode] = moveBenchRun(&maze, ghostCount, (BoardLockMode)mode, workerCount);
+            if (rate[mode] < 0) {
+                printf("%s run with %d ghosts failed or corrupted the board\n",
+                       boardLockModeNames[mode], ghostCount);
+                ok = false;
+            }
         }
-        
-        // Signal the game engine thread for a tick
-        sem_post(args->semaphore);
+        mazeFree(&maze);
+        char boardSize[24];
+        snprintf(boardSize, sizeof(boardSize), "%dx%d", side, side);
+        printf("%7d %7s %7d %14.2f %8.2f (%3.1fx) %8.2f (%3.1fx)\n", ghostCount, boardSize, workerCount,
+               rate[BOARD_LOCK_GLOBAL] / 1e6,
+               rate[BOARD_LOCK_TILES] / 1e6, rate[BOARD_LOCK_TILES] / rate[BOARD_LOCK_GLOBAL],
+               rate[BOARD_LOCK_CAS] / 1e6, rate[BOARD_LOCK_CAS] / rate[BOARD_LOCK_GLOBAL]);
     }
+    return ok ? 0 : 1;
+}
 
-    // Clean up resources
-    pthread_mutex_destroy(&timerMutex);
-    pthread_cond_destroy(&timerCond);
+// ---------------------------------------------------------------------------
+// Maze generator: mazeGenerate() builds a seeded maze of any size from
+// MAZE_MIN_SIDE up. A depth-first carve over the odd cells gives a maze
+// where every corridor is connected, then openness percent of the walls
+// that separate two corridors are knocked out for loops. The ghost house is
+// set aside in the middle first, with one door to the corridor above it.
+// ./game --bench-maze [maxSide] [openness] measures how generation, path
+// search and ghost moves scale with the grid.
+// ---------------------------------------------------------------------------
+static inline bool mazeInBounds(const GeneratedMaze* maze, int row, int col) {
+    return row >= 0 && row < maze->rows && col >= 0 && col < maze->cols;
+}
 
-    return NULL;
+bool mazeInHouse(const GeneratedMaze* maze, int row, int col) {
+    return row >= maze->houseRow && row < maze->houseRow + MAZE_HOUSE_ROWS &&
+           col >= maze->houseCol && col < maze->houseCol + MAZE_HOUSE_COLS;
 }
 
-           
-void* gameEngineThreadFunc(void* arg) {
-    // Initialize game tick semaphore for timing
-    sem_t gameTick;
-    sem_init(&gameTick, 0, 0);
+// The house and its wall, which the carve stays out of
+static bool mazeReserved(const GeneratedMaze* maze, int row, int col) {
+    return row >= maze->houseRow - 1 && row <= maze->houseRow + MAZE_HOUSE_ROWS &&
+           col >= maze->houseCol - 1 && col <= maze->houseCol + MAZE_HOUSE_COLS;
+}
 
-    // Set up frame synchronization primitives
-    pthread_mutex_t frameMutex = PTHREAD_MUTEX_INITIALIZER;
-    pthread_cond_t frameCond = PTHREAD_COND_INITIALIZER;
+// Odd cells are the carve's rooms, the cells between them its doors
+static bool mazeIsRoom(const GeneratedMaze* maze, int row, int col) {
+    return row % 2 == 1 && col % 2 == 1 && row >= 1 && row <= maze->rows - 2 &&
+           col >= 1 && col <= maze->cols - 2 && !mazeReserved(maze, row, col);
+}
 
-    // Set up and start the timer thread
-    pthread_t tickThread;
-    TimerThreadArgs tickArgs;
-    tickArgs.semaphore = &gameTick;
-    tickArgs.intervalMs = 200;   // 200ms per game tick (5 ticks per second)
-    tickArgs.isRunning = true;
+// Carves a maze into caller-provided buffers, so a level can be built
+// without allocating: cells holds rows * cols chars and stack
+// (rows / 2) * (cols / 2) + 1 ints. houseRow/houseCol is the top left of
+// the inside of the ghost house; it needs two rows or columns of maze on
+// every side.
+bool mazeCarve(GeneratedMaze* maze, char* buffer, int* stack, int rows, int cols,
+               int houseRow, int houseCol, int openness, unsigned int seed) {
+    memset(maze, 0, sizeof(*maze));
+    if (rows < MAZE_MIN_SIDE || cols < MAZE_MIN_SIDE) {
+        LOG_WARN("Mazes need at least %dx%d cells, not %dx%d", MAZE_MIN_SIDE, MAZE_MIN_SIDE, rows, cols);
+        return false;
+    }
+    if (houseRow < 3 || houseRow + MAZE_HOUSE_ROWS + 1 > rows - 3 ||
+        houseCol < 3 || houseCol + MAZE_HOUSE_COLS + 1 > cols - 3) {
+        LOG_WARN("No room for the ghost house at [%d,%d] in a %dx%d maze", houseRow, houseCol, rows, cols);
+        return false;
+    }
+    maze->rows = rows;
+    maze->cols = cols;
+    maze->cells = buffer;
+    memset(maze->cells, '=', (size_t)rows * cols);
+    char (*cells)[cols] = (char (*)[cols])maze->cells;
 
-    // Create timer thread with detached attribute
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    pthread_create(&tickThread, &attr, gameTickTimerThread, &tickArgs);
-    pthread_attr_destroy(&attr);
+    // The door column is odd, so the corridor above it meets a room
+    maze->houseRow = houseRow;
+    maze->houseCol = houseCol;
+    maze->doorRow = houseRow - 1;
+    maze->doorCol = (houseCol + 2) | 1;
+    for (int r = 0; r < MAZE_HOUSE_ROWS; r++) {
+        memset(&cells[maze->houseRow + r][maze->houseCol], ' ', MAZE_HOUSE_COLS);
+    }
+    cells[maze->doorRow][maze->doorCol] = ' ';
 
-    // Main game loop
-    while (true) {
-        // Wait for the timer to signal a new tick
-        sem_wait(&gameTick);
-       
-        // Get current game state (safely)
-        pthread_mutex_lock(&gameState.mutex);
-        bool gameRunning = gameState.gameRunning;
-        bool gamePaused = gameState.gamePaused;
-        float deltaTime = 0.2f;  // 200ms in seconds
-        pthread_mutex_unlock(&gameState.mutex);
-       
-        // Exit if game is no longer running
-        if (!gameRunning) {
-            break;
+    static const int stepRow[4] = { -1, 1, 0, 0 };
+    static const int stepCol[4] = { 0, 0, -1, 1 };
+    int depth = 0;
+    cells[1][1] = '.';
+    stack[depth++] = 1 * cols + 1;
+    while (depth > 0) {
+        int row = stack[depth - 1] / cols;
+        int col = stack[depth - 1] % cols;
+        int options[4];
+        int optionCount = 0;
+        for (int d = 0; d < 4; d++) {
+            int nextRow = row + 2 * stepRow[d];
+            int nextCol = col + 2 * stepCol[d];
+            if (mazeIsRoom(maze, nextRow, nextCol) && cells[nextRow][nextCol] == '=') {
+                options[optionCount++] = d;
+            }
         }
-       
-        // Process all pending input events
-        InputEvent event;
-        while (getNextInputEvent(&event)) {
-            if (event.eventType == EVENT_DIRECTION_CHANGE) {
-                // Update Pacman's direction and rotation
-                pthread_mutex_lock(&gameState.mutex);
-                gameState.currentDirection = event.data;
-                switch(event.data) {
-                    case DIR_UP: gameState.pacmanRotation = 270.0f; break;
-                    case DIR_DOWN: gameState.pacmanRotation = 90.0f; break;
-                    case DIR_LEFT: gameState.pacmanRotation = 180.0f; break;
-                    case DIR_RIGHT: gameState.pacmanRotation = 0.0f; break;
-                    default: break;
-                }
-                pthread_mutex_unlock(&gameState.mutex);
+        if (optionCount == 0) {
+            depth--;
+            continue;
+        }
+        int d = options[rand_r(&seed) % optionCount];
+        cells[row + stepRow[d]][col + stepCol[d]] = '.';
+        cells[row + 2 * stepRow[d]][col + 2 * stepCol[d]] = '.';
+        stack[depth++] = (row + 2 * stepRow[d]) * cols + col + 2 * stepCol[d];
+    }
+    for (int r = maze->doorRow - 1; !mazeIsRoom(maze, r, maze->doorCol); r--) {
+        cells[r][maze->doorCol] = '.';
+    }
+
+    // Loops: a wall with corridor on two opposite sides may go
+    for (int r = 1; r < rows - 1; r++) {
+        for (int c = 1; c < cols - 1; c++) {
+            if (cells[r][c] != '=' || mazeReserved(maze, r, c)) {
+                continue;
             }
-            else if (event.eventType == EVENT_SCREEN_CHANGE) {
-                // Initialize game state when entering play screen
-                if (event.data == SCREEN_PLAY) {
-                    initGameState();
-                }
+            bool across = cells[r][c - 1] == '.' && cells[r][c + 1] == '.' &&
+                          cells[r - 1][c] == '=' && cells[r + 1][c] == '=';
+            bool along = cells[r - 1][c] == '.' && cells[r + 1][c] == '.' &&
+                         cells[r][c - 1] == '=' && cells[r][c + 1] == '=';
+            if ((across || along) && (int)(rand_r(&seed) % 100) < openness) {
+                cells[r][c] = '.';
             }
         }
-       
-        // Check if we're in the play screen
-        pthread_mutex_lock(&uiState.mutex);
-        bool isPlayScreen = (uiState.currentScreen == SCREEN_PLAY);
-        pthread_mutex_unlock(&uiState.mutex);
-       
-        // Update game logic if we're playing and not paused
-        if (isPlayScreen && !gamePaused) {
-            // Move Pacman according to current direction
-            movePacman();
-           
-            // Signal that a frame has been processed
-            pthread_mutex_lock(&frameMutex);
-            pthread_cond_broadcast(&frameCond);
-            pthread_mutex_unlock(&frameMutex);
-           
-            // Update power pellet and ghost vulnerability timers
-            pthread_mutex_lock(&gameState.mutex);
-           
-            // Handle power pellet timeout
-            if (gameState.powerPelletActive) {
-                gameState.powerPelletDuration += deltaTime;
-                if (gameState.powerPelletDuration >= 10.0f) {
-                    gameState.powerPelletActive = false;
-                    gameState.ghostVulnerable = false;
+    }
+
+    // Pacman starts on the bottom room row, near the middle like initialBoard
+    maze->pacmanRow = (rows - 2) % 2 == 1 ? rows - 2 : rows - 3;
+    maze->pacmanCol = (cols / 2) | 1;
+    if (maze->pacmanCol > cols - 2) {
+        maze->pacmanCol -= 2;
+    }
+    cells[maze->pacmanRow][maze->pacmanCol] = '@';
+
+    // First pellet of every tile becomes a power pellet
+    for (int tileRow = 0; tileRow < rows; tileRow += MAZE_PELLET_TILE) {
+        for (int tileCol = 0; tileCol < cols; tileCol += MAZE_PELLET_TILE) {
+            bool placed = false;
+            for (int r = tileRow; r < tileRow + MAZE_PELLET_TILE && r < rows && !placed; r++) {
+                for (int c = tileCol; c < tileCol + MAZE_PELLET_TILE && c < cols && !placed; c++) {
+                    if (cells[r][c] == '.') {
+                        cells[r][c] = '0';
+                        placed = true;
+                    }
                 }
             }
-           
-            // Handle ghost vulnerability timeout
-            if (gameState.ghostVulnerable) {
-                gameState.ghostVulnerableDuration += deltaTime;
-               
-                if (gameState.ghostVulnerableDuration >= 6.0f) {
-                    gameState.ghostVulnerable = false;
-                }
+        }
+    }
+
+    for (int cell = 0; cell < rows * cols; cell++) {
+        char content = maze->cells[cell];
+        maze->openCount += content != '=';
+        maze->pelletCount += content == '.';
+        maze->powerPelletCount += content == '0';
+    }
+    return true;
+}
+
+// A maze with the ghost house in the middle
+bool mazeGenerate(GeneratedMaze* maze, int rows, int cols, int openness, unsigned int seed) {
+    char* cells = malloc((size_t)rows * cols);
+    int* stack = malloc(sizeof(int) * ((rows / 2) * (cols / 2) + 1));
+    bool carved = cells != NULL && stack != NULL &&
+                  mazeCarve(maze, cells, stack, rows, cols, ((rows - MAZE_HOUSE_ROWS) / 2) | 1,
+                            ((cols - MAZE_HOUSE_COLS) / 2) | 1, openness, seed);
+    free(stack);
+    if (!carved) {
+        free(cells);
+        maze->cells = NULL;
+    }
+    return carved;
+}
+
+void mazeFree(GeneratedMaze* maze) {
+    free(maze->cells);
+    maze->cells = NULL;
+}
+
+// Ghost i's start: the house cells in turn, wrapping for large ghost counts
+void mazeGhostSpawn(const GeneratedMaze* maze, int ghost, int* row, int* col) {
+    int cell = ghost % (MAZE_HOUSE_ROWS * MAZE_HOUSE_COLS);
+    *row = maze->houseRow + cell / MAZE_HOUSE_COLS;
+    *col = maze->houseCol + cell % MAZE_HOUSE_COLS;
+}
+
+// Breadth-first distances from one cell through everything but walls;
+// unreachable cells get -1. queue holds rows * cols cells.
+static int mazeDistances(const GeneratedMaze* maze, int row, int col, int* distance, int* queue) {
+    static const int stepRow[4] = { -1, 1, 0, 0 };
+    static const int stepCol[4] = { 0, 0, -1, 1 };
+    int cols = maze->cols;
+    memset(distance, 0xFF, sizeof(int) * maze->rows * cols);
+    int head = 0;
+    int tail = 0;
+    distance[row * cols + col] = 0;
+    queue[tail++] = row * cols + col;
+    while (head < tail) {
+        int cell = queue[head++];
+        for (int d = 0; d < 4; d++) {
+            int nextRow = cell / cols + stepRow[d];
+            int nextCol = cell % cols + stepCol[d];
+            int next = nextRow * cols + nextCol;
+            if (mazeInBounds(maze, nextRow, nextCol) && maze->cells[next] != '=' && distance[next] < 0) {
+                distance[next] = distance[cell] + 1;
+                queue[tail++] = next;
+            }
+        }
+    }
+    return tail;
+}
+
+// Closed border, every open cell reachable from pacman, the house sealed
+// but for its door, and at least one power pellet
+bool mazeValidate(const GeneratedMaze* maze) {
+    int rows = maze->rows;
+    int cols = maze->cols;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            bool border = r == 0 || c == 0 || r == rows - 1 || c == cols - 1;
+            char cell = maze->cells[r * cols + c];
+            if (border && cell != '=') {
+                return false;
+            }
+            if (mazeInHouse(maze, r, c) && cell != ' ') {
+                return false;
+            }
+            bool houseWall = mazeReserved(maze, r, c) && !mazeInHouse(maze, r, c);
+            if (houseWall && cell != '=' && !(r == maze->doorRow && c == maze->doorCol)) {
+                return false;
             }
-           
-            pthread_mutex_unlock(&gameState.mutex);
         }
     }
+    if (maze->cells[maze->pacmanRow * cols + maze->pacmanCol] != '@' || maze->powerPelletCount == 0) {
+        return false;
+    }
+
+    int* distance = malloc(sizeof(int) * rows * cols);
+    int* queue = malloc(sizeof(int) * rows * cols);
+    if (distance == NULL || queue == NULL) {
+        free(distance);
+        free(queue);
+        return false;
+    }
+    int reached = mazeDistances(maze, maze->pacmanRow, maze->pacmanCol, distance, queue);
+    free(distance);
+    free(queue);
+    return reached == maze->openCount;
+}
 
-    // Signal the timer thread to exit
-    tickArgs.isRunning = false;
+// For each size from 20x20, doubling up to maxSide: generation and
+// validation time, the cost of a full path search from pacman (what the bot
+// and ghost AI pay per decision), and ghost moves per second with one ghost
+// per MOVE_BENCH_CELLS_PER_GHOST open cells under tile locks. Rendering
+// needs a window and is not measured here.
+int runMazeBenchmark(int maxSide, int openness) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) cpus = 1;
+    if (cpus > MOVE_BENCH_MAX_WORKERS) cpus = MOVE_BENCH_MAX_WORKERS;
 
+    printf("=== Generated mazes: %d%% open, up to %dx%d ===\n", openness, maxSide, maxSide);
+    printf("%9s %8s %8s %6s %9s %9s %6s %11s %9s %7s %12s\n", "size", "open", "pellets", "power",
+           "gen ms", "check ms", "valid", "search us", "ns/cell", "ghosts", "tiles Mmv/s");
+    bool ok = true;
+    for (int side = ROWS; side <= maxSide; side *= 2) {
+        GeneratedMaze maze;
+        double begin = monotonicMs();
+        if (!mazeGenerate(&maze, side, side, openness, 2024u + side)) {
+            return 1;
+        }
+        double generateMs = monotonicMs() - begin;
+        begin = monotonicMs();
+        bool valid = mazeValidate(&maze);
+        double validateMs = monotonicMs() - begin;
+        ok = ok && valid;
 
-    sem_destroy(&gameTick);
-    pthread_mutex_destroy(&frameMutex);
-    pthread_cond_destroy(&frameCond);
+        int* distance = malloc(sizeof(int) * side * side);
+        int* queue = malloc(sizeof(int) * side * side);
+        if (distance == NULL || queue == NULL) {
+            free(distance);
+            free(queue);
+            mazeFree(&maze);
+            return 1;
+        }
+        int searches = 0;
+        begin = monotonicMs();
+        do {
+            mazeDistances(&maze, maze.pacmanRow, maze.pacmanCol, distance, queue);
+            searches++;
+        } while (monotonicMs() - begin < 100.0);
+        double searchUs = (monotonicMs() - begin) * 1000.0 / searches;
+        free(distance);
+        free(queue);
 
-    // Signal that this thread has exited
-    pthread_mutex_lock(&gameEngineThreadExitMutex);
-    gameEngineThreadExited = true;
-    pthread_cond_signal(&gameEngineThreadExitCond);
-    pthread_mutex_unlock(&gameEngineThreadExitMutex);
+        int ghostCount = maze.openCount / MOVE_BENCH_CELLS_PER_GHOST;
+        int workerCount = ghostCount < cpus ? ghostCount : (int)cpus;
+        double rate = moveBenchRun(&maze, ghostCount, BOARD_LOCK_TILES, workerCount);
+        ok = ok && rate >= 0;
 
-    return NULL;
+        char size[24];
+        snprintf(size, sizeof(size), "%dx%d", side, side);
+        printf("%9s %8d %8d %6d %9.2f %9.2f %6s %11.1f %9.2f %7d %12.2f\n", size, maze.openCount,
+               maze.pelletCount, maze.powerPelletCount, generateMs, validateMs, valid ? "yes" : "NO",
+               searchUs, searchUs * 1000.0 / maze.openCount, ghostCount, rate / 1e6);
+        mazeFree(&maze);
+    }
+    return ok ? 0 : 1;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Offline converter: ./game --import-scores scores.txt
+    if (argc >= 3 && strcmp(argv[1], "--import-scores") == 0) {
+        if (!openScoreStore(SCORE_FILE)) {
+            return 1;
+        }
+        // Importing twice would list every old score twice
+        if (scoreStoreCount() > 0) {
+            printf("%s already holds %llu scores; not importing into it\n", SCORE_FILE,
+                   (unsigned long long)scoreStoreCount());
+            closeScoreStore();
+            return 1;
+        }
+        int imported = importLegacyScores(argv[2]);
+        if (imported < 0) {
+            printf("Could not read %s\n", argv[2]);
+            closeScoreStore();
+            return 1;
+        }
+        printf("Imported %d scores into %s (%llu total)\n", imported, SCORE_FILE,
+               (unsigned long long)scoreStoreCount());
+        closeScoreStore();
+        return 0;
+    }
+
+    // Offline packer: ./game --pack-assets [assets.pak]
+    if (argc >= 2 && strcmp(argv[1], "--pack-assets") == 0) {
+        return packAssetBundle(argc >= 3 ? argv[2] : ASSET_BUNDLE_FILE) == 0 ? 0 : 1;
+    }
+
+    // Locking benchmark: ./game --bench-moves [maxGhosts]
+    if (argc >= 2 && strcmp(argv[1], "--bench-moves") == 0) {
+        return runMoveBenchmark(argc >= 3 ? atoi(argv[2]) : 1024);
+    }
+
+    // Maze scaling benchmark: ./game --bench-maze [maxSide] [openness]
+    if (argc >= 2 && strcmp(argv[1], "--bench-maze") == 0) {
+        return runMazeBenchmark(argc >= 3 ? atoi(argv[2]) : MAZE_BENCH_MAX_SIDE,
+                                argc >= 4 ? atoi(argv[3]) : MAZE_OPENNESS);
+    }
+
+    // Headless bot run: ./game --bench-bot [seconds]
+    if (argc >= 2 && strcmp(argv[1], "--bench-bot") == 0) {
+        return runBotBenchmark(argc >= 3 ? atoi(argv[2]) : BOT_BENCH_SECONDS);
+    }
+
+    // Difficulty tuning: ./game --rollouts [games per set] [workers]
+    if (argc >= 2 && strcmp(argv[1], "--rollouts") == 0) {
+        return runRollouts(argc >= 3 ? atoi(argv[2]) : ROLLOUT_GAMES, argc >= 4 ? atoi(argv[3]) : 0);
+    }
+
+    // Snapshot codec benchmark: ./game --bench-codec [minutes]
+    if (argc >= 2 && strcmp(argv[1], "--bench-codec") == 0) {
+        return runCodecBenchmark(argc >= 3 ? atoi(argv[2]) : 10);
+    }
+
+    // Reference spectator: ./game --watch [/pacman-spectate]
+    if (argc >= 2 && strcmp(argv[1], "--watch") == 0) {
+        return runSpectatorViewer(argc >= 3 ? argv[2] : SPECTATOR_SHM_NAME);
+    }
+
+    // Headless multi-session server: ./game --serve [pacman.sock]
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        return runSessionServer(argc >= 3 ? argv[2] : SESSION_SOCKET_PATH);
+    }
+
+    // Session capacity benchmark: ./game --bench-sessions [count] [seconds]
+    if (argc >= 2 && strcmp(argv[1], "--bench-sessions") == 0) {
+        return runSessionBenchmark(argc >= 3 ? atoi(argv[2]) : 1000,
+                                   argc >= 4 ? atoi(argv[3]) : SESSION_BENCH_SECONDS);
+    }
+
+    // Tracing: ./game --trace [trace.json], or PACMAN_TRACE=<file>
+    const char* traceEnv = getenv("PACMAN_TRACE");
+    if (argc >= 2 && strcmp(argv[1], "--trace") == 0) {
+        traceStart(argc >= 3 ? argv[2] : TRACE_FILE);
+    } else if (traceEnv != NULL && traceEnv[0] != '\0') {
+        traceStart(traceEnv);
+    }
+    logInit();
+    setThreadName("render");
+    initBoardLocks();
+    loadRealtimeConfig();
+    watchdogStart();
+
+    double startupBegin = monotonicMs();
     loadScores();
     sfVideoMode mode = {WINDOW_WIDTH, WINDOW_HEIGHT, 32};
     sfRenderWindow* window = sfRenderWindow_create(mode, "Pacman", sfClose, NULL);
@@ -1907,11 +8360,19 @@ int main() {
    
     sfRenderWindow_setFramerateLimit(window, 60);
    
-    sfFont* font = sfFont_createFromFile("ARIAL.TTF");
-    if (!font) {
-        printf("Error loading font\n");
-        return -1;
+    // Prefer the pre-decoded bundle; loose files are decoded on worker threads
+    double assetsBegin = monotonicMs();
+    GameAssets assets;
+    memset(&assets, 0, sizeof(assets));
+    if (!loadAssetBundle(ASSET_BUNDLE_FILE, &assets) && !loadAssetFiles(&assets)) {
+        printf("Error loading assets\n");
+        if (!assets.font) {
+            printf("Error loading font\n");
+            return -1;
+        }
     }
+    double assetsMs = monotonicMs() - assetsBegin;
+    sfFont* font = assets.font;
    
     sfRectangleShape* wall = sfRectangleShape_create();
     sfRectangleShape_setSize(wall, (sfVector2f){CELL_SIZE, CELL_SIZE});
@@ -1925,40 +8386,39 @@ int main() {
     sfCircleShape_setRadius(powerPellet, 12);
     sfCircleShape_setFillColor(powerPellet, sfColor_fromRGB(255, 184, 174));
    
-    ghost1Texture = sfTexture_createFromFile("ghost.jpeg", NULL);
-    ghost5Texture = sfTexture_createFromFile("ghostDed.jpg", NULL);
-    sfTexture* pacmanTexture = sfTexture_createFromFile("pacman1.jpeg", NULL);
-    ghost2Texture = sfTexture_createFromFile("ghost2.jpeg", NULL);
-    ghost3Texture = sfTexture_createFromFile("ghost3.jpeg", NULL);
-    ghost4Texture = sfTexture_createFromFile("ghost4.jpeg", NULL);
-    sfTexture* lifeTexture = sfTexture_createFromFile("live.png", NULL);
-   
     sfSprite* pacmanSprite = sfSprite_create();
-    sfSprite_setTexture(pacmanSprite, pacmanTexture, sfTrue);
+    sfSprite_setTexture(pacmanSprite, assets.textures[ASSET_PACMAN], sfTrue);
+    sfSprite_setTextureRect(pacmanSprite, assets.rects[ASSET_PACMAN]);
     sfSprite_setOrigin(pacmanSprite, (sfVector2f){25, 25});
    
     sfSprite* ghost1Sprite = sfSprite_create();
-    sfSprite_setTexture(ghost1Sprite, ghost1Texture, sfTrue);
+    sfSprite_setTexture(ghost1Sprite, assets.textures[ASSET_GHOST1], sfTrue);
+    sfSprite_setTextureRect(ghost1Sprite, assets.rects[ASSET_GHOST1]);
     sfSprite_setOrigin(ghost1Sprite, (sfVector2f){25, 25});
    
     sfSprite* ghost2Sprite = sfSprite_create();
-    sfSprite_setTexture(ghost2Sprite, ghost2Texture, sfTrue);
+    sfSprite_setTexture(ghost2Sprite, assets.textures[ASSET_GHOST2], sfTrue);
+    sfSprite_setTextureRect(ghost2Sprite, assets.rects[ASSET_GHOST2]);
     sfSprite_setOrigin(ghost2Sprite, (sfVector2f){25, 25});
    
     sfSprite* ghost3Sprite = sfSprite_create();
-    sfSprite_setTexture(ghost3Sprite, ghost3Texture, sfTrue);
+    sfSprite_setTexture(ghost3Sprite, assets.textures[ASSET_GHOST3], sfTrue);
+    sfSprite_setTextureRect(ghost3Sprite, assets.rects[ASSET_GHOST3]);
     sfSprite_setOrigin(ghost3Sprite, (sfVector2f){25, 25});
    
     sfSprite* ghost4Sprite = sfSprite_create();
-    sfSprite_setTexture(ghost4Sprite, ghost4Texture, sfTrue);
+    sfSprite_setTexture(ghost4Sprite, assets.textures[ASSET_GHOST4], sfTrue);
+    sfSprite_setTextureRect(ghost4Sprite, assets.rects[ASSET_GHOST4]);
     sfSprite_setOrigin(ghost4Sprite, (sfVector2f){25, 25});
    
     sfSprite* ghost5Sprite = sfSprite_create();
-    sfSprite_setTexture(ghost5Sprite, ghost5Texture, sfTrue);
+    sfSprite_setTexture(ghost5Sprite, assets.textures[ASSET_GHOST_VULNERABLE], sfTrue);
+    sfSprite_setTextureRect(ghost5Sprite, assets.rects[ASSET_GHOST_VULNERABLE]);
     sfSprite_setOrigin(ghost5Sprite, (sfVector2f){25, 25});
    
     sfSprite* lifeSprite = sfSprite_create();
-    sfSprite_setTexture(lifeSprite, lifeTexture, sfTrue);
+    sfSprite_setTexture(lifeSprite, assets.textures[ASSET_LIFE], sfTrue);
+    sfSprite_setTextureRect(lifeSprite, assets.rects[ASSET_LIFE]);
     sfSprite_setScale(lifeSprite, (sfVector2f){0.5, 0.5});
     sfSprite_setOrigin(lifeSprite, (sfVector2f){25, 25});
    
@@ -1974,13 +8434,33 @@ int main() {
     sfText_setString(livesText, "Lives:");
    
     initUIState();
-    static bool scoreAdded = false;
-    scoreAdded = false;
     initGameState();
+    lockSimulationMemory();
+   
+    // Spectator stream: PACMAN_SPECTATE=1, or =/shm-name
+    const char* spectateEnv = getenv("PACMAN_SPECTATE");
+    if (spectateEnv != NULL && spectateEnv[0] != '\0' && strcmp(spectateEnv, "0") != 0) {
+        spectatorRingOpen(spectateEnv[0] == '/' ? spectateEnv : SPECTATOR_SHM_NAME);
+    }
+   
+    // Rewind buffer: PACMAN_REWIND=1, sized by PACMAN_REWIND_SECONDS and PACMAN_REWIND_KB
+    const char* rewindEnv = getenv("PACMAN_REWIND");
+    if (rewindEnv != NULL && strcmp(rewindEnv, "1") == 0) {
+        const char* secondsEnv = getenv("PACMAN_REWIND_SECONDS");
+        const char* kilobytesEnv = getenv("PACMAN_REWIND_KB");
+        int seconds = secondsEnv != NULL ? atoi(secondsEnv) : REWIND_SECONDS;
+        int kilobytes = kilobytesEnv != NULL ? atoi(kilobytesEnv) : REWIND_BUFFER_KB;
+        rewindInit(seconds > 0 ? seconds : REWIND_SECONDS, kilobytes > 0 ? kilobytes : REWIND_BUFFER_KB);
+    }
    
     gameClock = sfClock_create();
     pelletBlinkClock = sfClock_create();
    
+    initSimulationCancel();
+    if (!initEngineEvents()) {
+        printf("Error creating game engine event loop\n");
+        return -1;
+    }
     pthread_t gameEngineThread;
     if (pthread_create(&gameEngineThread, NULL, gameEngineThreadFunc, NULL) != 0) {
         printf("Error creating game engine thread\n");
@@ -1989,32 +8469,51 @@ int main() {
    
     startGhostThreads();
    
+    // Save states: PACMAN_SAVE_FILE=<file>; ./game --resume [file] starts in it
+    const char* saveEnv = getenv("PACMAN_SAVE_FILE");
+    if (saveEnv != NULL && saveEnv[0] != '\0') {
+        saveFilePath = saveEnv;
+    }
+    if (argc >= 2 && strcmp(argv[1], "--resume") == 0) {
+        if (argc >= 3) {
+            saveFilePath = argv[2];
+        }
+        loadGame(saveFilePath);
+    }
+   
+    // PACMAN_INPUT=bot hands pacman to a built-in player; the keyboard still works
+    const char* inputEnv = getenv("PACMAN_INPUT");
+    InputSource* inputSource = inputEnv != NULL && inputEnv[0] != '\0' ? findInputSource(inputEnv) : NULL;
+    if (inputEnv != NULL && inputEnv[0] != '\0' && inputSource == NULL) {
+        LOG_WARN("Unknown PACMAN_INPUT %s, using the keyboard only", inputEnv);
+    }
+    if (inputSource != NULL) {
+        inputSourceStart(inputSource);
+    }
+   
+    // Pinned only now: threads inherit affinity from the thread creating them
+    applyThreadPlacement("render", realtimeConfig.renderCpu, 0);
+    bool firstFrameReported = false;
+    heartbeatRegister("render", 50);
     while (sfRenderWindow_isOpen(window)) {
+        heartbeat();
         processInput(window);
        
-        pthread_mutex_lock(&uiState.mutex);
+        MUTEX_LOCK(uiState.mutex);
         GameScreen currentScreen = uiState.currentScreen;
         bool needsRedraw = uiState.needsRedraw;
         uiState.needsRedraw = false;
-        pthread_mutex_unlock(&uiState.mutex);
+        MUTEX_UNLOCK(uiState.mutex);
        
-        pthread_mutex_lock(&gameState.mutex);
+        MUTEX_LOCK(gameState.mutex);
         bool gameRunning = gameState.gameRunning;
-        pthread_mutex_unlock(&gameState.mutex);
+        MUTEX_UNLOCK(gameState.mutex);
        
         if (!gameRunning) {
             sfRenderWindow_close(window);
             break;
         }
        
-        InputEvent event;
-        while (getNextInputEvent(&event)) {
-            if (event.eventType == EVENT_SCREEN_CHANGE && event.data == SCREEN_PLAY) {
-                scoreAdded = false;
-                initGameState();
-            }
-        }
-       
         sfTime elapsed = sfClock_getElapsedTime(pelletBlinkClock);
         if (sfTime_asSeconds(elapsed) >= pelletBlinkInterval) {
             pelletVisible = !pelletVisible;
@@ -2026,10 +8525,14 @@ int main() {
                 renderMenu(window, font);
                 break;
             case SCREEN_PLAY:
+            {
+                TraceSpan renderSpan = traceBegin("renderGame");
                 renderGame(window, wall, dot, powerPellet, pacmanSprite, ghost1Sprite,
                           ghost2Sprite, ghost3Sprite, ghost4Sprite, ghost5Sprite,
                           scoreText, livesText, lifeSprite);
+                traceEnd(renderSpan);
                 break;
+            }
             case SCREEN_SCOREBOARD:
                 renderScoreboard(window, font);
                 break;
@@ -2043,24 +8546,37 @@ int main() {
                 sfRenderWindow_close(window);
                 break;
         }
+       
+        if (!firstFrameReported) {
+            printf("Startup: assets %.2f ms (%s), first frame %.2f ms\n", assetsMs,
+                   assets.fromBundle ? ASSET_BUNDLE_FILE : "loose files",
+                   monotonicMs() - startupBegin);
+            firstFrameReported = true;
+        }
     }
    
-    pthread_mutex_lock(&gameState.mutex);
-    gameState.gameRunning = false;
-    pthread_mutex_unlock(&gameState.mutex);
+    heartbeatUnregister();
    
-    pthread_mutex_lock(&gameEngineThreadExitMutex);
-    while (!gameEngineThreadExited) {
-        pthread_cond_wait(&gameEngineThreadExitCond, &gameEngineThreadExitMutex);
-    }
-    pthread_mutex_unlock(&gameEngineThreadExitMutex);
+    // Teardown: one cancellation wakes every simulation and timer thread,
+    // then all of them are joined
+    double teardownBegin = monotonicMs();
+    MUTEX_LOCK(gameState.mutex);
+    gameState.gameRunning = false;
+    publishPacmanView();
+    MUTEX_UNLOCK(gameState.mutex);
    
-    pthread_mutex_lock(&ghostExitMutex);
-    ghostThreadsRunning = false;
-    while (ghostThreadsExited < MAX_GHOSTS) {
-        pthread_cond_wait(&ghostExitCond, &ghostExitMutex);
+    cancelSimulation();
+    pthread_join(gameEngineThread, NULL);
+    double engineJoinedMs = monotonicMs() - teardownBegin;
+    stopGhostThreads();
+    if (inputSource != NULL) {
+        inputSourceStop(inputSource);
     }
-    pthread_mutex_unlock(&ghostExitMutex);
+    closeEngineEvents();
+    spectatorRingClose();
+    printf("Teardown: engine joined in %.2f ms, all simulation threads in %.2f ms\n",
+           engineJoinedMs, monotonicMs() - teardownBegin);
+    watchdogStop();
    
     sfClock_destroy(gameClock);
     sfClock_destroy(pelletBlinkClock);
@@ -2077,28 +8593,37 @@ int main() {
     sfSprite_destroy(ghost5Sprite);
     sfSprite_destroy(lifeSprite);
    
-    sfTexture_destroy(pacmanTexture);
-    sfTexture_destroy(ghost1Texture);
-    sfTexture_destroy(ghost2Texture);
-    sfTexture_destroy(ghost3Texture);
-    sfTexture_destroy(ghost4Texture);
-    sfTexture_destroy(ghost5Texture);
-    sfTexture_destroy(lifeTexture);
    
     sfText_destroy(scoreText);
     sfText_destroy(livesText);
    
-    sfFont_destroy(font);
     sfRenderWindow_destroy(window);
+    destroyAssets(&assets);
+    closeScoreStore();
+
+    if (atomic_load(&tracingEnabled)) {
+        traceDump(traceOutputPath);
+    }
+    printLockReport();
+    verifyGhostHouseState();
+    printGhostHouseReport();
+    printBoostReport();
+    printWatchdogReport();
+    printSchedLatencyReport();
+    printRewindReport();
+    rewindDestroy();
+    if (inputSource != NULL) {
+        inputSource->report(inputSource);
+    }
+    logShutdown();
 
    
+    tileGridDestroy(&boardTiles);
     pthread_mutex_destroy(&gameState.mutex);
     pthread_mutex_destroy(&uiState.mutex);
     pthread_mutex_destroy(&eventQueueMutex);
-    pthread_mutex_destroy(&gameEngineThreadExitMutex);
-    pthread_cond_destroy(&gameEngineThreadExitCond);
-    pthread_mutex_destroy(&ghostExitMutex);
-    pthread_cond_destroy(&ghostExitCond);
+    pthread_mutex_destroy(&simulationCancel.mutex);
+    pthread_cond_destroy(&simulationCancel.cond);
 
     return 0;
 }